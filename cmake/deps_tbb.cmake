@@ -0,0 +1,13 @@
+# TBB is used for shape-level parallel tessellation. It is optional so that the static
+# builds (which do not ship tbb-devel) fall back to a plain std::thread worker pool.
+find_package(TBB CONFIG QUIET)
+if (TBB_FOUND)
+    message(STATUS "TBB version found: " ${TBB_VERSION})
+    add_compile_definitions(STP2GLB_USE_TBB)
+    list(APPEND
+            ADA_CPP_LINK_LIBS
+            TBB::tbb
+    )
+else ()
+    message(STATUS "TBB not found, using std::thread based task scheduling")
+endif ()
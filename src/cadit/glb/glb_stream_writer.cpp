@@ -0,0 +1,405 @@
+#include "glb_stream_writer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+#include <stdexcept>
+#include "../../json_utils.h"
+
+namespace {
+    constexpr std::uint32_t GLB_MAGIC = 0x46546C67; // "glTF"
+    constexpr std::uint32_t GLB_VERSION = 2;
+    constexpr std::uint32_t CHUNK_JSON = 0x4E4F534A; // "JSON"
+    constexpr std::uint32_t CHUNK_BIN = 0x004E4942; // "BIN\0"
+
+    constexpr int COMPONENT_UNSIGNED_SHORT = 5123;
+    constexpr int COMPONENT_UNSIGNED_INT = 5125;
+    constexpr int COMPONENT_FLOAT = 5126;
+
+    constexpr int TARGET_ARRAY_BUFFER = 34962;
+    constexpr int TARGET_ELEMENT_ARRAY_BUFFER = 34963;
+
+    // Producers wait when this much data is queued but not yet on disk
+    constexpr std::size_t MAX_QUEUED_BYTES = 64 * 1024 * 1024;
+    constexpr std::size_t MOVE_BLOCK_SIZE = 4 * 1024 * 1024;
+
+    // Largest GLB, and thereby buffer, the 32-bit lengths allow
+    constexpr std::size_t GLB_LIMIT = std::numeric_limits<std::uint32_t>::max() & ~static_cast<std::size_t>(3);
+
+    // JSON of a node with a full matrix, and of a mesh with its accessors, buffer views and a share of the
+    // materials, names not counted. A JSON beyond the estimate costs a move of the BIN chunk, so these lean high.
+    constexpr std::size_t NODE_JSON_BYTES = 352;
+    constexpr std::size_t MESH_JSON_BYTES = 640;
+
+    std::size_t align4(const std::size_t value) {
+        return (value + 3) & ~static_cast<std::size_t>(3);
+    }
+
+    void write_u32(std::ostream &os, const std::uint32_t value) {
+        os.write(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    template<typename T>
+    void write_array(std::ostream &os, const T &values) {
+        os << "[";
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            if (i > 0) os << ",";
+            os << values[i];
+        }
+        os << "]";
+    }
+
+    // Moves length bytes at from up to to (> from) within the file, back to front so nothing is overwritten
+    void move_up(std::fstream &file, const std::size_t from, const std::size_t to, const std::size_t length) {
+        std::vector<char> block(std::min(length, MOVE_BLOCK_SIZE));
+        std::size_t remaining = length;
+        while (remaining > 0) {
+            const std::size_t size = std::min(remaining, block.size());
+            remaining -= size;
+            file.seekg(static_cast<std::streamoff>(from + remaining));
+            file.read(block.data(), static_cast<std::streamsize>(size));
+            file.seekp(static_cast<std::streamoff>(to + remaining));
+            file.write(block.data(), static_cast<std::streamsize>(size));
+        }
+    }
+}
+
+GlbStreamWriter::GlbStreamWriter(const std::filesystem::path &glb_file, const std::size_t max_buffer_size,
+                                 const std::size_t json_reserve)
+    : glb_file_(glb_file), max_buffer_size_(max_buffer_size), json_reserve_(align4(json_reserve)),
+      bin_start_(12 + 8 + json_reserve_ + 8) {
+    if (const std::filesystem::path glb_dir = glb_file.parent_path(); !glb_dir.empty() && !exists(glb_dir)) {
+        create_directories(glb_dir);
+    }
+    part_.open(part_file(0), std::ios::binary | std::ios::trunc);
+    if (!part_.is_open()) {
+        throw std::runtime_error("Error opening GLB file for writing: " + part_file(0).string());
+    }
+    // The header and the JSON are filled in by finish()
+    part_.seekp(static_cast<std::streamoff>(bin_start_));
+    accessors_ << std::setprecision(std::numeric_limits<float>::max_digits10);
+    writer_ = std::thread(&GlbStreamWriter::write_queue, this);
+}
+
+GlbStreamWriter::~GlbStreamWriter() {
+    stop_writer();
+    if (!finished_) {
+        part_.close();
+        remove_part_files();
+    }
+}
+
+std::filesystem::path GlbStreamWriter::part_file(const int buffer) const {
+    return std::filesystem::path(glb_file_).concat("." + std::to_string(buffer) + ".part");
+}
+
+void GlbStreamWriter::remove_part_files() const {
+    for (std::size_t i = 0; i < buffer_sizes_.size(); ++i) {
+        std::error_code error;
+        std::filesystem::remove(part_file(static_cast<int>(i)), error);
+    }
+}
+
+std::size_t GlbStreamWriter::json_reserve_estimate(const std::size_t num_nodes, const std::size_t num_meshes,
+                                                  const std::size_t name_bytes) {
+    return 1024 + NODE_JSON_BYTES * num_nodes + MESH_JSON_BYTES * num_meshes + name_bytes;
+}
+
+void GlbStreamWriter::stop_writer() {
+    if (!writer_.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        stop_ = true;
+    }
+    queue_cv_.notify_all();
+    writer_.join();
+}
+
+void GlbStreamWriter::write_queue() {
+    std::unique_lock<std::mutex> lock(queue_mutex_);
+    while (true) {
+        queue_cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+        if (queue_.empty()) {
+            return;
+        }
+        Block block = std::move(queue_.front());
+        queue_.pop_front();
+        lock.unlock();
+
+        if (!write_error_) {
+            // Buffers are filled one after the other, so a block of the next buffer closes the current part file
+            if (block.buffer != part_buffer_) {
+                part_.close();
+                part_buffer_ = block.buffer;
+                part_.open(part_file(part_buffer_), std::ios::binary | std::ios::trunc);
+            }
+            part_.write(reinterpret_cast<const char *>(block.data.data()),
+                        static_cast<std::streamsize>(block.data.size()));
+            if (!part_) {
+                write_error_ = std::make_exception_ptr(
+                    std::runtime_error("Error writing GLB file: " + part_file(part_buffer_).string()));
+            }
+        }
+
+        lock.lock();
+        queued_bytes_ -= block.data.size();
+        queue_cv_.notify_all();
+    }
+}
+
+void GlbStreamWriter::enqueue(Block block) {
+    std::unique_lock<std::mutex> lock(queue_mutex_);
+    queue_cv_.wait(lock, [this] { return queued_bytes_ < MAX_QUEUED_BYTES; });
+    queued_bytes_ += block.data.size();
+    queue_.push_back(std::move(block));
+    queue_cv_.notify_all();
+}
+
+int GlbStreamWriter::add_mesh(const Mesh &mesh, const std::string &name) {
+    if (finished_) {
+        throw std::logic_error("GLB stream is already finished");
+    }
+    if (mesh.positions.empty() || mesh.indices.empty()) {
+        throw std::invalid_argument("Cannot write empty mesh '" + name + "' to GLB");
+    }
+    const std::size_t num_vertices = mesh.positions.size() / 3;
+
+    // The data of a mesh goes out as one block. The buffers stay 4-byte aligned, so aligning within the block
+    // aligns the views in the file. The views are placed once the buffer of the block is known.
+    std::vector<unsigned char> block;
+    struct BlockView {
+        std::size_t offset;
+        std::size_t length;
+        int target;
+    };
+    std::vector<BlockView> block_views;
+    auto append_view = [&](const void *data, const std::size_t length, const int target) {
+        block.resize(align4(block.size()), 0);
+        const std::size_t offset = block.size();
+        block.resize(offset + length);
+        std::memcpy(block.data() + offset, data, length);
+        block_views.push_back({offset, length, target});
+        return num_views_++;
+    };
+    auto add_accessor = [&](const int view, const int component_type, const std::size_t count, const char *type) {
+        accessors_ << (num_accessors_ > 0 ? "," : "") << R"({"bufferView":)" << view << R"(,"componentType":)"
+                << component_type << R"(,"count":)" << count << R"(,"type":")" << type << "\"";
+        return num_accessors_++;
+    };
+
+    std::array<float, 3> min;
+    std::array<float, 3> max;
+    position_bounds(mesh.positions, min, max);
+    const int position = add_accessor(append_view(mesh.positions.data(), mesh.positions.size() * sizeof(float),
+                                                  TARGET_ARRAY_BUFFER), COMPONENT_FLOAT, num_vertices, "VEC3");
+    accessors_ << R"(,"min":)";
+    write_array(accessors_, min);
+    accessors_ << R"(,"max":)";
+    write_array(accessors_, max);
+    accessors_ << "}";
+
+    int normal = -1;
+    if (mesh.normals.size() == mesh.positions.size()) {
+        normal = add_accessor(append_view(mesh.normals.data(), mesh.normals.size() * sizeof(float),
+                                          TARGET_ARRAY_BUFFER), COMPONENT_FLOAT, num_vertices, "VEC3");
+        accessors_ << "}";
+    }
+
+    int indices;
+    if (num_vertices <= std::numeric_limits<std::uint16_t>::max()) {
+        const std::vector<std::uint16_t> short_indices(mesh.indices.begin(), mesh.indices.end());
+        indices = add_accessor(append_view(short_indices.data(), short_indices.size() * sizeof(std::uint16_t),
+                                           TARGET_ELEMENT_ARRAY_BUFFER), COMPONENT_UNSIGNED_SHORT,
+                               mesh.indices.size(), "SCALAR");
+    } else {
+        indices = add_accessor(append_view(mesh.indices.data(), mesh.indices.size() * sizeof(std::uint32_t),
+                                           TARGET_ELEMENT_ARRAY_BUFFER), COMPONENT_UNSIGNED_INT,
+                               mesh.indices.size(), "SCALAR");
+    }
+    accessors_ << "}";
+
+    const std::array<float, 4> key{mesh.color.r, mesh.color.g, mesh.color.b, mesh.color.a};
+    auto [material, inserted] = material_lookup_.try_emplace(key, static_cast<int>(materials_.size()));
+    if (inserted) {
+        materials_.push_back(mesh.color);
+    }
+
+    meshes_ << (num_meshes_ > 0 ? "," : "") << R"({"name":")" << escape_json(name)
+            << R"(","primitives":[{"attributes":{"POSITION":)" << position;
+    if (normal >= 0) {
+        meshes_ << R"(,"NORMAL":)" << normal;
+    }
+    meshes_ << R"(},"indices":)" << indices << R"(,"material":)" << material->second << R"(,"mode":4}]})";
+
+    // A mesh larger than the limit gets a buffer of its own. The first buffer shares the GLB with the JSON.
+    block.resize(align4(block.size()), 0);
+    std::size_t limit = buffer_sizes_.size() == 1 ? GLB_LIMIT - bin_start_ : GLB_LIMIT;
+    if (max_buffer_size_ > 0) {
+        limit = std::min(limit, max_buffer_size_);
+    }
+    if (buffer_sizes_.back() > 0 && buffer_sizes_.back() + block.size() > limit) {
+        buffer_sizes_.push_back(0);
+    }
+    const int buffer = static_cast<int>(buffer_sizes_.size()) - 1;
+    for (std::size_t i = 0; i < block_views.size(); ++i) {
+        const BlockView &view = block_views[i];
+        views_ << (num_views_ - block_views.size() + i > 0 ? "," : "") << R"({"buffer":)" << buffer << R"(,"byteOffset":)"
+                << buffer_sizes_.back() + view.offset << R"(,"byteLength":)" << view.length << R"(,"target":)"
+                << view.target << "}";
+    }
+    buffer_sizes_.back() += block.size();
+    bin_size_ += block.size();
+    enqueue({buffer, std::move(block)});
+    return num_meshes_++;
+}
+
+int GlbStreamWriter::add_node(const std::string &name, const int mesh, const std::optional<Matrix> &matrix) {
+    nodes_.push_back({name, mesh, matrix, {}});
+    return static_cast<int>(nodes_.size()) - 1;
+}
+
+void GlbStreamWriter::add_child(const int parent, const int child) {
+    nodes_.at(parent).children.push_back(child);
+}
+
+void GlbStreamWriter::add_root(const int node) {
+    roots_.push_back(node);
+}
+
+std::string GlbStreamWriter::build_json(const std::vector<std::string> &uris) const {
+    std::ostringstream os;
+    os << std::setprecision(std::numeric_limits<double>::max_digits10);
+    os << R"({"asset":{"version":"2.0","generator":"STP2GLB"},"scene":0,"scenes":[{"nodes":)";
+    write_array(os, roots_);
+    os << "}]";
+
+    if (!nodes_.empty()) {
+        os << R"(,"nodes":[)";
+        for (std::size_t i = 0; i < nodes_.size(); ++i) {
+            const auto &node = nodes_[i];
+            if (i > 0) os << ",";
+            os << R"({"name":")" << escape_json(node.name) << "\"";
+            if (node.mesh >= 0) {
+                os << R"(,"mesh":)" << node.mesh;
+            }
+            if (node.matrix) {
+                os << R"(,"matrix":)";
+                write_array(os, *node.matrix);
+            }
+            if (!node.children.empty()) {
+                os << R"(,"children":)";
+                write_array(os, node.children);
+            }
+            os << "}";
+        }
+        os << "]";
+    }
+    if (num_meshes_ > 0) {
+        os << R"(,"meshes":[)" << meshes_.str() << "]";
+    }
+    if (!materials_.empty()) {
+        os << R"(,"materials":[)";
+        for (std::size_t i = 0; i < materials_.size(); ++i) {
+            const auto &color = materials_[i];
+            if (i > 0) os << ",";
+            os << R"({"pbrMetallicRoughness":{"baseColorFactor":[)" << color.r << "," << color.g << "," << color.b
+                    << "," << color.a << R"(],"metallicFactor":0,"roughnessFactor":0.5})";
+            if (color.a < 1.0f) {
+                os << R"(,"alphaMode":"BLEND")";
+            }
+            os << "}";
+        }
+        os << "]";
+    }
+    if (num_accessors_ > 0) {
+        os << R"(,"accessors":[)" << accessors_.str() << "]";
+    }
+    if (num_views_ > 0) {
+        os << R"(,"bufferViews":[)" << views_.str() << "]";
+        os << R"(,"buffers":[)";
+        for (std::size_t i = 0; i < buffer_sizes_.size(); ++i) {
+            if (i > 0) os << ",";
+            os << R"({"byteLength":)" << buffer_sizes_[i];
+            if (!uris[i].empty()) {
+                os << R"(,"uri":")" << escape_json(uris[i]) << "\"";
+            }
+            os << "}";
+        }
+        os << "]";
+    }
+    os << "}";
+    return os.str();
+}
+
+std::vector<std::filesystem::path> GlbStreamWriter::finish() {
+    if (finished_) {
+        throw std::logic_error("GLB stream is already finished");
+    }
+    finished_ = true;
+    stop_writer();
+    part_.close();
+    if (write_error_) {
+        remove_part_files();
+        std::rethrow_exception(write_error_);
+    }
+    if (!part_) {
+        remove_part_files();
+        throw std::runtime_error("Error writing GLB file: " + part_file(part_buffer_).string());
+    }
+
+    // The buffers after the first are renamed into the external buffers, which involves no copy
+    const std::filesystem::path directory = glb_file_.parent_path();
+    std::vector<std::string> uris{""};
+    std::vector<std::filesystem::path> files{glb_file_};
+    for (std::size_t i = 1; i < buffer_sizes_.size(); ++i) {
+        uris.push_back(glb_file_.stem().string() + "-" + std::to_string(i) + ".bin");
+        files.push_back(directory / uris.back());
+        std::filesystem::rename(part_file(static_cast<int>(i)), files.back());
+    }
+
+    // JSON may be padded with trailing spaces, so a JSON shorter than the reservation fills it as is
+    std::string json = build_json(uris);
+    std::size_t json_length = std::max(json_reserve_, align4(json.size()));
+    const std::size_t bin_length = buffer_sizes_.front();
+    std::size_t total_length = 12 + 8 + json_length;
+    if (bin_length > 0) {
+        total_length += 8 + bin_length;
+    }
+    if (total_length > std::numeric_limits<std::uint32_t>::max()) {
+        remove_part_files();
+        throw std::runtime_error("The JSON of " + glb_file_.string() + " outgrew its reservation beyond the 4 GB "
+                                 "GLB limit");
+    }
+    json.resize(json_length, ' ');
+    {
+        std::fstream file(part_file(0), std::ios::binary | std::ios::in | std::ios::out);
+        if (!file.is_open()) {
+            throw std::runtime_error("Error opening GLB file for writing: " + part_file(0).string());
+        }
+        if (json_length > json_reserve_ && bin_length > 0) {
+            move_up(file, bin_start_, bin_start_ + json_length - json_reserve_, bin_length);
+        }
+        file.seekp(0);
+        write_u32(file, GLB_MAGIC);
+        write_u32(file, GLB_VERSION);
+        write_u32(file, static_cast<std::uint32_t>(total_length));
+        write_u32(file, static_cast<std::uint32_t>(json_length));
+        write_u32(file, CHUNK_JSON);
+        file.write(json.data(), static_cast<std::streamsize>(json.size()));
+        if (bin_length > 0) {
+            write_u32(file, static_cast<std::uint32_t>(bin_length));
+            write_u32(file, CHUNK_BIN);
+        }
+        if (!file) {
+            throw std::runtime_error("Error writing GLB file: " + part_file(0).string());
+        }
+    }
+    // Without geometry the reserved BIN chunk header is cut off
+    std::filesystem::resize_file(part_file(0), total_length);
+    std::filesystem::rename(part_file(0), glb_file_);
+    return files;
+}
@@ -0,0 +1,127 @@
+#ifndef GLB_STREAM_WRITER_H
+#define GLB_STREAM_WRITER_H
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "glb_writer.h"
+#include "../../geom/Color.h"
+#include "../../geom/Mesh.h"
+
+// GLB writer that streams the geometry to the file while the model is still being converted.
+//
+// The GLB is written to a part file next to the output (<glb>.0.part) that starts with a placeholder header and a
+// region reserved for the JSON chunk. The binary data of every mesh is handed to a background thread that appends
+// it to the BIN chunk behind that region, so disk I/O overlaps with tessellation and only the meshes in flight are
+// held in memory. The JSON (accessors, buffer views, meshes) is built up as the meshes arrive; finish() writes it
+// into the reserved region, padded with spaces, patches the header and chunk lengths and renames the file. Every
+// geometry byte is written once, unless the JSON outgrows the reservation: then the BIN chunk is moved up in place.
+//
+// A new buffer is started when the next mesh would take the current one past max_buffer_size or the 4 GB GLB limit.
+// The first buffer stays the BIN chunk of the GLB; the others are streamed to their own part files, which become
+// the external <stem>-<n>.bin buffers referenced from the GLB.
+class GlbStreamWriter {
+public:
+    using Matrix = GlbWriter::Matrix;
+
+    // max_buffer_size is the largest buffer in bytes (0 = only the 4 GB GLB limit). json_reserve is the number of
+    // bytes kept free for the JSON chunk in front of the geometry, see json_reserve_estimate.
+    explicit GlbStreamWriter(const std::filesystem::path &glb_file, std::size_t max_buffer_size = 0,
+                             std::size_t json_reserve = 0);
+
+    // Stops the background writer. The part files of an unfinished GLB are removed.
+    ~GlbStreamWriter();
+
+    GlbStreamWriter(const GlbStreamWriter &) = delete;
+
+    GlbStreamWriter &operator=(const GlbStreamWriter &) = delete;
+
+    // Queues the mesh data for writing and returns the glTF mesh index
+    int add_mesh(const Mesh &mesh, const std::string &name = {});
+
+    int add_node(const std::string &name, int mesh = -1, const std::optional<Matrix> &matrix = std::nullopt);
+
+    void add_child(int parent, int child);
+
+    void add_root(int node);
+
+    // Waits for the queued data, completes the GLB and returns the written files: the GLB and its external buffers
+    std::vector<std::filesystem::path> finish();
+
+    // JSON bytes to reserve for the given nodes and meshes. name_bytes is the length of all their names together.
+    static std::size_t json_reserve_estimate(std::size_t num_nodes, std::size_t num_meshes, std::size_t name_bytes);
+
+    [[nodiscard]] std::size_t bin_size() const { return bin_size_; }
+
+private:
+    struct Node {
+        std::string name;
+        int mesh = -1;
+        std::optional<Matrix> matrix;
+        std::vector<int> children;
+    };
+
+    // The data of one mesh and the buffer it goes into
+    struct Block {
+        int buffer;
+        std::vector<unsigned char> data;
+    };
+
+    void enqueue(Block block);
+
+    void write_queue();
+
+    void stop_writer();
+
+    [[nodiscard]] std::filesystem::path part_file(int buffer) const;
+
+    void remove_part_files() const;
+
+    // uris names the external buffers; the first buffer, the BIN chunk, has none
+    [[nodiscard]] std::string build_json(const std::vector<std::string> &uris) const;
+
+    std::filesystem::path glb_file_;
+    std::size_t max_buffer_size_;
+    std::size_t json_reserve_;
+    // Offset of the BIN data in the GLB: header, JSON chunk header, reserved JSON and BIN chunk header
+    std::size_t bin_start_;
+    bool finished_ = false;
+
+    // Background writer and the part file of the buffer it writes
+    std::thread writer_;
+    std::ofstream part_;
+    int part_buffer_ = 0;
+    std::mutex queue_mutex_;
+    std::condition_variable queue_cv_;
+    std::deque<Block> queue_;
+    std::size_t queued_bytes_ = 0;
+    bool stop_ = false;
+    std::exception_ptr write_error_;
+
+    // JSON built up as the meshes arrive. bin_size_ is the size of all buffers together.
+    std::size_t bin_size_ = 0;
+    std::vector<std::size_t> buffer_sizes_{0};
+    std::ostringstream accessors_;
+    std::ostringstream views_;
+    std::ostringstream meshes_;
+    int num_accessors_ = 0;
+    int num_views_ = 0;
+    int num_meshes_ = 0;
+    std::vector<Color> materials_;
+    std::map<std::array<float, 4>, int> material_lookup_;
+    std::vector<Node> nodes_;
+    std::vector<int> roots_;
+};
+
+#endif //GLB_STREAM_WRITER_H
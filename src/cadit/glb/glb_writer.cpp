@@ -0,0 +1,815 @@
+#include "glb_writer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include "meshopt_codec.h"
+#include "../../geom/bvh.h"
+#include "../occt/task_scheduler.h"
+#include "../../json_utils.h"
+
+namespace {
+    constexpr std::uint32_t GLB_MAGIC = 0x46546C67; // "glTF"
+    constexpr std::uint32_t GLB_VERSION = 2;
+    constexpr std::uint32_t CHUNK_JSON = 0x4E4F534A; // "JSON"
+    constexpr std::uint32_t CHUNK_BIN = 0x004E4942; // "BIN\0"
+
+    constexpr int COMPONENT_BYTE = 5120;
+    constexpr int COMPONENT_SHORT = 5122;
+    constexpr int COMPONENT_UNSIGNED_SHORT = 5123;
+    constexpr int COMPONENT_UNSIGNED_INT = 5125;
+    constexpr int COMPONENT_FLOAT = 5126;
+
+    constexpr int TARGET_ARRAY_BUFFER = 34962;
+    constexpr int TARGET_ELEMENT_ARRAY_BUFFER = 34963;
+
+    template<typename T>
+    void write_array(std::ostream &os, const std::vector<T> &values) {
+        os << "[";
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            if (i > 0) os << ",";
+            os << values[i];
+        }
+        os << "]";
+    }
+
+    void write_u32(std::ostream &os, const std::uint32_t value) {
+        os.write(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    GlbWriter::Matrix multiply(const GlbWriter::Matrix &a, const GlbWriter::Matrix &b) {
+        GlbWriter::Matrix result{};
+        for (int col = 0; col < 4; ++col) {
+            for (int row = 0; row < 4; ++row) {
+                for (int k = 0; k < 4; ++k) {
+                    result[col * 4 + row] += a[k * 4 + row] * b[col * 4 + k];
+                }
+            }
+        }
+        return result;
+    }
+
+    template<typename T>
+    T quantize_snorm(const float value) {
+        constexpr float scale = std::numeric_limits<T>::max();
+        return static_cast<T>(std::lround(std::clamp(value, -1.0f, 1.0f) * scale));
+    }
+
+    // Unit normals as normalized integers, padded to four components to keep the attribute 4-byte aligned
+    template<typename T>
+    std::vector<T> quantize_normals(const std::vector<float> &normals) {
+        std::vector<T> result(normals.size() / 3 * 4, 0);
+        for (std::size_t v = 0; v < normals.size() / 3; ++v) {
+            const float x = normals[3 * v], y = normals[3 * v + 1], z = normals[3 * v + 2];
+            const float length = std::sqrt(x * x + y * y + z * z);
+            const float scale = length > 0.0f ? 1.0f / length : 0.0f;
+            result[4 * v] = quantize_snorm<T>(x * scale);
+            result[4 * v + 1] = quantize_snorm<T>(y * scale);
+            result[4 * v + 2] = quantize_snorm<T>(z * scale);
+        }
+        return result;
+    }
+
+    // meshopt OCTAHEDRAL filter: the normal is folded onto an octahedron and stored as (u, v, 1, w), which the
+    // decoder expands back to a normalized (x, y, z, w)
+    template<typename T>
+    std::vector<unsigned char> octahedral_filter(const unsigned char *data, const std::size_t count) {
+        std::vector<unsigned char> result(count * 4 * sizeof(T));
+        for (std::size_t i = 0; i < count; ++i) {
+            T n[4];
+            std::memcpy(n, data + i * sizeof(n), sizeof(n));
+            float x = n[0], y = n[1];
+            const float z = n[2];
+            const float l1 = std::abs(x) + std::abs(y) + std::abs(z);
+            const float scale = l1 > 0.0f ? 1.0f / l1 : 0.0f;
+            x *= scale;
+            y *= scale;
+            const float u = z >= 0.0f ? x : (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+            const float v = z >= 0.0f ? y : (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+            const T encoded[4] = {quantize_snorm<T>(u), quantize_snorm<T>(v), quantize_snorm<T>(1.0f), n[3]};
+            std::memcpy(result.data() + i * sizeof(encoded), encoded, sizeof(encoded));
+        }
+        return result;
+    }
+}
+
+void position_bounds(const std::vector<float> &positions, std::array<float, 3> &min, std::array<float, 3> &max) {
+    constexpr std::size_t lanes = 12;
+    float lo[lanes];
+    float hi[lanes];
+    for (std::size_t j = 0; j < lanes; ++j) {
+        lo[j] = std::numeric_limits<float>::max();
+        hi[j] = std::numeric_limits<float>::lowest();
+    }
+
+    const float *data = positions.data();
+    const std::size_t blocked = positions.size() - positions.size() % lanes;
+    for (std::size_t i = 0; i < blocked; i += lanes) {
+        for (std::size_t j = 0; j < lanes; ++j) {
+            const float v = data[i + j];
+            lo[j] = v < lo[j] ? v : lo[j];
+            hi[j] = v > hi[j] ? v : hi[j];
+        }
+    }
+    for (std::size_t i = blocked; i < positions.size(); ++i) {
+        const std::size_t j = i - blocked;
+        lo[j] = std::min(lo[j], data[i]);
+        hi[j] = std::max(hi[j], data[i]);
+    }
+
+    for (std::size_t axis = 0; axis < 3; ++axis) {
+        min[axis] = lo[axis];
+        max[axis] = hi[axis];
+        for (std::size_t j = axis + 3; j < lanes; j += 3) {
+            min[axis] = std::min(min[axis], lo[j]);
+            max[axis] = std::max(max[axis], hi[j]);
+        }
+    }
+}
+
+GlbWriter::Matrix to_gltf_matrix(const std::array<double, 12> &row_major_3x4) {
+    GlbWriter::Matrix matrix{};
+    for (int row = 0; row < 3; ++row) {
+        for (int col = 0; col < 4; ++col) {
+            matrix[col * 4 + row] = row_major_3x4[row * 4 + col];
+        }
+    }
+    matrix[15] = 1.0;
+    return matrix;
+}
+
+GlbWriter::GlbWriter(GlbOptions options) : options_(options) {
+}
+
+int GlbWriter::append_view(const void *data, const std::size_t length, const int target,
+                           const std::size_t element_size) {
+    // Keep every buffer view 4-byte aligned
+    bin_.resize((bin_.size() + 3) & ~static_cast<std::size_t>(3), 0);
+    const std::size_t offset = bin_.size();
+    bin_.resize(offset + length);
+    std::memcpy(bin_.data() + offset, data, length);
+    views_.push_back({offset, length, target, element_size});
+    return static_cast<int>(views_.size()) - 1;
+}
+
+int GlbWriter::add_material(const Color &color) {
+    const std::array<float, 4> key{color.r, color.g, color.b, color.a};
+    if (const auto it = material_lookup_.find(key); it != material_lookup_.end()) {
+        return it->second;
+    }
+    materials_.push_back(color);
+    const int index = static_cast<int>(materials_.size()) - 1;
+    material_lookup_.emplace(key, index);
+    return index;
+}
+
+int GlbWriter::add_mesh(const Mesh &mesh, const std::string &name) {
+    if (mesh.positions.empty() || mesh.indices.empty()) {
+        throw std::invalid_argument("Cannot write empty mesh '" + name + "' to GLB");
+    }
+    MeshEntry entry;
+    entry.name = name;
+    const std::size_t num_vertices = mesh.positions.size() / 3;
+
+    if (options_.quantize) {
+        add_quantized_attributes(mesh, entry);
+    } else {
+        // Positions (with the bounds required by the spec)
+        std::array<float, 3> min;
+        std::array<float, 3> max;
+        position_bounds(mesh.positions, min, max);
+        const int position_view = append_view(mesh.positions.data(), mesh.positions.size() * sizeof(float),
+                                              TARGET_ARRAY_BUFFER, 3 * sizeof(float));
+        accessors_.push_back({
+            position_view, COMPONENT_FLOAT, num_vertices, "VEC3", {min.begin(), min.end()}, {max.begin(), max.end()}
+        });
+        entry.position = static_cast<int>(accessors_.size()) - 1;
+
+        if (mesh.normals.size() == mesh.positions.size()) {
+            const int normal_view = append_view(mesh.normals.data(), mesh.normals.size() * sizeof(float),
+                                                TARGET_ARRAY_BUFFER, 3 * sizeof(float));
+            accessors_.push_back({normal_view, COMPONENT_FLOAT, num_vertices, "VEC3", {}, {}});
+            entry.normal = static_cast<int>(accessors_.size()) - 1;
+        }
+    }
+
+    // 16-bit indices whenever the vertex count allows it
+    int view;
+    int component_type;
+    if (num_vertices <= std::numeric_limits<std::uint16_t>::max()) {
+        std::vector<std::uint16_t> indices(mesh.indices.begin(), mesh.indices.end());
+        view = append_view(indices.data(), indices.size() * sizeof(std::uint16_t), TARGET_ELEMENT_ARRAY_BUFFER,
+                           sizeof(std::uint16_t));
+        component_type = COMPONENT_UNSIGNED_SHORT;
+    } else {
+        view = append_view(mesh.indices.data(), mesh.indices.size() * sizeof(std::uint32_t),
+                           TARGET_ELEMENT_ARRAY_BUFFER, sizeof(std::uint32_t));
+        component_type = COMPONENT_UNSIGNED_INT;
+    }
+    accessors_.push_back({view, component_type, mesh.indices.size(), "SCALAR", {}, {}});
+    entry.indices = static_cast<int>(accessors_.size()) - 1;
+
+    if (!mesh.group_reference.empty()) {
+        add_feature_ids(mesh, entry);
+    }
+
+    entry.material = add_material(mesh.color);
+    meshes_.push_back(entry);
+    return static_cast<int>(meshes_.size()) - 1;
+}
+
+void GlbWriter::add_quantized_attributes(const Mesh &mesh, MeshEntry &entry) {
+    const std::size_t num_vertices = mesh.positions.size() / 3;
+
+    // One scale for all axes, so that the dequantization transform does not skew the normals
+    std::array<float, 3> lo;
+    std::array<float, 3> hi;
+    position_bounds(mesh.positions, lo, hi);
+    double extent = 0.0;
+    for (int k = 0; k < 3; ++k) {
+        extent = std::max(extent, static_cast<double>(hi[k]) - lo[k]);
+    }
+    if (extent <= 0.0) {
+        extent = 1.0;
+    }
+
+    constexpr double position_scale = std::numeric_limits<std::uint16_t>::max();
+    std::vector<std::uint16_t> positions(4 * num_vertices, 0);
+    std::vector<double> min(3, position_scale);
+    std::vector<double> max(3, 0.0);
+    for (std::size_t v = 0; v < num_vertices; ++v) {
+        for (int k = 0; k < 3; ++k) {
+            const double q = std::round((mesh.positions[3 * v + k] - lo[k]) / extent * position_scale);
+            const auto value = static_cast<std::uint16_t>(std::clamp(q, 0.0, position_scale));
+            positions[4 * v + k] = value;
+            min[k] = std::min<double>(min[k], value);
+            max[k] = std::max<double>(max[k], value);
+        }
+    }
+    const int position_view = append_view(positions.data(), positions.size() * sizeof(std::uint16_t),
+                                          TARGET_ARRAY_BUFFER, 4 * sizeof(std::uint16_t));
+    views_.back().write_stride = true;
+    accessors_.push_back({position_view, COMPONENT_UNSIGNED_SHORT, num_vertices, "VEC3", min, max, true});
+    entry.position = static_cast<int>(accessors_.size()) - 1;
+
+    Matrix dequantization{};
+    dequantization[0] = dequantization[5] = dequantization[10] = extent;
+    dequantization[12] = lo[0];
+    dequantization[13] = lo[1];
+    dequantization[14] = lo[2];
+    dequantization[15] = 1.0;
+    entry.dequantization = dequantization;
+
+    if (mesh.normals.size() != mesh.positions.size()) {
+        return;
+    }
+    int normal_view;
+    int component_type;
+    if (options_.normal_bits == 16) {
+        const auto normals = quantize_normals<std::int16_t>(mesh.normals);
+        normal_view = append_view(normals.data(), normals.size() * sizeof(std::int16_t), TARGET_ARRAY_BUFFER,
+                                  4 * sizeof(std::int16_t));
+        component_type = COMPONENT_SHORT;
+    } else {
+        const auto normals = quantize_normals<std::int8_t>(mesh.normals);
+        normal_view = append_view(normals.data(), normals.size() * sizeof(std::int8_t), TARGET_ARRAY_BUFFER,
+                                  4 * sizeof(std::int8_t));
+        component_type = COMPONENT_BYTE;
+    }
+    views_.back().write_stride = true;
+    views_.back().octahedral = true;
+    accessors_.push_back({normal_view, component_type, num_vertices, "VEC3", {}, {}, true});
+    entry.normal = static_cast<int>(accessors_.size()) - 1;
+}
+
+// Every vertex gets the node id of the group its triangles belong to. Float ids are exact up to 2^24 and, unlike
+// unsigned int, allowed for vertex attributes.
+void GlbWriter::add_feature_ids(const Mesh &mesh, MeshEntry &entry) {
+    const std::size_t num_vertices = mesh.positions.size() / 3;
+    std::vector<float> ids(num_vertices, 0.0f);
+    for (const auto &group: mesh.group_reference) {
+        const std::size_t begin = 3 * static_cast<std::size_t>(group.start);
+        const std::size_t end = std::min(begin + 3 * static_cast<std::size_t>(group.length), mesh.indices.size());
+        for (std::size_t i = begin; i < end; ++i) {
+            ids[mesh.indices[i]] = static_cast<float>(group.node_id);
+        }
+    }
+    const int view = append_view(ids.data(), ids.size() * sizeof(float), TARGET_ARRAY_BUFFER, sizeof(float));
+    accessors_.push_back({view, COMPONENT_FLOAT, num_vertices, "SCALAR", {}, {}});
+    entry.feature_ids = static_cast<int>(accessors_.size()) - 1;
+    entry.groups = mesh.group_reference;
+}
+
+int GlbWriter::add_node(const std::string &name, const int mesh, const std::optional<Matrix> &matrix) {
+    Node node;
+    node.name = name;
+    node.mesh = mesh;
+    node.matrix = matrix;
+    if (mesh >= 0) {
+        if (const auto &dequantization = meshes_.at(mesh).dequantization) {
+            node.matrix = matrix ? multiply(*matrix, *dequantization) : *dequantization;
+        }
+    }
+    nodes_.push_back(node);
+    return static_cast<int>(nodes_.size()) - 1;
+}
+
+void GlbWriter::add_child(const int parent, const int child) {
+    nodes_.at(parent).children.push_back(child);
+}
+
+void GlbWriter::add_root(const int node) {
+    roots_.push_back(node);
+}
+
+void GlbWriter::set_lods(const int node, const std::vector<int> &lod_nodes, const std::vector<double> &screen_coverage) {
+    if (!screen_coverage.empty() && screen_coverage.size() != lod_nodes.size() + 1) {
+        throw std::invalid_argument("MSFT_lod needs one screen coverage value per level of detail");
+    }
+    auto &target = nodes_.at(node);
+    target.lod_nodes = lod_nodes;
+    target.screen_coverage = screen_coverage;
+}
+
+void GlbWriter::set_feature_names(std::vector<std::string> names) {
+    feature_names_ = std::move(names);
+}
+
+std::vector<unsigned char> GlbWriter::encode_view(const BufferView &view) const {
+    const unsigned char *data = bin_.data() + view.offset;
+    const std::size_t count = view.length / view.element_size;
+    if (view.octahedral) {
+        const auto filtered = view.element_size == 4 * sizeof(std::int16_t)
+                                  ? octahedral_filter<std::int16_t>(data, count)
+                                  : octahedral_filter<std::int8_t>(data, count);
+        return encode_vertex_buffer(filtered.data(), count, view.element_size);
+    }
+    if (view.target != TARGET_ELEMENT_ARRAY_BUFFER) {
+        return encode_vertex_buffer(data, count, view.element_size);
+    }
+    std::vector<std::uint32_t> indices(count);
+    if (view.element_size == sizeof(std::uint16_t)) {
+        for (std::size_t i = 0; i < count; ++i) {
+            std::uint16_t index;
+            std::memcpy(&index, data + i * sizeof(index), sizeof(index));
+            indices[i] = index;
+        }
+    } else {
+        std::memcpy(indices.data(), data, view.length);
+    }
+    return encode_index_buffer(indices.data(), indices.size());
+}
+
+std::string GlbWriter::build_json(const std::vector<ViewPlacement> &placements, const bool compressed,
+                                  const std::vector<std::size_t> &buffer_sizes,
+                                  const std::vector<std::string> &uris) const {
+    std::ostringstream os;
+    os << std::setprecision(std::numeric_limits<double>::max_digits10);
+
+    const bool uses_lod = std::any_of(nodes_.begin(), nodes_.end(), [](const Node &node) {
+        return !node.lod_nodes.empty();
+    });
+
+    const bool uses_meshopt = compressed;
+    const bool uses_quantization = options_.quantize && !meshes_.empty();
+    const bool uses_features = std::any_of(meshes_.begin(), meshes_.end(), [](const MeshEntry &mesh) {
+        return mesh.feature_ids >= 0;
+    });
+
+    os << R"({"asset":{"version":"2.0","generator":"STP2GLB"})";
+    // The uncompressed fallback buffer is not written, so readers must support meshopt
+    std::vector<std::string> required;
+    if (uses_meshopt) required.emplace_back("\"EXT_meshopt_compression\"");
+    if (uses_quantization) required.emplace_back("\"KHR_mesh_quantization\"");
+    std::vector<std::string> used = required;
+    if (uses_lod) used.emplace_back("\"MSFT_lod\"");
+    if (uses_features) used.emplace_back("\"EXT_mesh_features\"");
+    if (!used.empty()) {
+        os << R"(,"extensionsUsed":)";
+        write_array(os, used);
+    }
+    if (!required.empty()) {
+        os << R"(,"extensionsRequired":)";
+        write_array(os, required);
+    }
+
+    os << R"(,"scene":0,"scenes":[{"nodes":)";
+    write_array(os, roots_);
+    if (!feature_names_.empty()) {
+        os << R"(,"extras":{"feature_names":[)";
+        for (std::size_t i = 0; i < feature_names_.size(); ++i) {
+            if (i > 0) os << ",";
+            os << "\"" << escape_json(feature_names_[i]) << "\"";
+        }
+        os << "]}";
+    }
+    os << "}]";
+
+    if (!nodes_.empty()) {
+        os << R"(,"nodes":[)";
+        for (std::size_t i = 0; i < nodes_.size(); ++i) {
+            const auto &node = nodes_[i];
+            if (i > 0) os << ",";
+            os << R"({"name":")" << escape_json(node.name) << "\"";
+            if (node.mesh >= 0) {
+                os << R"(,"mesh":)" << node.mesh;
+            }
+            if (node.matrix) {
+                os << R"(,"matrix":)";
+                write_array(os, std::vector<double>(node.matrix->begin(), node.matrix->end()));
+            }
+            if (!node.children.empty()) {
+                os << R"(,"children":)";
+                write_array(os, node.children);
+            }
+            if (!node.lod_nodes.empty()) {
+                os << R"(,"extensions":{"MSFT_lod":{"ids":)";
+                write_array(os, node.lod_nodes);
+                os << "}}";
+                if (!node.screen_coverage.empty()) {
+                    os << R"(,"extras":{"MSFT_screencoverage":)";
+                    write_array(os, node.screen_coverage);
+                    os << "}";
+                }
+            }
+            os << "}";
+        }
+        os << "]";
+    }
+
+    if (!meshes_.empty()) {
+        os << R"(,"meshes":[)";
+        for (std::size_t i = 0; i < meshes_.size(); ++i) {
+            const auto &mesh = meshes_[i];
+            if (i > 0) os << ",";
+            os << R"({"name":")" << escape_json(mesh.name) << R"(","primitives":[{"attributes":{"POSITION":)"
+                    << mesh.position;
+            if (mesh.normal >= 0) {
+                os << R"(,"NORMAL":)" << mesh.normal;
+            }
+            if (mesh.feature_ids >= 0) {
+                os << R"(,"_FEATURE_ID_0":)" << mesh.feature_ids;
+            }
+            os << R"(},"indices":)" << mesh.indices << R"(,"material":)" << mesh.material << R"(,"mode":4)";
+            if (mesh.feature_ids >= 0) {
+                // The triangle ranges as [node_id, first triangle, triangle count]
+                os << R"(,"extensions":{"EXT_mesh_features":{"featureIds":[{"featureCount":)" << mesh.groups.size()
+                        << R"(,"attribute":0}]}},"extras":{"groups":[)";
+                for (std::size_t g = 0; g < mesh.groups.size(); ++g) {
+                    const auto &group = mesh.groups[g];
+                    if (g > 0) os << ",";
+                    os << "[" << group.node_id << "," << group.start << "," << group.length << "]";
+                }
+                os << "]}";
+            }
+            os << "}]}";
+        }
+        os << "]";
+    }
+
+    if (!materials_.empty()) {
+        os << R"(,"materials":[)";
+        for (std::size_t i = 0; i < materials_.size(); ++i) {
+            const auto &color = materials_[i];
+            if (i > 0) os << ",";
+            os << R"({"pbrMetallicRoughness":{"baseColorFactor":[)" << color.r << "," << color.g << "," << color.b
+                    << "," << color.a << R"(],"metallicFactor":0,"roughnessFactor":0.5})";
+            if (color.a < 1.0f) {
+                os << R"(,"alphaMode":"BLEND")";
+            }
+            os << "}";
+        }
+        os << "]";
+    }
+
+    if (!accessors_.empty()) {
+        os << R"(,"accessors":[)";
+        for (std::size_t i = 0; i < accessors_.size(); ++i) {
+            const auto &accessor = accessors_[i];
+            if (i > 0) os << ",";
+            os << R"({"bufferView":)" << accessor.view << R"(,"componentType":)" << accessor.component_type
+                    << R"(,"count":)" << accessor.count << R"(,"type":")" << accessor.type << "\"";
+            if (accessor.normalized) {
+                os << R"(,"normalized":true)";
+            }
+            if (!accessor.min.empty()) {
+                os << R"(,"min":)";
+                write_array(os, accessor.min);
+                os << R"(,"max":)";
+                write_array(os, accessor.max);
+            }
+            os << "}";
+        }
+        os << "]";
+    }
+
+    if (!views_.empty()) {
+        // With compression the views refer to the uncompressed fallback buffer, which follows the written buffers,
+        // and their data to the written buffers
+        const std::size_t fallback = buffer_sizes.size();
+        os << R"(,"bufferViews":[)";
+        for (std::size_t i = 0; i < views_.size(); ++i) {
+            const auto &view = views_[i];
+            const auto &placement = placements[i];
+            if (i > 0) os << ",";
+            if (uses_meshopt) {
+                os << R"({"buffer":)" << fallback << R"(,"byteOffset":)" << view.offset;
+            } else {
+                os << R"({"buffer":)" << placement.buffer << R"(,"byteOffset":)" << placement.offset;
+            }
+            os << R"(,"byteLength":)" << view.length << R"(,"target":)" << view.target;
+            if (view.write_stride) {
+                os << R"(,"byteStride":)" << view.element_size;
+            }
+            if (uses_meshopt) {
+                const bool indices = view.target == TARGET_ELEMENT_ARRAY_BUFFER;
+                os << R"(,"extensions":{"EXT_meshopt_compression":{"buffer":)" << placement.buffer
+                        << R"(,"byteOffset":)" << placement.offset << R"(,"byteLength":)" << placement.length
+                        << R"(,"byteStride":)" << view.element_size << R"(,"count":)"
+                        << view.length / view.element_size << R"(,"mode":")" << (indices ? "TRIANGLES" : "ATTRIBUTES")
+                        << "\"";
+                if (view.octahedral) {
+                    os << R"(,"filter":"OCTAHEDRAL")";
+                }
+                os << "}}";
+            }
+            os << "}";
+        }
+        os << "]";
+        os << R"(,"buffers":[)";
+        for (std::size_t i = 0; i < buffer_sizes.size(); ++i) {
+            if (i > 0) os << ",";
+            os << R"({"byteLength":)" << buffer_sizes[i];
+            if (!uris.empty()) {
+                os << R"(,"uri":")" << escape_json(uris[i]) << "\"";
+            }
+            os << "}";
+        }
+        if (uses_meshopt) {
+            os << R"(,{"byteLength":)" << bin_.size() << R"(,"extensions":{"EXT_meshopt_compression":{"fallback":true}}})";
+        }
+        os << "]";
+    }
+
+    os << "}";
+    return os.str();
+}
+
+std::vector<std::filesystem::path> GlbWriter::write(const std::filesystem::path &glb_file) const {
+    // Every buffer view is encoded on its own, so they are compressed in parallel
+    const bool compressed = options_.meshopt_compression && !views_.empty();
+    std::vector<std::vector<unsigned char>> streams;
+    if (compressed) {
+        streams.resize(views_.size());
+        parallel_for_each_index(views_.size(), options_.num_threads, [&](const std::size_t i) {
+            streams[i] = encode_view(views_[i]);
+        });
+    }
+    // The views are packed into the buffers in order, 4-byte aligned. A new buffer is started when the next view
+    // would overflow the current one, so a view larger than the limit gets a buffer of its own.
+    const std::size_t limit = options_.max_buffer_size > 0
+                                  ? options_.max_buffer_size
+                                  : std::numeric_limits<std::uint32_t>::max() & ~static_cast<std::size_t>(3);
+    std::vector<ViewPlacement> placements;
+    std::vector<std::size_t> buffer_sizes;
+    for (std::size_t i = 0; i < views_.size(); ++i) {
+        const std::size_t length = compressed ? streams[i].size() : views_[i].length;
+        std::size_t offset = buffer_sizes.empty() ? 0 : (buffer_sizes.back() + 3) & ~static_cast<std::size_t>(3);
+        if (buffer_sizes.empty() || (offset > 0 && offset + length > limit)) {
+            buffer_sizes.push_back(0);
+            offset = 0;
+        }
+        placements.push_back({static_cast<int>(buffer_sizes.size()) - 1, offset, length});
+        buffer_sizes.back() = offset + length;
+    }
+
+    if (const std::filesystem::path glb_dir = glb_file.parent_path(); !glb_dir.empty() && !exists(glb_dir)) {
+        create_directories(glb_dir);
+    }
+
+    std::vector<std::filesystem::path> files;
+    if (buffer_sizes.size() <= 1) {
+        std::string json = build_json(placements, compressed, buffer_sizes, {});
+        // Chunks must be 4-byte aligned; JSON is padded with spaces and BIN with zeros
+        json.resize((json.size() + 3) & ~static_cast<std::size_t>(3), ' ');
+        const std::size_t bin_size = buffer_sizes.empty() ? 0 : buffer_sizes[0];
+        const std::size_t bin_length = (bin_size + 3) & ~static_cast<std::size_t>(3);
+        std::size_t total_length = 12 + 8 + json.size();
+        if (bin_size > 0) {
+            total_length += 8 + bin_length;
+        }
+        if (total_length <= std::numeric_limits<std::uint32_t>::max()) {
+            write_glb(glb_file, json, placements, streams, bin_length, total_length);
+            files.push_back(glb_file);
+        }
+    }
+    // The GLB limit is checked before anything is written, so an oversized model falls back to external buffers
+    if (files.empty()) {
+        files = write_gltf(glb_file, placements, streams, buffer_sizes);
+    }
+    if (options_.bvh) {
+        write_bvh(glb_file.parent_path() / glb_file.stem().concat("-bvh.bin"));
+    }
+    return files;
+}
+
+void GlbWriter::write_glb(const std::filesystem::path &glb_file, const std::string &json,
+                          const std::vector<ViewPlacement> &placements,
+                          const std::vector<std::vector<unsigned char> > &streams, const std::size_t bin_length,
+                          const std::size_t total_length) const {
+    {
+        std::ofstream file(glb_file, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            throw std::runtime_error("Error opening GLB file for writing: " + glb_file.string());
+        }
+
+        write_u32(file, GLB_MAGIC);
+        write_u32(file, GLB_VERSION);
+        write_u32(file, static_cast<std::uint32_t>(total_length));
+
+        write_u32(file, static_cast<std::uint32_t>(json.size()));
+        write_u32(file, CHUNK_JSON);
+        file.write(json.data(), static_cast<std::streamsize>(json.size()));
+
+        if (bin_length > 0) {
+            write_u32(file, static_cast<std::uint32_t>(bin_length));
+            write_u32(file, CHUNK_BIN);
+        }
+        if (!file) {
+            throw std::runtime_error("Error writing GLB file: " + glb_file.string());
+        }
+    }
+    if (bin_length == 0) {
+        return;
+    }
+
+    // The layout is known at this point: the file is sized up front (padding reads as zeros) and the BIN chunk is
+    // split into regions that the workers write into their slots concurrently, each through its own stream
+    std::filesystem::resize_file(glb_file, total_length);
+    const std::size_t bin_start = 12 + 8 + json.size() + 8;
+    struct Region {
+        std::size_t file_offset;
+        const unsigned char *data;
+        std::size_t length;
+    };
+    constexpr std::size_t region_size = 8 * 1024 * 1024;
+    std::vector<Region> regions;
+    const auto add_regions = [&](const std::size_t offset, const unsigned char *data, const std::size_t length) {
+        for (std::size_t done = 0; done < length; done += region_size) {
+            regions.push_back({bin_start + offset + done, data + done, std::min(region_size, length - done)});
+        }
+    };
+    // Uncompressed views keep their offsets in bin_, so the whole chunk is copied at once
+    if (streams.empty()) {
+        add_regions(0, bin_.data(), bin_.size());
+    } else {
+        for (std::size_t i = 0; i < streams.size(); ++i) {
+            add_regions(placements[i].offset, streams[i].data(), streams[i].size());
+        }
+    }
+
+    std::atomic<bool> failed{false};
+    parallel_for_each_index(regions.size(), options_.num_threads, [&](const std::size_t i) {
+        const Region &region = regions[i];
+        std::fstream file(glb_file, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(static_cast<std::streamoff>(region.file_offset));
+        file.write(reinterpret_cast<const char *>(region.data), static_cast<std::streamsize>(region.length));
+        if (!file) {
+            failed = true;
+        }
+    });
+    if (failed) {
+        throw std::runtime_error("Error writing GLB file: " + glb_file.string());
+    }
+}
+
+std::vector<std::filesystem::path> GlbWriter::write_gltf(const std::filesystem::path &glb_file,
+                                                         const std::vector<ViewPlacement> &placements,
+                                                         const std::vector<std::vector<unsigned char> > &streams,
+                                                         const std::vector<std::size_t> &buffer_sizes) const {
+    const bool compressed = !streams.empty();
+    const std::filesystem::path directory = glb_file.parent_path();
+    const std::filesystem::path gltf_file = std::filesystem::path(glb_file).replace_extension(".gltf");
+    std::vector<std::string> uris;
+    std::vector<std::vector<std::size_t> > buffer_views(buffer_sizes.size());
+    for (std::size_t i = 0; i < buffer_sizes.size(); ++i) {
+        uris.push_back(glb_file.stem().string() + "-" + std::to_string(i) + ".bin");
+    }
+    for (std::size_t i = 0; i < placements.size(); ++i) {
+        buffer_views[placements[i].buffer].push_back(i);
+    }
+
+    std::vector<std::filesystem::path> files{gltf_file};
+    {
+        std::ofstream file(gltf_file, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            throw std::runtime_error("Error opening glTF file for writing: " + gltf_file.string());
+        }
+        file << build_json(placements, compressed, buffer_sizes, uris);
+        if (!file) {
+            throw std::runtime_error("Error writing glTF file: " + gltf_file.string());
+        }
+    }
+
+    // One thread per buffer, each writing its views in order with the alignment padding in between
+    std::atomic<bool> failed{false};
+    parallel_for_each_index(buffer_sizes.size(), options_.num_threads, [&](const std::size_t b) {
+        std::ofstream file(directory / uris[b], std::ios::binary | std::ios::trunc);
+        std::size_t position = 0;
+        for (const auto i: buffer_views[b]) {
+            const ViewPlacement &placement = placements[i];
+            static constexpr char padding[4] = {};
+            file.write(padding, static_cast<std::streamsize>(placement.offset - position));
+            const unsigned char *data = compressed ? streams[i].data() : bin_.data() + views_[i].offset;
+            file.write(reinterpret_cast<const char *>(data), static_cast<std::streamsize>(placement.length));
+            position = placement.offset + placement.length;
+        }
+        if (!file) {
+            failed = true;
+        }
+    });
+    if (failed) {
+        throw std::runtime_error("Error writing glTF buffers next to: " + gltf_file.string());
+    }
+    for (const auto &uri: uris) {
+        files.push_back(directory / uri);
+    }
+    return files;
+}
+
+void GlbWriter::write_bvh(const std::filesystem::path &bvh_file) const {
+    // World bounds of the mesh nodes: the position bounds of the mesh transformed by the node's world matrix
+    std::vector<Aabb> boxes;
+    std::vector<std::uint32_t> box_nodes;
+    Matrix identity{};
+    identity[0] = identity[5] = identity[10] = identity[15] = 1.0;
+    std::vector<std::pair<int, Matrix> > stack;
+    for (const int root: roots_) {
+        stack.emplace_back(root, identity);
+    }
+    while (!stack.empty()) {
+        const auto [index, parent] = stack.back();
+        stack.pop_back();
+        const Node &node = nodes_[index];
+        const Matrix world = node.matrix ? multiply(parent, *node.matrix) : parent;
+        if (node.mesh >= 0) {
+            const Accessor &positions = accessors_[meshes_[node.mesh].position];
+            // Quantized positions are read as normalized values by the dequantization transform
+            const double scale = positions.normalized ? 1.0 / std::numeric_limits<std::uint16_t>::max() : 1.0;
+            Aabb box{};
+            box.min.fill(std::numeric_limits<float>::max());
+            box.max.fill(std::numeric_limits<float>::lowest());
+            for (int corner = 0; corner < 8; ++corner) {
+                const double p[3] = {
+                    scale * (corner & 1 ? positions.max[0] : positions.min[0]),
+                    scale * (corner & 2 ? positions.max[1] : positions.min[1]),
+                    scale * (corner & 4 ? positions.max[2] : positions.min[2])
+                };
+                for (int row = 0; row < 3; ++row) {
+                    const auto value = static_cast<float>(world[row] * p[0] + world[4 + row] * p[1] +
+                                                          world[8 + row] * p[2] + world[12 + row]);
+                    box.min[row] = std::min(box.min[row], value);
+                    box.max[row] = std::max(box.max[row], value);
+                }
+            }
+            boxes.push_back(box);
+            box_nodes.push_back(static_cast<std::uint32_t>(index));
+        }
+        for (const int child: node.children) {
+            stack.emplace_back(child, world);
+        }
+    }
+    const Bvh bvh = build_bvh(boxes);
+
+    std::ofstream file(bvh_file, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Error opening BVH file for writing: " + bvh_file.string());
+    }
+    const auto write_box = [&](const Aabb &box) {
+        file.write(reinterpret_cast<const char *>(box.min.data()), 3 * sizeof(float));
+        file.write(reinterpret_cast<const char *>(box.max.data()), 3 * sizeof(float));
+    };
+    file.write("BVH1", 4);
+    write_u32(file, 1);
+    write_u32(file, static_cast<std::uint32_t>(bvh.nodes.size()));
+    write_u32(file, static_cast<std::uint32_t>(bvh.items.size()));
+    for (const auto &node: bvh.nodes) {
+        write_box(node.bounds);
+        write_u32(file, node.offset);
+        write_u32(file, node.count);
+    }
+    for (const auto item: bvh.items) {
+        write_u32(file, box_nodes[item]);
+        write_box(boxes[item]);
+    }
+    if (!file) {
+        throw std::runtime_error("Error writing BVH file: " + bvh_file.string());
+    }
+}
@@ -0,0 +1,177 @@
+#ifndef GLB_WRITER_H
+#define GLB_WRITER_H
+
+#include <array>
+#include <cstddef>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+#include "../../geom/Color.h"
+#include "../../geom/GroupReference.h"
+#include "../../geom/Mesh.h"
+
+struct GlbOptions {
+    // Store the buffer views with EXT_meshopt_compression (marked as required)
+    bool meshopt_compression = false;
+    // Threads encoding the buffer views (0 = all hardware threads)
+    int num_threads = 0;
+    // Store positions as 16-bit normalized integers and normals as 8- or 16-bit normalized integers
+    // (KHR_mesh_quantization). Nodes referencing a mesh carry its dequantization transform.
+    bool quantize = false;
+    int normal_bits = 8;
+    // Write a BVH over the world bounds of the mesh nodes next to the GLB (<glb stem>-bvh.bin), see write_bvh
+    bool bvh = false;
+    // Largest buffer in bytes (0 = only the 4 GB GLB limit). When the geometry does not fit into one buffer, the
+    // output is a .gltf with one external .bin file per buffer instead of a GLB.
+    std::size_t max_buffer_size = 0;
+};
+
+// glTF 2.0 binary (GLB) writer working directly on the Mesh structures in src/geom.
+//
+// Used for output that RWGltf_CafWriter cannot produce (e.g. MSFT_lod). All geometry is
+// appended to one binary buffer, split on write if needed, and materials are deduplicated by their color.
+class GlbWriter {
+public:
+    // Column-major 4x4 matrix, as stored in glTF
+    using Matrix = std::array<double, 16>;
+
+    explicit GlbWriter(GlbOptions options = {});
+
+    // Appends the mesh data to the binary chunk and returns the glTF mesh index
+    int add_mesh(const Mesh &mesh, const std::string &name = {});
+
+    // Adds a node and returns its index. The node is not part of the scene until it is added as a root or child.
+    // For a quantized mesh the dequantization transform is appended to matrix.
+    int add_node(const std::string &name, int mesh = -1, const std::optional<Matrix> &matrix = std::nullopt);
+
+    void add_child(int parent, int child);
+
+    void add_root(int node);
+
+    // Attaches lower detail alternatives (MSFT_lod). lod_nodes go from high to low detail and must not be
+    // part of the scene; screen_coverage holds one threshold for node followed by one per lod node.
+    void set_lods(int node, const std::vector<int> &lod_nodes, const std::vector<double> &screen_coverage);
+
+    // Names of the features referenced by the group references of the meshes (node_id indexes this list).
+    // Written to the scene extras.
+    void set_feature_names(std::vector<std::string> names);
+
+    // Writes the GLB and returns the written files. Geometry exceeding max_buffer_size or the GLB limit is spilled
+    // into <stem>-<n>.bin buffers referenced from <stem>.gltf, which is then written in place of the GLB; the
+    // buffers are written concurrently. The buffer views are never split across buffers.
+    std::vector<std::filesystem::path> write(const std::filesystem::path &glb_file) const;
+
+    // Writes a SAH bounding volume hierarchy over the world space bounds of every mesh node in the scene, so viewers
+    // can cull and pick without computing bounds first. Little endian layout:
+    //   header   "BVH1", uint32 version (1), uint32 node count, uint32 item count
+    //   nodes    float min[3], float max[3], uint32 offset, uint32 count
+    //            leaves (count > 0) hold the items [offset, offset + count); the left child of an inner node
+    //            follows it directly and offset is the index of the right child
+    //   items    uint32 glTF node index, float min[3], float max[3]
+    void write_bvh(const std::filesystem::path &bvh_file) const;
+
+    [[nodiscard]] std::size_t num_meshes() const { return meshes_.size(); }
+
+    [[nodiscard]] std::size_t num_nodes() const { return nodes_.size(); }
+
+    [[nodiscard]] std::size_t bin_size() const { return bin_.size(); }
+
+private:
+    struct BufferView {
+        std::size_t offset;
+        std::size_t length;
+        int target;
+        // Size of one vertex or index
+        std::size_t element_size;
+        // Padded vertex attributes need an explicit stride
+        bool write_stride = false;
+        // Quantized normals, written with the OCTAHEDRAL filter when compressed
+        bool octahedral = false;
+    };
+
+    // Location of the written (possibly compressed) data of a buffer view
+    struct ViewPlacement {
+        int buffer;
+        std::size_t offset;
+        std::size_t length;
+    };
+
+    struct Accessor {
+        int view;
+        int component_type;
+        std::size_t count;
+        std::string type;
+        std::vector<double> min;
+        std::vector<double> max;
+        bool normalized = false;
+    };
+
+    struct MeshEntry {
+        std::string name;
+        int position = -1;
+        int normal = -1;
+        int indices = -1;
+        int material = -1;
+        std::optional<Matrix> dequantization;
+        // Per vertex feature id (EXT_mesh_features) and the triangle ranges of the features
+        int feature_ids = -1;
+        std::vector<GroupReference> groups;
+    };
+
+    struct Node {
+        std::string name;
+        int mesh = -1;
+        std::optional<Matrix> matrix;
+        std::vector<int> children;
+        std::vector<int> lod_nodes;
+        std::vector<double> screen_coverage;
+    };
+
+    int add_material(const Color &color);
+
+    int append_view(const void *data, std::size_t length, int target, std::size_t element_size);
+
+    void add_quantized_attributes(const Mesh &mesh, MeshEntry &entry);
+
+    void add_feature_ids(const Mesh &mesh, MeshEntry &entry);
+
+    [[nodiscard]] std::vector<unsigned char> encode_view(const BufferView &view) const;
+
+    // streams holds the compressed buffer views and is empty when the views are stored as they are
+    void write_glb(const std::filesystem::path &glb_file, const std::string &json,
+                   const std::vector<ViewPlacement> &placements,
+                   const std::vector<std::vector<unsigned char> > &streams, std::size_t bin_length,
+                   std::size_t total_length) const;
+
+    std::vector<std::filesystem::path> write_gltf(const std::filesystem::path &glb_file,
+                                                  const std::vector<ViewPlacement> &placements,
+                                                  const std::vector<std::vector<unsigned char> > &streams,
+                                                  const std::vector<std::size_t> &buffer_sizes) const;
+
+    // placements holds one entry per buffer view. uris names the external buffers and is empty for a GLB.
+    [[nodiscard]] std::string build_json(const std::vector<ViewPlacement> &placements, bool compressed,
+                                         const std::vector<std::size_t> &buffer_sizes,
+                                         const std::vector<std::string> &uris) const;
+
+    GlbOptions options_;
+    std::vector<unsigned char> bin_;
+    std::vector<BufferView> views_;
+    std::vector<Accessor> accessors_;
+    std::vector<Color> materials_;
+    std::map<std::array<float, 4>, int> material_lookup_;
+    std::vector<MeshEntry> meshes_;
+    std::vector<Node> nodes_;
+    std::vector<int> roots_;
+    std::vector<std::string> feature_names_;
+};
+
+// Bounds of xyz positions. Four vertices are reduced per step into 12 independent lanes (lane j holds axis j % 3),
+// which the compiler turns into packed min/max instructions instead of a serial chain per axis.
+void position_bounds(const std::vector<float> &positions, std::array<float, 3> &min, std::array<float, 3> &max);
+
+// Converts a row-major 3x4 affine transformation to a glTF (column-major 4x4) matrix
+GlbWriter::Matrix to_gltf_matrix(const std::array<double, 12> &row_major_3x4);
+
+#endif //GLB_WRITER_H
@@ -0,0 +1,308 @@
+#include "meshopt_codec.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+    constexpr unsigned char VERTEX_HEADER = 0xa0;
+    constexpr unsigned char INDEX_HEADER = 0xe0;
+    constexpr int INDEX_VERSION = 1;
+
+    constexpr std::size_t BYTE_GROUP_SIZE = 16;
+    constexpr std::size_t VERTEX_BLOCK_SIZE_BYTES = 8192;
+    constexpr std::size_t VERTEX_BLOCK_MAX_SIZE = 256;
+    constexpr std::size_t TAIL_MIN_SIZE = 32;
+
+    // Bit widths selectable per group of 16 bytes, by their 2-bit header code
+    constexpr int GROUP_BITS[4] = {0, 2, 4, 8};
+
+    unsigned char zigzag8(const unsigned char v) {
+        return static_cast<unsigned char>((static_cast<signed char>(v) >> 7) ^ (v << 1));
+    }
+
+    std::size_t vertex_block_size(const std::size_t vertex_size) {
+        const std::size_t size = (VERTEX_BLOCK_SIZE_BYTES / vertex_size) & ~(BYTE_GROUP_SIZE - 1);
+        return std::min(size, VERTEX_BLOCK_MAX_SIZE);
+    }
+
+    // Encoded size of a group; values that do not fit in bits are stored as a whole byte after the packed part
+    std::size_t group_size(const unsigned char *group, const int bits) {
+        if (bits == 0) {
+            return std::all_of(group, group + BYTE_GROUP_SIZE, [](const unsigned char v) { return v == 0; })
+                       ? 0
+                       : static_cast<std::size_t>(-1);
+        }
+        if (bits == 8) {
+            return BYTE_GROUP_SIZE;
+        }
+        const unsigned sentinel = (1u << bits) - 1;
+        std::size_t size = BYTE_GROUP_SIZE * bits / 8;
+        for (std::size_t i = 0; i < BYTE_GROUP_SIZE; ++i) {
+            size += group[i] >= sentinel;
+        }
+        return size;
+    }
+
+    void encode_group(std::vector<unsigned char> &out, const unsigned char *group, const int bits) {
+        if (bits == 0) {
+            return;
+        }
+        if (bits == 8) {
+            out.insert(out.end(), group, group + BYTE_GROUP_SIZE);
+            return;
+        }
+        const unsigned sentinel = (1u << bits) - 1;
+        const std::size_t per_byte = 8 / bits;
+        // The first value goes into the high bits
+        for (std::size_t i = 0; i < BYTE_GROUP_SIZE; i += per_byte) {
+            unsigned byte = 0;
+            for (std::size_t k = 0; k < per_byte; ++k) {
+                byte = (byte << bits) | std::min<unsigned>(group[i + k], sentinel);
+            }
+            out.push_back(static_cast<unsigned char>(byte));
+        }
+        for (std::size_t i = 0; i < BYTE_GROUP_SIZE; ++i) {
+            if (group[i] >= sentinel) {
+                out.push_back(group[i]);
+            }
+        }
+    }
+
+    void encode_bytes(std::vector<unsigned char> &out, const unsigned char *buffer, const std::size_t size) {
+        // 2 bits of header per group
+        const std::size_t header = out.size();
+        out.resize(out.size() + (size / BYTE_GROUP_SIZE + 3) / 4, 0);
+        for (std::size_t i = 0; i < size; i += BYTE_GROUP_SIZE) {
+            int best = 3;
+            std::size_t best_size = group_size(buffer + i, GROUP_BITS[best]);
+            for (int code = 0; code < 3; ++code) {
+                if (const std::size_t candidate = group_size(buffer + i, GROUP_BITS[code]); candidate < best_size) {
+                    best = code;
+                    best_size = candidate;
+                }
+            }
+            const std::size_t group = i / BYTE_GROUP_SIZE;
+            out[header + group / 4] |= static_cast<unsigned char>(best << (group % 4 * 2));
+            encode_group(out, buffer + i, GROUP_BITS[best]);
+        }
+    }
+
+    // Index codec state: the 16 most recent edges and vertices
+    struct IndexFifos {
+        std::uint32_t edges[16][2];
+        std::uint32_t vertices[16];
+        std::size_t edge_offset = 0;
+        std::size_t vertex_offset = 0;
+
+        IndexFifos() {
+            std::memset(edges, -1, sizeof(edges));
+            std::memset(vertices, -1, sizeof(vertices));
+        }
+
+        // Position of the edge in the FIFO (most recent first) times 4 plus the rotation that puts it first
+        [[nodiscard]] int find_edge(const std::uint32_t a, const std::uint32_t b, const std::uint32_t c) const {
+            for (int i = 0; i < 16; ++i) {
+                const std::size_t index = (edge_offset - 1 - i) & 15;
+                const std::uint32_t e0 = edges[index][0], e1 = edges[index][1];
+                if (e0 == a && e1 == b) return (i << 2) | 0;
+                if (e0 == b && e1 == c) return (i << 2) | 1;
+                if (e0 == c && e1 == a) return (i << 2) | 2;
+            }
+            return -1;
+        }
+
+        [[nodiscard]] int find_vertex(const std::uint32_t v) const {
+            for (int i = 0; i < 16; ++i) {
+                if (vertices[(vertex_offset - 1 - i) & 15] == v) {
+                    return i;
+                }
+            }
+            return -1;
+        }
+
+        void push_edge(const std::uint32_t a, const std::uint32_t b) {
+            edges[edge_offset][0] = a;
+            edges[edge_offset][1] = b;
+            edge_offset = (edge_offset + 1) & 15;
+        }
+
+        void push_vertex(const std::uint32_t v) {
+            vertices[vertex_offset] = v;
+            vertex_offset = (vertex_offset + 1) & 15;
+        }
+    };
+
+    constexpr unsigned TRIANGLE_ORDER[3][3] = {{0, 1, 2}, {1, 2, 0}, {2, 0, 1}};
+
+    // Common (feb, fec) pairs that fit into the 4-bit code. Stored at the end of the stream, where it also
+    // serves as the padding the decoder needs.
+    constexpr unsigned char CODE_AUX_TABLE[16] = {
+        0x00, 0x76, 0x87, 0x56, 0x67, 0x78, 0xa9, 0x86, 0x65, 0x89, 0x68, 0x98, 0x01, 0x69, 0, 0
+    };
+
+    void encode_index(std::vector<unsigned char> &out, const std::uint32_t index, const std::uint32_t last) {
+        // Zigzag encoded delta as a varint
+        const std::uint32_t d = index - last;
+        std::uint32_t v = (d << 1) ^ static_cast<std::uint32_t>(static_cast<std::int32_t>(d) >> 31);
+        do {
+            out.push_back(static_cast<unsigned char>((v & 127) | (v > 127 ? 128 : 0)));
+            v >>= 7;
+        } while (v);
+    }
+}
+
+std::vector<unsigned char> encode_vertex_buffer(const void *vertices, const std::size_t vertex_count,
+                                                const std::size_t vertex_size) {
+    if (vertex_size == 0 || vertex_size > 256 || vertex_size % 4 != 0) {
+        throw std::invalid_argument("meshopt vertex size must be a multiple of 4 between 4 and 256");
+    }
+    const auto *data = static_cast<const unsigned char *>(vertices);
+    std::vector<unsigned char> out;
+    out.reserve(vertex_count * vertex_size / 2 + TAIL_MIN_SIZE + 1);
+    out.push_back(VERTEX_HEADER);
+
+    unsigned char last_vertex[256] = {};
+    if (vertex_count > 0) {
+        std::memcpy(last_vertex, data, vertex_size);
+    }
+
+    const std::size_t block_size = vertex_block_size(vertex_size);
+    unsigned char buffer[VERTEX_BLOCK_MAX_SIZE];
+    for (std::size_t offset = 0; offset < vertex_count; offset += block_size) {
+        const std::size_t count = std::min(block_size, vertex_count - offset);
+        const std::size_t aligned = (count + BYTE_GROUP_SIZE - 1) & ~(BYTE_GROUP_SIZE - 1);
+        const unsigned char *block = data + offset * vertex_size;
+        // One byte stream per byte of the vertex
+        for (std::size_t k = 0; k < vertex_size; ++k) {
+            unsigned char previous = last_vertex[k];
+            for (std::size_t i = 0; i < count; ++i) {
+                const unsigned char value = block[i * vertex_size + k];
+                buffer[i] = zigzag8(static_cast<unsigned char>(value - previous));
+                previous = value;
+            }
+            std::fill(buffer + count, buffer + aligned, 0);
+            encode_bytes(out, buffer, aligned);
+        }
+        std::memcpy(last_vertex, block + (count - 1) * vertex_size, vertex_size);
+    }
+
+    // The tail holds the first vertex, which seeds the deltas of the decoder
+    if (vertex_size < TAIL_MIN_SIZE) {
+        out.resize(out.size() + TAIL_MIN_SIZE - vertex_size, 0);
+    }
+    if (vertex_count > 0) {
+        out.insert(out.end(), data, data + vertex_size);
+    } else {
+        out.resize(out.size() + vertex_size, 0);
+    }
+    return out;
+}
+
+std::vector<unsigned char> encode_index_buffer(const std::uint32_t *indices, const std::size_t index_count) {
+    if (index_count % 3 != 0) {
+        throw std::invalid_argument("meshopt index buffer must hold whole triangles");
+    }
+    // One code byte per triangle, followed by the extra data of the triangles
+    std::vector<unsigned char> codes;
+    std::vector<unsigned char> data;
+    codes.reserve(index_count / 3);
+    data.reserve(index_count / 3);
+
+    IndexFifos fifos;
+    std::uint32_t next = 0;
+    std::uint32_t last = 0;
+    constexpr int fec_max = 13;
+
+    for (std::size_t i = 0; i < index_count; i += 3) {
+        const int edge = fifos.find_edge(indices[i], indices[i + 1], indices[i + 2]);
+
+        if (edge >= 0 && (edge >> 2) < 15) {
+            // Rotate so that the known edge comes first, then encode the third vertex
+            const unsigned *order = TRIANGLE_ORDER[edge & 3];
+            const std::uint32_t a = indices[i + order[0]], b = indices[i + order[1]], c = indices[i + order[2]];
+
+            const int fe = edge >> 2;
+            const int fc = fifos.find_vertex(c);
+            int fec = fc >= 1 && fc < fec_max ? fc : c == next ? (next++, 0) : 15;
+            if (fec == 15) {
+                // Neighbours of the last explicit index, common in strip-like sequences
+                if (c + 1 == last) {
+                    fec = 13;
+                    last = c;
+                } else if (c == last + 1) {
+                    fec = 14;
+                    last = c;
+                }
+            }
+            codes.push_back(static_cast<unsigned char>((fe << 4) | fec));
+            if (fec == 15) {
+                encode_index(data, c, last);
+                last = c;
+            }
+            if (fec == 0 || fec >= fec_max) {
+                fifos.push_vertex(c);
+            }
+            fifos.push_edge(c, b);
+            fifos.push_edge(a, c);
+        } else {
+            // Rotate so that a is the next new vertex if any of them is
+            const std::uint32_t next_before = next;
+            const int rotation = indices[i + 1] == next_before ? 1 : indices[i + 2] == next_before ? 2 : 0;
+            const unsigned *order = TRIANGLE_ORDER[rotation];
+            const std::uint32_t a = indices[i + order[0]], b = indices[i + order[1]], c = indices[i + order[2]];
+
+            // 0, 1, 2 after the start restarts the numbering
+            const bool reset = a == 0 && b == 1 && c == 2 && next > 0;
+            if (reset) {
+                next = 0;
+                std::memset(fifos.vertices, -1, sizeof(fifos.vertices));
+            }
+
+            const int fb = fifos.find_vertex(b);
+            const int fc = fifos.find_vertex(c);
+            const int fea = a == next ? (next++, 0) : 15;
+            const int feb = fb >= 0 && fb < 14 ? fb + 1 : b == next ? (next++, 0) : 15;
+            const int fec = fc >= 0 && fc < 14 ? fc + 1 : c == next ? (next++, 0) : 15;
+
+            const auto code_aux = static_cast<unsigned char>((feb << 4) | fec);
+            const auto table_it = std::find(CODE_AUX_TABLE, CODE_AUX_TABLE + 16, code_aux);
+            const auto table_index = table_it - CODE_AUX_TABLE;
+            if (fea == 0 && table_index < 14 && !reset) {
+                codes.push_back(static_cast<unsigned char>((15 << 4) | table_index));
+            } else {
+                codes.push_back(static_cast<unsigned char>((15 << 4) | 14 | fea));
+                data.push_back(code_aux);
+            }
+
+            if (fea == 15) {
+                encode_index(data, a, last);
+                last = a;
+            }
+            if (feb == 15) {
+                encode_index(data, b, last);
+                last = b;
+            }
+            if (fec == 15) {
+                encode_index(data, c, last);
+                last = c;
+            }
+
+            if (fea == 0 || fea == 15) fifos.push_vertex(a);
+            if (feb == 0 || feb == 15) fifos.push_vertex(b);
+            if (fec == 0 || fec == 15) fifos.push_vertex(c);
+
+            fifos.push_edge(b, a);
+            fifos.push_edge(c, b);
+            fifos.push_edge(a, c);
+        }
+    }
+
+    std::vector<unsigned char> out;
+    out.reserve(1 + codes.size() + data.size() + 16);
+    out.push_back(INDEX_HEADER | INDEX_VERSION);
+    out.insert(out.end(), codes.begin(), codes.end());
+    out.insert(out.end(), data.begin(), data.end());
+    out.insert(out.end(), CODE_AUX_TABLE, CODE_AUX_TABLE + 16);
+    return out;
+}
@@ -0,0 +1,21 @@
+#ifndef MESHOPT_CODEC_H
+#define MESHOPT_CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Encoders of the meshoptimizer bitstreams used by EXT_meshopt_compression.
+// The output decodes with meshopt_decodeVertexBuffer / meshopt_decodeIndexBuffer (and thereby in three.js,
+// Babylon.js, CesiumJS and gltfpack based tooling).
+
+// ATTRIBUTES mode, vertex codec version 0 (header 0xa0). Per byte deltas between consecutive vertices,
+// zigzag encoded and bit packed in groups of 16. vertex_size must be a multiple of 4 and at most 256.
+std::vector<unsigned char> encode_vertex_buffer(const void *vertices, std::size_t vertex_count,
+                                                std::size_t vertex_size);
+
+// TRIANGLES mode, index codec version 1 (header 0xe1). Triangles are matched against a FIFO of recent edges
+// and vertices, which works best on indices ordered for the vertex cache (see optimize_mesh).
+std::vector<unsigned char> encode_index_buffer(const std::uint32_t *indices, std::size_t index_count);
+
+#endif //MESHOPT_CODEC_H
@@ -0,0 +1,264 @@
+#include "tileset_writer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include "../occt/task_scheduler.h"
+#include "../../json_utils.h"
+
+namespace {
+    // glTF content is Y up and 3D Tiles is Z up; clients rotate the content by +90 degrees about X on loading, so the
+    // tiles are rotated back: (x, y, z) -> (x, z, -y)
+    constexpr GlbWriter::Matrix Z_UP_TO_Y_UP{1, 0, 0, 0, 0, 0, -1, 0, 0, 1, 0, 0, 0, 0, 0, 1};
+
+    struct Tile {
+        // Bounds of the content and of all children
+        std::array<double, 3> min;
+        std::array<double, 3> max;
+        std::vector<std::size_t> content;
+        std::vector<std::size_t> children;
+        // Largest instance diagonal in the tile and below it
+        double max_diagonal = 0.0;
+        double geometric_error = 0.0;
+    };
+
+    double diagonal(const std::array<double, 3> &min, const std::array<double, 3> &max) {
+        const double dx = max[0] - min[0], dy = max[1] - min[1], dz = max[2] - min[2];
+        return std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+
+    void expand(std::array<double, 3> &min, std::array<double, 3> &max, const std::array<double, 3> &other_min,
+                const std::array<double, 3> &other_max) {
+        for (int k = 0; k < 3; ++k) {
+            min[k] = std::min(min[k], other_min[k]);
+            max[k] = std::max(max[k], other_max[k]);
+        }
+    }
+
+    class OctreeBuilder {
+    public:
+        OctreeBuilder(const std::vector<TileInstance> &instances, const TilesetOptions &options)
+            : instances_(instances), options_(options) {
+        }
+
+        // Builds the tile of a cubic cell and returns its index
+        std::size_t build(const std::array<double, 3> &center, const double half_size, std::vector<std::size_t> items,
+                          const int depth) {
+            const std::size_t index = tiles_.size();
+            tiles_.emplace_back();
+
+            std::size_t triangles = 0;
+            for (const auto item: items) {
+                triangles += instances_[item].mesh->indices.size() / 3;
+            }
+
+            std::vector<std::size_t> content;
+            std::array<std::vector<std::size_t>, 8> octants;
+            if (triangles <= options_.max_tile_triangles || depth >= options_.max_depth || items.size() <= 1) {
+                content = std::move(items);
+            } else {
+                for (const auto item: items) {
+                    const auto &instance = instances_[item];
+                    double extent = 0.0;
+                    int octant = 0;
+                    for (int k = 0; k < 3; ++k) {
+                        extent = std::max(extent, instance.max[k] - instance.min[k]);
+                        if ((instance.min[k] + instance.max[k]) / 2.0 >= center[k]) {
+                            octant |= 1 << k;
+                        }
+                    }
+                    if (extent > half_size) {
+                        content.push_back(item);
+                    } else {
+                        octants[octant].push_back(item);
+                    }
+                }
+            }
+
+            std::vector<std::size_t> children;
+            for (int octant = 0; octant < 8; ++octant) {
+                if (octants[octant].empty()) {
+                    continue;
+                }
+                std::array<double, 3> child_center{};
+                for (int k = 0; k < 3; ++k) {
+                    child_center[k] = center[k] + (octant & (1 << k) ? 0.5 : -0.5) * half_size;
+                }
+                children.push_back(build(child_center, half_size / 2.0, std::move(octants[octant]), depth + 1));
+            }
+
+            // tiles_ may have grown in the recursion, so the tile is only looked up now
+            Tile &tile = tiles_[index];
+            tile.min.fill(std::numeric_limits<double>::max());
+            tile.max.fill(std::numeric_limits<double>::lowest());
+            for (const auto item: content) {
+                const auto &instance = instances_[item];
+                expand(tile.min, tile.max, instance.min, instance.max);
+                tile.max_diagonal = std::max(tile.max_diagonal, diagonal(instance.min, instance.max));
+            }
+            for (const auto child: children) {
+                const Tile &child_tile = tiles_[child];
+                expand(tile.min, tile.max, child_tile.min, child_tile.max);
+                tile.max_diagonal = std::max(tile.max_diagonal, child_tile.max_diagonal);
+                // Leaving out the children drops instances up to their size
+                tile.geometric_error = std::max(tile.geometric_error, child_tile.max_diagonal);
+            }
+            tile.content = std::move(content);
+            tile.children = std::move(children);
+            return index;
+        }
+
+        [[nodiscard]] const std::vector<Tile> &tiles() const { return tiles_; }
+
+    private:
+        const std::vector<TileInstance> &instances_;
+        const TilesetOptions &options_;
+        std::vector<Tile> tiles_;
+    };
+
+    // content_uris holds the file of each tile with content, relative to the tileset
+    void write_tile(std::ostream &os, const std::vector<Tile> &tiles, const std::vector<std::string> &content_uris,
+                    const std::size_t index) {
+        const Tile &tile = tiles[index];
+        os << R"({"boundingVolume":{"box":[)";
+        for (int k = 0; k < 3; ++k) {
+            os << (tile.min[k] + tile.max[k]) / 2.0 << ",";
+        }
+        for (int axis = 0; axis < 3; ++axis) {
+            for (int k = 0; k < 3; ++k) {
+                os << (k == axis ? (tile.max[k] - tile.min[k]) / 2.0 : 0.0) << (axis == 2 && k == 2 ? "" : ",");
+            }
+        }
+        os << R"(]},"geometricError":)" << tile.geometric_error;
+        if (index == 0) {
+            os << R"(,"refine":"ADD")";
+        }
+        if (!tile.content.empty()) {
+            os << R"(,"content":{"uri":")" << escape_json(content_uris[index]) << R"("})";
+        }
+        if (!tile.children.empty()) {
+            os << R"(,"children":[)";
+            for (std::size_t i = 0; i < tile.children.size(); ++i) {
+                if (i > 0) os << ",";
+                write_tile(os, tiles, content_uris, tile.children[i]);
+            }
+            os << "]";
+        }
+        os << "}";
+    }
+}
+
+void instance_bounds(const Mesh &mesh, const GlbWriter::Matrix &matrix, std::array<double, 3> &min,
+                     std::array<double, 3> &max) {
+    std::array<float, 3> local_min;
+    std::array<float, 3> local_max;
+    position_bounds(mesh.positions, local_min, local_max);
+
+    // The world box is the box of the eight transformed corners
+    min.fill(std::numeric_limits<double>::max());
+    max.fill(std::numeric_limits<double>::lowest());
+    for (int corner = 0; corner < 8; ++corner) {
+        const double p[3] = {
+            corner & 1 ? local_max[0] : local_min[0],
+            corner & 2 ? local_max[1] : local_min[1],
+            corner & 4 ? local_max[2] : local_min[2]
+        };
+        for (int row = 0; row < 3; ++row) {
+            const double value = matrix[row] * p[0] + matrix[4 + row] * p[1] + matrix[8 + row] * p[2] +
+                                 matrix[12 + row];
+            min[row] = std::min(min[row], value);
+            max[row] = std::max(max[row], value);
+        }
+    }
+}
+
+std::size_t write_tileset(const std::filesystem::path &directory, const std::vector<TileInstance> &instances,
+                          const TilesetOptions &options) {
+    if (instances.empty()) {
+        throw std::invalid_argument("Cannot write a tileset without geometry");
+    }
+
+    // The root is the cube around all instances
+    std::array<double, 3> min;
+    std::array<double, 3> max;
+    min.fill(std::numeric_limits<double>::max());
+    max.fill(std::numeric_limits<double>::lowest());
+    for (const auto &instance: instances) {
+        expand(min, max, instance.min, instance.max);
+    }
+    std::array<double, 3> center{};
+    double half_size = 0.0;
+    for (int k = 0; k < 3; ++k) {
+        center[k] = (min[k] + max[k]) / 2.0;
+        half_size = std::max(half_size, (max[k] - min[k]) / 2.0);
+    }
+
+    std::vector<std::size_t> items(instances.size());
+    for (std::size_t i = 0; i < items.size(); ++i) {
+        items[i] = i;
+    }
+    OctreeBuilder builder(instances, options);
+    builder.build(center, half_size, std::move(items), 0);
+    const auto &tiles = builder.tiles();
+
+    create_directories(directory / "tiles");
+
+    // Every tile is a GLB of its own, so the tiles are written in parallel with one thread each
+    std::vector<std::size_t> content_tiles;
+    for (std::size_t i = 0; i < tiles.size(); ++i) {
+        if (!tiles[i].content.empty()) {
+            content_tiles.push_back(i);
+        }
+    }
+    // A tile beyond the buffer limit is written as a .gltf with external buffers instead of a GLB
+    std::vector<std::string> content_uris(tiles.size());
+    std::vector<std::exception_ptr> errors(content_tiles.size());
+    parallel_for_each_index(content_tiles.size(), options.glb.num_threads, [&](const std::size_t i) {
+        try {
+            const std::size_t index = content_tiles[i];
+            GlbOptions glb_options = options.glb;
+            glb_options.num_threads = 1;
+            GlbWriter writer(glb_options);
+            const int root = writer.add_node("tile_" + std::to_string(index), -1, Z_UP_TO_Y_UP);
+            writer.add_root(root);
+            // Meshes are written once per tile, however often they are placed in it
+            std::map<const Mesh *, int> meshes;
+            for (const auto item: tiles[index].content) {
+                const auto &instance = instances[item];
+                auto [it, inserted] = meshes.try_emplace(instance.mesh, -1);
+                if (inserted) {
+                    it->second = writer.add_mesh(*instance.mesh, instance.name);
+                }
+                writer.add_child(root, writer.add_node(instance.name, it->second, instance.matrix));
+            }
+            const auto files = writer.write(directory / "tiles" / (std::to_string(index) + ".glb"));
+            content_uris[index] = files.front().lexically_relative(directory).generic_string();
+        } catch (...) {
+            errors[i] = std::current_exception();
+        }
+    });
+    for (const auto &error: errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    std::ofstream file(directory / "tileset.json");
+    if (!file.is_open()) {
+        throw std::runtime_error("Error opening tileset for writing: " + (directory / "tileset.json").string());
+    }
+    file << std::setprecision(std::numeric_limits<double>::max_digits10);
+    file << R"({"asset":{"version":"1.1","generator":"STP2GLB"},"geometricError":)"
+            << tiles[0].max_diagonal << R"(,"root":)";
+    write_tile(file, tiles, content_uris, 0);
+    file << "}";
+    if (!file) {
+        throw std::runtime_error("Error writing tileset: " + (directory / "tileset.json").string());
+    }
+    return tiles.size();
+}
@@ -0,0 +1,46 @@
+#ifndef TILESET_WRITER_H
+#define TILESET_WRITER_H
+
+#include <array>
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "glb_writer.h"
+#include "../../geom/Mesh.h"
+
+// One placed mesh of the model
+struct TileInstance {
+    const Mesh *mesh;
+    // World transformation of the mesh
+    GlbWriter::Matrix matrix;
+    // World space bounding box
+    std::array<double, 3> min;
+    std::array<double, 3> max;
+    std::string name;
+};
+
+struct TilesetOptions {
+    // A tile is split into octants while its instances hold more triangles than this
+    std::size_t max_tile_triangles = 500000;
+    int max_depth = 12;
+    // Options of the tile GLBs. num_threads is the number of tiles written at once.
+    GlbOptions glb;
+};
+
+// World space bounding box of a mesh placed with matrix
+void instance_bounds(const Mesh &mesh, const GlbWriter::Matrix &matrix, std::array<double, 3> &min,
+                     std::array<double, 3> &max);
+
+// Writes a 3D Tiles tileset: directory/tileset.json and one GLB per tile in directory/tiles (a .gltf with external
+// buffers for a tile beyond options.glb.max_buffer_size).
+//
+// The instances are partitioned by an octree over their world bounds. Instances larger than half of an octree cell
+// stay in the tile of that cell, the others move down to the octant holding their center, so coarse tiles carry the
+// large parts and are refined additively by the small ones. The geometric error of a tile is the largest instance
+// diagonal in its children. Instances and bounding volumes are in the Z-up tileset frame; the tile GLBs hold them
+// below a root node that turns them Y up, as 3D Tiles requires of glTF content. Returns the number of tiles.
+std::size_t write_tileset(const std::filesystem::path &directory, const std::vector<TileInstance> &instances,
+                          const TilesetOptions &options);
+
+#endif //TILESET_WRITER_H
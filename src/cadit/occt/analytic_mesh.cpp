@@ -0,0 +1,600 @@
+#include "analytic_mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <numbers>
+#include <optional>
+#include <vector>
+#include <BRep_Builder.hxx>
+#include <BRep_Tool.hxx>
+#include <BRepAdaptor_Curve.hxx>
+#include <BRepAdaptor_Curve2d.hxx>
+#include <BRepAdaptor_Surface.hxx>
+#include <BRepTools.hxx>
+#include <BRepTools_WireExplorer.hxx>
+#include <Poly_PolygonOnTriangulation.hxx>
+#include <Poly_Triangulation.hxx>
+#include <TColStd_Array1OfInteger.hxx>
+#include <TColStd_Array1OfReal.hxx>
+#include <TopExp.hxx>
+#include <TopExp_Explorer.hxx>
+#include <TopoDS.hxx>
+#include <TopoDS_Edge.hxx>
+#include <TopoDS_Face.hxx>
+#include <TopoDS_Vertex.hxx>
+#include <TopoDS_Wire.hxx>
+#include <TopTools_IndexedMapOfShape.hxx>
+
+namespace {
+    // Boundary polygons of planar faces above this size are left to BRepMesh (ear clipping is quadratic)
+    constexpr std::size_t MAX_PLANAR_BOUNDARY_NODES = 2000;
+
+    struct EdgeSamples {
+        std::vector<double> params;
+        std::vector<gp_Pnt> points; // In the coordinate system of the shape
+        bool degenerated = false;
+    };
+
+    // One occurrence of an edge in the boundary of a face (a seam edge occurs twice)
+    struct EdgeUse {
+        TopoDS_Edge edge;
+        const EdgeSamples *samples = nullptr;
+        std::vector<gp_Pnt2d> uv;
+        std::vector<int> nodes;
+    };
+
+    struct FaceMesh {
+        std::vector<gp_Pnt> nodes;
+        std::vector<gp_Pnt2d> uvs;
+        std::vector<std::array<int, 3> > triangles;
+
+        // Returns the 1-based node index used by Poly_Triangulation
+        int add_node(const gp_Pnt &point, const gp_Pnt2d &uv) {
+            nodes.push_back(point);
+            uvs.push_back(uv);
+            return static_cast<int>(nodes.size());
+        }
+
+        void add_triangle(const int a, const int b, const int c) {
+            if (a != b && b != c && a != c) {
+                triangles.push_back({a, b, c});
+            }
+        }
+    };
+
+    // Number of segments needed for an arc to stay within both the linear and the angular deflection
+    int arc_segments(const double radius, const double span, const IMeshTools_Parameters &params) {
+        double step = params.Angle;
+        if (radius > params.Deflection) {
+            step = std::min(step, 2.0 * std::acos(1.0 - params.Deflection / radius));
+        }
+        step = std::max(step, 1.0e-3);
+        const int min_segments = std::abs(span) > std::numbers::pi ? 3 : 1;
+        return std::max(min_segments, static_cast<int>(std::ceil(std::abs(span) / step - 1.0e-9)));
+    }
+
+    // Closed-form discretization of lines and circles. Other curves are left to BRepMesh.
+    std::optional<EdgeSamples> discretize_edge(const TopoDS_Edge &edge, const IMeshTools_Parameters &params) {
+        EdgeSamples samples;
+        TopoDS_Vertex first_vertex, last_vertex;
+        TopExp::Vertices(edge, first_vertex, last_vertex);
+        if (first_vertex.IsNull() || last_vertex.IsNull()) {
+            return std::nullopt;
+        }
+
+        if (BRep_Tool::Degenerated(edge)) {
+            Standard_Real first, last;
+            BRep_Tool::Range(edge, first, last);
+            const gp_Pnt pole = BRep_Tool::Pnt(first_vertex);
+            samples.params = {first, last};
+            samples.points = {pole, pole};
+            samples.degenerated = true;
+            return samples;
+        }
+
+        const BRepAdaptor_Curve curve(edge);
+        const double first = curve.FirstParameter();
+        const double last = curve.LastParameter();
+        int num_segments;
+        switch (curve.GetType()) {
+            case GeomAbs_Line:
+                num_segments = 1;
+                break;
+            case GeomAbs_Circle:
+                num_segments = arc_segments(curve.Circle().Radius(), last - first, params);
+                break;
+            default:
+                return std::nullopt;
+        }
+
+        for (int i = 0; i <= num_segments; ++i) {
+            const double t = first + (last - first) * i / num_segments;
+            samples.params.push_back(t);
+            samples.points.push_back(curve.Value(t));
+        }
+        // The end points are the vertices, so that neighbouring edges share them exactly
+        samples.points.front() = BRep_Tool::Pnt(first_vertex);
+        samples.points.back() = BRep_Tool::Pnt(last_vertex);
+        return samples;
+    }
+
+    EdgeUse make_use(const TopoDS_Edge &edge, const TopoDS_Face &face, const EdgeSamples &samples) {
+        EdgeUse use;
+        use.edge = edge;
+        use.samples = &samples;
+        const BRepAdaptor_Curve2d pcurve(edge, face);
+        for (const double t: samples.params) {
+            use.uv.push_back(pcurve.Value(t));
+        }
+        use.nodes.assign(samples.params.size(), 0);
+        return use;
+    }
+
+    std::optional<AnalyticSurface> analytic_type(const GeomAbs_SurfaceType type) {
+        switch (type) {
+            case GeomAbs_Plane: return AnalyticSurface::Plane;
+            case GeomAbs_Cylinder: return AnalyticSurface::Cylinder;
+            case GeomAbs_Cone: return AnalyticSurface::Cone;
+            case GeomAbs_Sphere: return AnalyticSurface::Sphere;
+            case GeomAbs_Torus: return AnalyticSurface::Torus;
+            default: return std::nullopt;
+        }
+    }
+
+    // Radius of the circle traced by u at a fixed v. All supported curved surfaces use u as the angle.
+    double row_radius(const BRepAdaptor_Surface &surface, const double v) {
+        switch (surface.GetType()) {
+            case GeomAbs_Cylinder:
+                return surface.Cylinder().Radius();
+            case GeomAbs_Cone:
+                return std::abs(surface.Cone().RefRadius() + v * std::sin(surface.Cone().SemiAngle()));
+            case GeomAbs_Sphere:
+                return surface.Sphere().Radius() * std::cos(v);
+            case GeomAbs_Torus:
+                return surface.Torus().MajorRadius() + surface.Torus().MinorRadius() * std::cos(v);
+            default:
+                return 0.0;
+        }
+    }
+
+    struct RowNode {
+        double s; // u along a row, v along a column
+        int node;
+    };
+
+    // Joins two rows of increasing u with triangles that are counter-clockwise in the parameter space,
+    // i.e. oriented along the natural normal of the surface as Poly_Triangulation expects.
+    void zip_rows(const std::vector<RowNode> &lower, const std::vector<RowNode> &upper, FaceMesh &mesh) {
+        std::size_t i = 0;
+        std::size_t k = 0;
+        while (i + 1 < lower.size() || k + 1 < upper.size()) {
+            const bool advance_lower = k + 1 >= upper.size() ||
+                                       (i + 1 < lower.size() && lower[i + 1].s < upper[k + 1].s);
+            if (advance_lower) {
+                mesh.add_triangle(lower[i].node, lower[i + 1].node, upper[k].node);
+                ++i;
+            } else {
+                mesh.add_triangle(lower[i].node, upper[k + 1].node, upper[k].node);
+                ++k;
+            }
+        }
+    }
+
+    struct SidePoint {
+        double s;
+        std::size_t use;
+        std::size_t sample;
+    };
+
+    // Sorts the samples of the edges on one side of the parameter rectangle and merges the shared vertices.
+    // Returns groups of samples that map to the same node.
+    std::vector<std::vector<SidePoint> > merge_side(std::vector<SidePoint> points, const double tolerance) {
+        std::sort(points.begin(), points.end(), [](const SidePoint &a, const SidePoint &b) { return a.s < b.s; });
+        std::vector<std::vector<SidePoint> > groups;
+        for (const auto &point: points) {
+            if (groups.empty() || point.s - groups.back().front().s > tolerance) {
+                groups.push_back({point});
+            } else {
+                groups.back().push_back(point);
+            }
+        }
+        return groups;
+    }
+
+    // Meshes a surface of revolution bounded by iso-parametric edges row by row between its boundary edges.
+    bool build_grid_face(const BRepAdaptor_Surface &surface, std::vector<EdgeUse> &uses,
+                         const IMeshTools_Parameters &params, FaceMesh &mesh) {
+        double umin = std::numeric_limits<double>::max(), umax = std::numeric_limits<double>::lowest();
+        double vmin = umin, vmax = umax;
+        for (const auto &use: uses) {
+            for (const auto &uv: use.uv) {
+                umin = std::min(umin, uv.X());
+                umax = std::max(umax, uv.X());
+                vmin = std::min(vmin, uv.Y());
+                vmax = std::max(vmax, uv.Y());
+            }
+        }
+        const double tol_u = 1.0e-7 * std::max(1.0, umax - umin);
+        const double tol_v = 1.0e-7 * std::max(1.0, vmax - vmin);
+        if (umax - umin <= tol_u || vmax - vmin <= tol_v) {
+            return false;
+        }
+
+        std::vector<SidePoint> bottom, top, left, right;
+        std::vector<std::size_t> bottom_uses, top_uses;
+        for (std::size_t i = 0; i < uses.size(); ++i) {
+            const auto &uv = uses[i].uv;
+            const gp_Pnt2d &a = uv.front();
+            const gp_Pnt2d &b = uv.back();
+            std::vector<SidePoint> *side;
+            bool along_u;
+            if (std::abs(a.Y() - b.Y()) <= tol_v) {
+                along_u = true;
+                if (std::abs(a.Y() - vmin) <= tol_v) {
+                    side = &bottom;
+                    bottom_uses.push_back(i);
+                } else if (std::abs(a.Y() - vmax) <= tol_v) {
+                    side = &top;
+                    top_uses.push_back(i);
+                } else {
+                    return false;
+                }
+            } else if (std::abs(a.X() - b.X()) <= tol_u && !uses[i].samples->degenerated) {
+                along_u = false;
+                if (std::abs(a.X() - umin) <= tol_u) {
+                    side = &left;
+                } else if (std::abs(a.X() - umax) <= tol_u) {
+                    side = &right;
+                } else {
+                    return false;
+                }
+            } else {
+                return false;
+            }
+            for (std::size_t k = 0; k < uv.size(); ++k) {
+                side->push_back({along_u ? uv[k].X() : uv[k].Y(), i, k});
+            }
+        }
+        if (bottom.empty() || top.empty() || left.empty() || right.empty()) {
+            return false;
+        }
+
+        // Rows along u at vmin and vmax. A side made of degenerated edges collapses into a single pole node.
+        auto build_boundary_row = [&](const std::vector<SidePoint> &points, const std::vector<std::size_t> &side_uses,
+                                      const double v, std::vector<RowNode> &row) {
+            const bool is_pole = std::all_of(side_uses.begin(), side_uses.end(), [&](const std::size_t i) {
+                return uses[i].samples->degenerated;
+            });
+            if (is_pole) {
+                const int node = mesh.add_node(uses[side_uses.front()].samples->points.front(),
+                                               gp_Pnt2d(0.5 * (umin + umax), v));
+                for (const auto &point: points) {
+                    uses[point.use].nodes[point.sample] = node;
+                }
+                row.push_back({umin, node});
+                return true;
+            }
+            if (std::any_of(side_uses.begin(), side_uses.end(), [&](const std::size_t i) {
+                return uses[i].samples->degenerated;
+            })) {
+                return false;
+            }
+            for (const auto &group: merge_side(points, tol_u)) {
+                const auto &first = group.front();
+                const int node = mesh.add_node(uses[first.use].samples->points[first.sample],
+                                               uses[first.use].uv[first.sample]);
+                for (const auto &point: group) {
+                    uses[point.use].nodes[point.sample] = node;
+                }
+                row.push_back({first.s, node});
+            }
+            return std::abs(row.front().s - umin) <= tol_u && std::abs(row.back().s - umax) <= tol_u;
+        };
+
+        std::vector<RowNode> bottom_row, top_row;
+        if (!build_boundary_row(bottom, bottom_uses, vmin, bottom_row) ||
+            !build_boundary_row(top, top_uses, vmax, top_row)) {
+            return false;
+        }
+
+        // Columns along v at umin and umax. Their end points are the corners of the boundary rows.
+        auto build_column = [&](const std::vector<SidePoint> &points, const int first_node, const int last_node,
+                                std::vector<RowNode> &column) {
+            const auto groups = merge_side(points, tol_v);
+            for (std::size_t g = 0; g < groups.size(); ++g) {
+                const auto &first = groups[g].front();
+                int node;
+                if (g == 0) {
+                    node = first_node;
+                } else if (g + 1 == groups.size()) {
+                    node = last_node;
+                } else {
+                    node = mesh.add_node(uses[first.use].samples->points[first.sample], uses[first.use].uv[first.sample]);
+                }
+                for (const auto &point: groups[g]) {
+                    uses[point.use].nodes[point.sample] = node;
+                }
+                column.push_back({first.s, node});
+            }
+            return column.size() >= 2 && std::abs(column.front().s - vmin) <= tol_v &&
+                   std::abs(column.back().s - vmax) <= tol_v;
+        };
+
+        std::vector<RowNode> left_column, right_column;
+        if (!build_column(left, bottom_row.front().node, top_row.front().node, left_column) ||
+            !build_column(right, bottom_row.back().node, top_row.back().node, right_column)) {
+            return false;
+        }
+        // Interior rows run between matching nodes on both columns
+        if (left_column.size() != right_column.size()) {
+            return false;
+        }
+        for (std::size_t j = 0; j < left_column.size(); ++j) {
+            if (std::abs(left_column[j].s - right_column[j].s) > tol_v) {
+                return false;
+            }
+        }
+
+        std::vector<RowNode> previous = bottom_row;
+        for (std::size_t j = 1; j + 1 < left_column.size(); ++j) {
+            const double v = left_column[j].s;
+            const int num_segments = arc_segments(row_radius(surface, v), umax - umin, params);
+            std::vector<RowNode> row{{umin, left_column[j].node}};
+            for (int k = 1; k < num_segments; ++k) {
+                const double u = umin + (umax - umin) * k / num_segments;
+                row.push_back({u, mesh.add_node(surface.Value(u, v), gp_Pnt2d(u, v))});
+            }
+            row.push_back({umax, right_column[j].node});
+            zip_rows(previous, row, mesh);
+            previous = std::move(row);
+        }
+        zip_rows(previous, top_row, mesh);
+
+        return !mesh.triangles.empty();
+    }
+
+    // Ear clipping of a simple polygon given by node indices, in the parameter space of the face
+    bool clip_ears(std::vector<int> polygon, FaceMesh &mesh) {
+        auto uv = [&](const int node) -> const gp_Pnt2d & { return mesh.uvs[node - 1]; };
+        auto cross = [&](const int a, const int b, const int c) {
+            const gp_Pnt2d &pa = uv(a), &pb = uv(b), &pc = uv(c);
+            return (pb.X() - pa.X()) * (pc.Y() - pa.Y()) - (pb.Y() - pa.Y()) * (pc.X() - pa.X());
+        };
+
+        double area = 0.0;
+        for (std::size_t i = 0; i < polygon.size(); ++i) {
+            const gp_Pnt2d &a = uv(polygon[i]);
+            const gp_Pnt2d &b = uv(polygon[(i + 1) % polygon.size()]);
+            area += a.X() * b.Y() - b.X() * a.Y();
+        }
+        if (area < 0.0) {
+            std::reverse(polygon.begin(), polygon.end());
+        }
+        const double eps = 1.0e-12 * std::abs(area);
+
+        while (polygon.size() > 3) {
+            bool clipped = false;
+            for (std::size_t i = 0; i < polygon.size(); ++i) {
+                const int a = polygon[(i + polygon.size() - 1) % polygon.size()];
+                const int b = polygon[i];
+                const int c = polygon[(i + 1) % polygon.size()];
+                if (cross(a, b, c) <= eps) {
+                    continue;
+                }
+                const bool contains_other = std::any_of(polygon.begin(), polygon.end(), [&](const int p) {
+                    return p != a && p != b && p != c &&
+                           cross(a, b, p) >= 0.0 && cross(b, c, p) >= 0.0 && cross(c, a, p) >= 0.0;
+                });
+                if (contains_other) {
+                    continue;
+                }
+                mesh.add_triangle(a, b, c);
+                polygon.erase(polygon.begin() + static_cast<std::ptrdiff_t>(i));
+                clipped = true;
+                break;
+            }
+            if (!clipped) {
+                return false;
+            }
+        }
+        mesh.add_triangle(polygon[0], polygon[1], polygon[2]);
+        return true;
+    }
+
+    // Triangulates a planar face with a single wire from the discretization of its boundary
+    bool build_planar_face(std::vector<EdgeUse> &uses, FaceMesh &mesh) {
+        std::vector<int> polygon;
+        std::vector<int> first_nodes;
+        for (auto &use: uses) {
+            if (use.samples->degenerated) {
+                return false;
+            }
+            const bool reversed = use.edge.Orientation() == TopAbs_REVERSED;
+            const std::size_t n = use.uv.size();
+            // The last sample of an edge is the first one of the next edge in the wire
+            for (std::size_t t = 0; t + 1 < n; ++t) {
+                const std::size_t k = reversed ? n - 1 - t : t;
+                const int node = mesh.add_node(use.samples->points[k], use.uv[k]);
+                use.nodes[k] = node;
+                polygon.push_back(node);
+            }
+            first_nodes.push_back(use.nodes[reversed ? n - 1 : 0]);
+        }
+        for (std::size_t i = 0; i < uses.size(); ++i) {
+            auto &use = uses[i];
+            const bool reversed = use.edge.Orientation() == TopAbs_REVERSED;
+            use.nodes[reversed ? 0 : use.nodes.size() - 1] = first_nodes[(i + 1) % uses.size()];
+        }
+        if (polygon.size() < 3 || polygon.size() > MAX_PLANAR_BOUNDARY_NODES) {
+            return false;
+        }
+        return clip_ears(polygon, mesh);
+    }
+
+    Handle(Poly_PolygonOnTriangulation) make_polygon(const EdgeUse &use, const double deflection) {
+        const auto n = static_cast<Standard_Integer>(use.nodes.size());
+        TColStd_Array1OfInteger nodes(1, n);
+        TColStd_Array1OfReal params(1, n);
+        for (Standard_Integer i = 1; i <= n; ++i) {
+            nodes.SetValue(i, use.nodes[i - 1]);
+            params.SetValue(i, use.samples->params[i - 1]);
+        }
+        Handle(Poly_PolygonOnTriangulation) polygon = new Poly_PolygonOnTriangulation(nodes, params);
+        polygon->Deflection(deflection);
+        return polygon;
+    }
+
+    // Stores the mesh as the triangulation of the face and the edge nodes as polygons on it, as BRepMesh does
+    void write_face(const TopoDS_Face &face, const FaceMesh &mesh, const std::vector<EdgeUse> &uses,
+                    const double deflection) {
+        // Triangulations are stored in the coordinate system of the face
+        const TopLoc_Location &location = face.Location();
+        const gp_Trsf to_local = location.Transformation().Inverted();
+
+        Handle(Poly_Triangulation) triangulation = new Poly_Triangulation(
+            static_cast<Standard_Integer>(mesh.nodes.size()), static_cast<Standard_Integer>(mesh.triangles.size()),
+            Standard_True);
+        for (std::size_t i = 0; i < mesh.nodes.size(); ++i) {
+            const auto index = static_cast<Standard_Integer>(i + 1);
+            triangulation->SetNode(index, location.IsIdentity() ? mesh.nodes[i] : mesh.nodes[i].Transformed(to_local));
+            triangulation->SetUVNode(index, mesh.uvs[i]);
+        }
+        for (std::size_t i = 0; i < mesh.triangles.size(); ++i) {
+            const auto &t = mesh.triangles[i];
+            triangulation->SetTriangle(static_cast<Standard_Integer>(i + 1), Poly_Triangle(t[0], t[1], t[2]));
+        }
+        triangulation->Deflection(deflection);
+
+        BRep_Builder builder;
+        builder.UpdateFace(face, triangulation);
+
+        std::vector<bool> written(uses.size(), false);
+        for (std::size_t i = 0; i < uses.size(); ++i) {
+            if (written[i]) {
+                continue;
+            }
+            written[i] = true;
+            const auto &use = uses[i];
+            // A seam edge carries one polygon per pcurve, the first one for the forward orientation
+            std::size_t seam = uses.size();
+            for (std::size_t j = i + 1; j < uses.size(); ++j) {
+                if (!written[j] && uses[j].edge.IsSame(use.edge)) {
+                    seam = j;
+                    break;
+                }
+            }
+            if (seam == uses.size()) {
+                builder.UpdateEdge(use.edge, make_polygon(use, deflection), triangulation, location);
+                continue;
+            }
+            written[seam] = true;
+            const bool forward_first = use.edge.Orientation() == TopAbs_FORWARD;
+            const auto &forward = forward_first ? use : uses[seam];
+            const auto &reversed = forward_first ? uses[seam] : use;
+            builder.UpdateEdge(use.edge, make_polygon(forward, deflection), make_polygon(reversed, deflection),
+                               triangulation, location);
+        }
+    }
+}
+
+std::size_t AnalyticMeshStats::num_fast() const {
+    std::size_t total = 0;
+    for (const auto count: fast_faces) {
+        total += count;
+    }
+    return total;
+}
+
+AnalyticMeshStats mesh_analytic_faces(const TopoDS_Shape &shape, const IMeshTools_Parameters &params) {
+    AnalyticMeshStats stats;
+    BRepTools::Clean(shape);
+
+    // Every edge is discretized once, so that all faces sharing it get the same nodes
+    TopTools_IndexedMapOfShape edges;
+    TopExp::MapShapes(shape, TopAbs_EDGE, edges);
+    std::vector<std::optional<EdgeSamples> > samples(edges.Extent());
+    for (Standard_Integer i = 1; i <= edges.Extent(); ++i) {
+        samples[i - 1] = discretize_edge(TopoDS::Edge(edges(i)), params);
+    }
+
+    TopTools_IndexedMapOfShape faces;
+    TopExp::MapShapes(shape, TopAbs_FACE, faces);
+    for (Standard_Integer f = 1; f <= faces.Extent(); ++f) {
+        ++stats.num_faces;
+        // Work on the forward face, so that edge orientations select the pcurves as BRepMesh does
+        const TopoDS_Face face = TopoDS::Face(faces(f).Oriented(TopAbs_FORWARD));
+        const BRepAdaptor_Surface surface(face, Standard_False);
+        const auto type = analytic_type(surface.GetType());
+        if (!type) {
+            continue;
+        }
+
+        TopTools_IndexedMapOfShape wires;
+        TopExp::MapShapes(face, TopAbs_WIRE, wires);
+        if (wires.Extent() != 1) {
+            continue;
+        }
+
+        std::vector<EdgeUse> uses;
+        bool supported = true;
+        auto add_use = [&](const TopoDS_Edge &edge) {
+            const Standard_Integer index = edges.FindIndex(edge);
+            if (index == 0 || !samples[index - 1]) {
+                supported = false;
+                return;
+            }
+            uses.push_back(make_use(edge, face, *samples[index - 1]));
+        };
+
+        FaceMesh mesh;
+        if (*type == AnalyticSurface::Plane) {
+            // Planar faces need the edges in wire order
+            Standard_Integer num_edges = 0;
+            for (TopExp_Explorer explorer(wires(1), TopAbs_EDGE); explorer.More(); explorer.Next()) {
+                ++num_edges;
+            }
+            for (BRepTools_WireExplorer explorer(TopoDS::Wire(wires(1)), face); explorer.More() && supported;
+                 explorer.Next()) {
+                add_use(explorer.Current());
+            }
+            supported = supported && static_cast<Standard_Integer>(uses.size()) == num_edges &&
+                        build_planar_face(uses, mesh);
+        } else {
+            for (TopExp_Explorer explorer(face, TopAbs_EDGE); explorer.More() && supported; explorer.Next()) {
+                add_use(TopoDS::Edge(explorer.Current()));
+            }
+            supported = supported && std::all_of(uses.begin(), uses.end(), [&](const EdgeUse &use) {
+                return BRepAdaptor_Curve2d(use.edge, face).GetType() == GeomAbs_Line;
+            }) && build_grid_face(surface, uses, params, mesh);
+        }
+        if (!supported) {
+            continue;
+        }
+
+        write_face(face, mesh, uses, params.Deflection);
+        ++stats.fast_faces[static_cast<std::size_t>(*type)];
+    }
+    return stats;
+}
+
+void AnalyticMeshReport::add(const AnalyticMeshStats &stats) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    total_.num_faces += stats.num_faces;
+    for (std::size_t i = 0; i < stats.fast_faces.size(); ++i) {
+        total_.fast_faces[i] += stats.fast_faces[i];
+    }
+}
+
+void AnalyticMeshReport::print(std::ostream &os) const {
+    const std::size_t num_fast = total_.num_fast();
+    os << "Analytic fast path: " << num_fast << " of " << total_.num_faces << " faces";
+    if (total_.num_faces > 0) {
+        os << " (" << std::fixed << std::setprecision(1)
+                << 100.0 * static_cast<double>(num_fast) / static_cast<double>(total_.num_faces) << "%)";
+    }
+    os << ". Plane: " << total_.fast_faces[0] << ", cylinder: " << total_.fast_faces[1] << ", cone: "
+            << total_.fast_faces[2] << ", sphere: " << total_.fast_faces[3] << ", torus: " << total_.fast_faces[4]
+            << "\n";
+}
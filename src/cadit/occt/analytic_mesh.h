@@ -0,0 +1,50 @@
+#ifndef ANALYTIC_MESH_H
+#define ANALYTIC_MESH_H
+
+#include <array>
+#include <cstddef>
+#include <mutex>
+#include <ostream>
+#include <IMeshTools_Parameters.hxx>
+#include <TopoDS_Shape.hxx>
+
+// Surface types handled by the analytic fast path
+enum class AnalyticSurface {
+    Plane = 0,
+    Cylinder,
+    Cone,
+    Sphere,
+    Torus
+};
+
+struct AnalyticMeshStats {
+    std::size_t num_faces = 0;
+    std::array<std::size_t, 5> fast_faces{};
+
+    [[nodiscard]] std::size_t num_fast() const;
+};
+
+// Triangulates the analytic faces of shape from closed-form generators.
+//
+// Lines and circles are discretized once per edge and shared by all faces using the edge. Planar faces with a
+// single wire are triangulated from their boundary polygon. Cylinders, cones, spheres and tori whose boundary
+// consists of iso-parametric edges only are meshed row by row between the boundary edges. Every written face
+// gets a triangulation and polygons on its edges, so a following BRepMesh_IncrementalMesh with CleanModel
+// disabled keeps them and meshes the remaining faces against the same edge nodes.
+//
+// Existing triangulations of the shape are removed first. Relative deflection is not supported.
+AnalyticMeshStats mesh_analytic_faces(const TopoDS_Shape &shape, const IMeshTools_Parameters &params);
+
+// Accumulates the share of faces meshed by the analytic fast path. Safe to call from several threads.
+class AnalyticMeshReport {
+public:
+    void add(const AnalyticMeshStats &stats);
+
+    void print(std::ostream &os) const;
+
+private:
+    std::mutex mutex_;
+    AnalyticMeshStats total_;
+};
+
+#endif //ANALYTIC_MESH_H
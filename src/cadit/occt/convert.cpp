@@ -1,9 +1,9 @@
 #include "convert.h"
 #include <STEPCAFControl_Reader.hxx>
 #include <XCAFDoc_DocumentTool.hxx>
-#include <RWGltf_CafWriter.hxx>
 #include <TDocStd_Document.hxx>
 #include <BRepMesh_IncrementalMesh.hxx>
+#include <chrono>
 #include <filesystem>
 #include <XSControl_TransferReader.hxx>
 #include <Transfer_TransientProcess.hxx>
@@ -12,14 +12,58 @@
 #include <Interface_Static.hxx>
 #include <Standard_Type.hxx>
 #include <map>
+#include <mutex>
+#include <optional>
 #include <StepData_StepModel.hxx>
+#include <TopExp.hxx>
+#include <TopTools_DataMapOfShapeInteger.hxx>
+#include <TopTools_IndexedMapOfShape.hxx>
+#include <TransferBRep.hxx>
+#include <TDF_Tool.hxx>
+#include <XCAFDoc_ColorTool.hxx>
 #include <XSControl_WorkSession.hxx>
 
+#include "analytic_mesh.h"
+#include "cost_model.h"
 #include "custom_progress.h"
 #include "geometry_iterator.h"
+#include "gltf_writer.h"
+#include "helpers.h"
+#include "mesh_extract.h"
+#include "mesh_params.h"
+#include "shape_metrics.h"
+#include "step_hash.h"
 #include "step_helpers.h"
 #include "step_tree.h"
+#include "task_scheduler.h"
+#include "triangle_budget.h"
+#include "../../geom/mesh_optimize.h"
 #include "../../config_structs.h"
+#include "../../json_utils.h"
+#include "../../trace.h"
+
+// Shapes predicted not to finish within the timeout are meshed coarser up front, at most by MAX_COARSENING
+constexpr double MAX_COARSENING = 10.0;
+// A timed out shape would have taken longer than it ran. It is recorded at this many times the timeout, so the
+// fit, which is pulled towards the prior, still predicts such shapes above the timeout.
+constexpr double TIMEOUT_COST_FACTOR = 2.0;
+
+// Mesh parameters of a level of detail. The angular deflection is coarsened by the same ratio as the linear one.
+// Every level is meshed from scratch (CleanModel of base): the previous, coarser triangulation never satisfies a
+// finer level, and meshing fine to coarse would keep the fine triangulation for every level.
+static IMeshTools_Parameters make_lod_params(const IMeshTools_Parameters& base, const GlobalConfig& config,
+                                             const std::size_t level)
+{
+    const double deflection = config.lod_deflections[level];
+    const double ratio = deflection / config.lod_deflections.front();
+
+    IMeshTools_Parameters params = base;
+    params.Deflection = deflection;
+    params.DeflectionInterior = deflection;
+    params.Angle = std::min(config.angularDeflection * ratio, 1.0);
+    params.AngleInterior = params.Angle;
+    return params;
+}
 
 void convert_stp_to_glb(const GlobalConfig& config)
 {
@@ -33,23 +77,22 @@ void convert_stp_to_glb(const GlobalConfig& config)
     reader.SetMatMode(true);
     reader.SetViewMode(false);
 
-    // Mesh parameters
-    IMeshTools_Parameters meshParams;
-    meshParams.Angle = config.angularDeflection;
-    meshParams.Deflection = config.linearDeflection;
-    meshParams.Relative = config.relativeDeflection;
-    meshParams.MinSize = 0.1;
-    meshParams.AngleInterior = 0.5;
-    meshParams.DeflectionInterior = 0.1;
-    meshParams.CleanModel = Standard_True;
-    meshParams.InParallel = Standard_True;
-    meshParams.AllowQualityDecrease = Standard_True;
+    // Mesh parameters. With more than one worker the shapes are meshed concurrently, each on one thread.
+    const IMeshTools_Parameters meshParams = make_mesh_params(config, resolve_num_threads(config.num_threads) <= 1);
+    const bool use_auto_deflection = config.autoDeflection > 0.0 && config.lod_deflections.empty();
+    DeflectionReport deflection_report(config.linearDeflection, config.relativeDeflection);
+    // The analytic generators work with absolute deflections only
+    const bool use_analytic_mesh = config.analyticFastPath && config.lod_deflections.empty() &&
+        (use_auto_deflection || !config.relativeDeflection);
+    AnalyticMeshReport analytic_report;
 
     // Read the STEP file
     auto start = std::chrono::high_resolution_clock::now();
     std::cout << "Reading STEP file: " << config.stpFile << std::endl;
+    TraceScope read_trace("Read STEP file");
     if (reader.ReadFile(config.stpFile.string().c_str()) != IFSelect_RetDone)
         throw std::runtime_error("Error reading STEP file");
+    read_trace.end();
     auto stop = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration<double>(stop - start).count();
 
@@ -58,6 +101,7 @@ void convert_stp_to_glb(const GlobalConfig& config)
     // Transfer to a document
     std::cout << "Transferring data to document" << "\n";
     start = std::chrono::high_resolution_clock::now();
+    TraceScope transfer_trace("Transfer to document");
     const Handle(TDocStd_Document) doc = new TDocStd_Document("MDTV-XCAF");
 
     Handle(CustomProgressIndicator) progress_indicator = new CustomProgressIndicator();
@@ -65,6 +109,7 @@ void convert_stp_to_glb(const GlobalConfig& config)
     // Create a progress range with a default name and range
     if (Message_ProgressRange progressRange = progress_indicator->Start(); !reader.Transfer(doc, progressRange))
         throw std::runtime_error("Error transferring data to document");
+    transfer_trace.end();
 
     stop = std::chrono::high_resolution_clock::now();
     duration = std::chrono::duration<double>(stop - start).count();
@@ -72,53 +117,313 @@ void convert_stp_to_glb(const GlobalConfig& config)
 
     // Tessellation
     const Handle(XCAFDoc_ShapeTool) shapeTool = XCAFDoc_DocumentTool::ShapeTool(doc->Main());
+    const Handle(XCAFDoc_ColorTool) colorTool = XCAFDoc_DocumentTool::ColorTool(doc->Main());
+    const bool use_lods = !config.lod_deflections.empty();
+    const bool use_budget = config.maxTriangles > 0 && !use_lods;
+    // RWGltf_CafWriter writes the face triangulations as they are, so post-processed, compressed or quantized meshes
+    // go through GlbWriter
+    const bool use_glb_writer = use_lods || use_budget || config.optimizeMeshes || config.meshoptCompression ||
+        config.quantize || config.batchMeshes || config.tiles || config.bvhSidecar ||
+        config.maxBufferMb > 0.0;
 
     TDF_LabelSequence labelSeq;
     shapeTool->GetShapes(labelSeq);
     std::vector<ProcessResult> failed_nodes;
 
-    std::cout << "Beginning tessellation of shapes: " << labelSeq.Length() << "\n";
-    start = std::chrono::high_resolution_clock::now();
+    // Assemblies only reference the TShapes of their components. Meshing them concurrently with
+    // the parts would race on the same face triangulations, so only simple shapes are scheduled.
+    struct TessellationJob {
+        Standard_Integer labelIndex;
+        TopoDS_Shape shape;
+        Standard_Integer numFaces;
+        std::string entry;
+        Color color;
+        std::string geometryHash;
+        int entityIndex = 0;
+        std::string name;
+        IMeshTools_Parameters params;
+        double deflection = 0.0;
+        ShapeCostFeatures features;
+        double predictedSeconds = 0.0;
+    };
+    TraceScope jobs_trace("Prepare tessellation jobs");
+    std::vector<TessellationJob> jobs;
+    std::optional<TriangulationCache> cache;
+    if (!config.cacheDir.empty())
+        cache.emplace(config.cacheDir, static_cast<std::uintmax_t>(config.cacheMaxMb) * 1024 * 1024);
+    // Without recorded timings the shapes are ordered by face count
+    std::optional<TessellationCostModel> cost_model;
+    if (!config.costModelFile.empty())
+        cost_model.emplace(config.costModelFile);
+    std::size_t num_coarsened = 0;
+    const Handle(XSControl_TransferReader) transferReader = reader.ChangeReader().WS()->TransferReader();
+    const Handle(StepData_StepModel) model = reader.ChangeReader().StepModel();
+    StepGraphHasher hasher(model);
+    // The entity each transferred shape came from. Looking them up per shape (EntityFromShapeResult) scans every
+    // transfer result each time.
+    TopTools_DataMapOfShapeInteger shape_entities;
+    const Handle(Transfer_TransientProcess) transientProcess = transferReader->TransientProcess();
+    for (Standard_Integer i = 1; i <= transientProcess->NbMapped(); ++i)
+    {
+        const TopoDS_Shape result = TransferBRep::ShapeResult(transientProcess->MapItem(i));
+        if (!result.IsNull() && !shape_entities.IsBound(result))
+            shape_entities.Bind(result, model->Number(transientProcess->Mapped(i)));
+    }
     for (Standard_Integer i = 1; i <= labelSeq.Length(); ++i)
     {
-        auto label = labelSeq.Value(i);
+        const auto& label = labelSeq.Value(i);
+        if (XCAFDoc_ShapeTool::IsAssembly(label))
+            continue;
         TopoDS_Shape shape = XCAFDoc_ShapeTool::GetShape(label);
-        std::cout << "Tessellating shape " << i << " of " << labelSeq.Length() << std::endl;
-        if (!perform_tessellation_with_timeout(shape, meshParams, config.tessellation_timout, progress_indicator)) {
+        if (shape.IsNull())
+            continue;
+        TopTools_IndexedMapOfShape faces;
+        TopExp::MapShapes(shape, TopAbs_FACE, faces);
+        TCollection_AsciiString entry;
+        TDF_Tool::Entry(label, entry);
+        // Reading the STEP model is not safe to do from the workers
+        std::string geometryHash;
+        const Standard_Integer* entityIndex = shape_entities.Seek(shape);
+        if (cache && !use_lods && entityIndex && *entityIndex > 0)
+            geometryHash = hasher.hash(model->Entity(*entityIndex));
+        jobs.push_back({i, shape, faces.Extent(), entry.ToCString(), get_color(label, colorTool).value_or(Color()),
+                        geometryHash});
+
+        auto& job = jobs.back();
+        job.entityIndex = entityIndex ? *entityIndex : 0;
+        job.name = get_label_name(label);
+        job.deflection = config.linearDeflection;
+        job.params = meshParams;
+        if (use_auto_deflection)
+        {
+            job.deflection = shape_deflection(shape, config.autoDeflection, config.linearDeflection);
+            job.params = with_deflection(meshParams, job.deflection);
+        }
+        if (!cost_model)
+            continue;
+        job.features = shape_cost_features(shape, job.params);
+        job.predictedSeconds = cost_model->predict(job.features);
+
+        // Rather than burning the whole timeout on a shape that will not make it, mesh it coarser right away.
+        // Only once the model has seen enough timings to be trusted.
+        if (!use_lods && cost_model->is_trained() && config.tessellation_timout > 0 &&
+            job.predictedSeconds >= config.tessellation_timout)
+        {
+            // Aim at half the timeout
+            const double factor = std::min(2.0 * job.predictedSeconds / config.tessellation_timout, MAX_COARSENING);
+            std::cout << "Shape " << i << " is predicted to take " << std::fixed << std::setprecision(1)
+                << job.predictedSeconds << " s, meshing it " << factor << "x coarser\n";
+            job.params = coarsen_params(job.params, factor);
+            job.deflection *= factor;
+            job.features = shape_cost_features(shape, job.params);
+            job.predictedSeconds = cost_model->predict(job.features);
+            ++num_coarsened;
+        }
+    }
+
+    // Most expensive shapes first, so the long running ones do not end up alone at the tail
+    std::stable_sort(jobs.begin(), jobs.end(), [&cost_model](const TessellationJob& a, const TessellationJob& b)
+    {
+        return cost_model ? a.predictedSeconds > b.predictedSeconds : a.numFaces > b.numFaces;
+    });
+    jobs_trace.end();
+
+    const int num_threads = resolve_num_threads(config.num_threads);
+    std::cout << "Beginning tessellation of shapes: " << jobs.size() << " (" << labelSeq.Length()
+        << " labels) using " << num_threads << " threads\n";
+    start = std::chrono::high_resolution_clock::now();
+    TraceScope tessellation_trace("Tessellation");
+
+    MetricsLog metrics_log(config.glbFile);
+    std::mutex result_mutex;
+    std::size_t num_done = 0;
+    std::vector<std::vector<LodMesh>> job_lods(use_lods ? jobs.size() : 0);
+    parallel_for_each_index(jobs.size(), num_threads, [&](const std::size_t j)
+    {
+        const auto& job = jobs[j];
+        TRACE_SCOPE("Tessellate shape", job.entityIndex);
+        bool completed = true;
+        bool cache_hit = false;
+        std::string skip_reason = "Tessellation timed out";
+        const auto mesh_start = std::chrono::steady_clock::now();
+        if (use_lods)
+        {
+            // Coarse to fine, so that a shape that times out still has its coarser levels.
+            // Each level is extracted before the next one replaces the face triangulations.
+            auto& levels = job_lods[j];
+            for (std::size_t level = config.lod_deflections.size(); level-- > 0;)
+            {
+                const auto lodParams = make_lod_params(meshParams, config, level);
+                // Every shape gets its own cancellation token, and thereby its own deadline
+                completed = perform_tessellation_with_timeout(job.shape, lodParams, config.tessellation_timout);
+                if (!completed)
+                {
+                    skip_reason = "Tessellation timed out at LOD " + std::to_string(level);
+                    break;
+                }
+                Mesh mesh = shape_to_mesh(job.shape, job.labelIndex, job.color);
+                if (!mesh.indices.empty())
+                    levels.push_back({std::move(mesh), config.lod_screen_coverage[level]});
+            }
+            std::reverse(levels.begin(), levels.end());
+        }
+        else
+        {
+            TessellationOptions options;
+            options.analytic = use_analytic_mesh ? &analytic_report : nullptr;
+            options.cache = cache ? &*cache : nullptr;
+            options.geometry_hash = job.geometryHash;
+            options.cache_hit = &cache_hit;
+            // Every shape gets its own cancellation token, and thereby its own deadline
+            completed = perform_tessellation_with_timeout(job.shape, job.params, config.tessellation_timout, options);
+            if (cost_model && !cache_hit)
+            {
+                const double seconds =
+                    std::chrono::duration<double>(std::chrono::steady_clock::now() - mesh_start).count();
+                cost_model->record(job.features,
+                                   completed ? seconds
+                                             : std::max(seconds, TIMEOUT_COST_FACTOR * config.tessellation_timout));
+            }
+            if (completed && use_auto_deflection)
+                deflection_report.add(job.shape, job.deflection);
+        }
+
+        ShapeMetrics metrics;
+        metrics.entity_index = job.entityIndex;
+        metrics.product_name = job.name;
+        metrics.mesh_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - mesh_start).count();
+        metrics.outcome = !completed ? "timeout" : cache_hit ? "cached" : "converted";
+        add_mesh_metrics(job.shape, metrics);
+        if (use_lods)
+        {
+            metrics.glb_bytes = 0;
+            for (const auto& level : job_lods[j])
+                metrics.glb_bytes += mesh_glb_bytes(level.mesh);
+        }
+        metrics_log.write(metrics);
+
+        std::lock_guard<std::mutex> lock(result_mutex);
+        ++num_done;
+        std::cout << "Tessellated shape " << job.labelIndex << " (" << num_done << " of " << jobs.size() << ")\n";
+        if (!completed) {
             std::cout << "Tessellation timed out.\n";
             // get entity from shape
             auto result = ProcessResult();
             result.added_to_model = false;
-            result.geometryIndex = i;
-            result.skip_reason = "Tessellation timed out";
+            result.geometryIndex = job.labelIndex;
+            result.skip_reason = skip_reason;
             failed_nodes.push_back(result);
         }
-    }
+    });
+    tessellation_trace.end();
+
+    // Keep the log independent of the scheduling order
+    std::sort(failed_nodes.begin(), failed_nodes.end(), [](const ProcessResult& a, const ProcessResult& b)
+    {
+        return a.geometryIndex < b.geometryIndex;
+    });
+
     stop = std::chrono::high_resolution_clock::now();
     duration = std::chrono::duration<double>(stop - start).count();
     std::cout << "Tessellation complete in " << std::fixed << std::setprecision(2) << duration << " seconds" << "\n";
+    if (use_auto_deflection)
+        deflection_report.print(std::cout);
+    if (use_analytic_mesh)
+        analytic_report.print(std::cout);
+    if (cache)
+    {
+        cache->print_report(std::cout);
+        cache->evict();
+    }
+    if (num_coarsened > 0)
+        std::cout << "Meshed " << num_coarsened << " shapes coarser because of their predicted tessellation time\n";
+    if (cost_model)
+        cost_model->save();
 
     // Write to GLB
-    std:: cout << "Writing to GLB file: " << config.glbFile << "\n";
+    std::cout << "Writing the GLB output\n";
     start = std::chrono::high_resolution_clock::now();
-    RWGltf_CafWriter writer(config.glbFile.c_str(), true); // true for binary format
-
-    // Additional file information (can be empty if not needed)
-    const TColStd_IndexedDataMapOfStringString file_info;
-
-    // Progress indicator (can be null if progress tracking is not needed)
-    const Message_ProgressRange progress;
-
-    // if output parent directory is != "" and does not exist, create it
-    if (const std::filesystem::path glb_dir = config.glbFile.parent_path(); !glb_dir.empty() && !exists(glb_dir))
+    TraceScope glb_trace("Write GLB");
+    if (use_glb_writer)
     {
-        create_directories(glb_dir);
-    }
+        std::map<std::string, std::vector<LodMesh>> meshes;
+        if (use_lods)
+        {
+            for (std::size_t j = 0; j < jobs.size(); ++j)
+                meshes.emplace(jobs[j].entry, std::move(job_lods[j]));
+        }
+        else
+        {
+            std::vector<std::optional<Mesh>> extracted(jobs.size());
+            parallel_for_each_index(jobs.size(), num_threads, [&](const std::size_t j)
+            {
+                TRACE_SCOPE("Extract mesh", jobs[j].entityIndex);
+                extracted[j] = shape_to_mesh(jobs[j].shape, jobs[j].labelIndex, jobs[j].color);
+            });
+            std::vector<BudgetMesh> budget_meshes;
+            budget_meshes.reserve(jobs.size());
+            for (std::size_t j = 0; j < jobs.size(); ++j)
+                budget_meshes.push_back({jobs[j].entry, jobs[j].name, std::move(*extracted[j])});
+            // Meshed as usual, then decimated to fit the budget
+            if (use_budget)
+                fit_triangle_budget(budget_meshes, doc, config.maxTriangles, num_threads, std::cout);
+            for (auto& budget_mesh : budget_meshes)
+                meshes[budget_mesh.entry].push_back({std::move(budget_mesh.mesh), 0.0});
+        }
 
-    if (!writer.Perform(doc, file_info, progress))
+        if (config.optimizeMeshes)
+        {
+            std::vector<Mesh*> levels;
+            for (auto& [entry, lods] : meshes)
+                for (auto& lod : lods)
+                    levels.push_back(&lod.mesh);
+            MeshOptimizationReport optimization_report;
+            parallel_for_each_index(levels.size(), num_threads, [&](const std::size_t i)
+            {
+                optimization_report.add(optimize_mesh(*levels[i]));
+            });
+            optimization_report.print(std::cout);
+        }
+        const GlbOptions glb_options{
+            .meshopt_compression = config.meshoptCompression,
+            .num_threads = num_threads,
+            .quantize = config.quantize,
+            .normal_bits = config.normalBits,
+            .bvh = config.bvhSidecar,
+            .max_buffer_size = static_cast<std::size_t>(config.maxBufferMb * 1024.0 * 1024.0)
+        };
+        std::vector<std::filesystem::path> written_files;
+        if (config.tiles)
+            to_tileset(config.glbFile.parent_path() / config.glbFile.stem().concat("-tiles"), doc, meshes,
+                       {.max_tile_triangles = config.tileTriangles, .glb = glb_options});
+        // Parts are optimized on their own above, so the batches keep the triangle ranges of every instance intact
+        else if (config.batchMeshes)
+            written_files = to_glb_batched(config.glbFile, doc, meshes, glb_options);
+        else
+            written_files = to_glb_with_lods(config.glbFile, doc, meshes, glb_options);
+        // Past the buffer limit the output is a .gltf with external buffers, not the requested GLB
+        if (!written_files.empty())
+        {
+            std::cout << "Written to " << written_files.front().string();
+            if (written_files.size() > 1)
+                std::cout << " with " << written_files.size() - 1 << " external buffers";
+            std::cout << "\n";
+        }
+        if (config.meshoptCompression && !config.tiles)
+        {
+            std::uintmax_t compressed_size = 0;
+            for (const auto& file : written_files)
+                compressed_size += std::filesystem::file_size(file);
+            std::cout << "Compressed GLB size: " << std::fixed << std::setprecision(1)
+                << static_cast<double>(compressed_size) / (1024.0 * 1024.0) << " MB\n";
+        }
+    }
+    else
     {
-        throw std::runtime_error("Error writing GLB file");
+        to_glb_from_doc(config.glbFile, doc);
+        std::cout << "Written to " << config.glbFile.string() << "\n";
     }
+    glb_trace.end();
     stop = std::chrono::high_resolution_clock::now();
     duration = std::chrono::duration<double>(stop - start).count();
     std::cout << "Write complete in " << std::fixed << std::setprecision(2) << duration << " seconds" << "\n";
@@ -127,15 +432,17 @@ void convert_stp_to_glb(const GlobalConfig& config)
     const std::filesystem::path out_json_log_file = config.glbFile.parent_path() / config.glbFile.stem().concat(
                                                     "-log.json");
     std::ofstream log_file(out_json_log_file);
-    log_file << "[\n";
+    log_file << "[";
 
-    for (const auto &result: failed_nodes) {
+    for (std::size_t i = 0; i < failed_nodes.size(); ++i) {
+        const auto &result = failed_nodes[i];
+        log_file << (i == 0 ? "\n" : ",\n");
         log_file << "{\n";
         log_file << "\"geometryIndex\": " << result.geometryIndex << ",\n";
-        log_file << R"("skipReason": ")" << result.skip_reason << "\"\n";
-        log_file << "},\n";
+        log_file << R"("skipReason": ")" << escape_json(result.skip_reason) << "\"\n";
+        log_file << "}";
     }
-    log_file << "]\n";
+    log_file << "\n]\n";
     log_file.close();
 }
 
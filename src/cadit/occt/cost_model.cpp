@@ -0,0 +1,255 @@
+#include "cost_model.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <Bnd_Box.hxx>
+#include <BRepAdaptor_Surface.hxx>
+#include <BRepBndLib.hxx>
+#include <Geom_BezierSurface.hxx>
+#include <Geom_BSplineSurface.hxx>
+#include <TopExp.hxx>
+#include <TopoDS.hxx>
+#include <TopTools_IndexedMapOfShape.hxx>
+
+namespace {
+    constexpr std::size_t NUM_WEIGHTS = ShapeCostFeatures::Count + 1;
+
+    // Seconds per unit of each feature, after the intercept. Rough values measured on typical plant models.
+    constexpr std::array<double, NUM_WEIGHTS> PRIOR = {2e-3, 5e-5, 2e-4, 1e-3, 2e-6, 2e-5, 5e-4, 2e-6};
+
+    // Weight of the prior, in samples
+    constexpr double PRIOR_STRENGTH = 10.0;
+    constexpr std::size_t MIN_TRAINED_SAMPLES = 50;
+    constexpr std::size_t MAX_SAMPLES = 20000;
+
+    std::array<double, NUM_WEIGHTS> regressors(const ShapeCostFeatures &features) {
+        std::array<double, NUM_WEIGHTS> x{};
+        x[0] = 1.0;
+        std::copy(features.values.begin(), features.values.end(), x.begin() + 1);
+        return x;
+    }
+
+    // Solves a x = b by Gaussian elimination with partial pivoting. a is symmetric positive definite here.
+    template<std::size_t N>
+    std::array<double, N> solve(std::array<std::array<double, N>, N> a, std::array<double, N> b) {
+        for (std::size_t col = 0; col < N; ++col) {
+            std::size_t pivot = col;
+            for (std::size_t row = col + 1; row < N; ++row) {
+                if (std::abs(a[row][col]) > std::abs(a[pivot][col])) {
+                    pivot = row;
+                }
+            }
+            std::swap(a[col], a[pivot]);
+            std::swap(b[col], b[pivot]);
+            for (std::size_t row = col + 1; row < N; ++row) {
+                const double factor = a[row][col] / a[col][col];
+                for (std::size_t k = col; k < N; ++k) {
+                    a[row][k] -= factor * a[col][k];
+                }
+                b[row] -= factor * b[col];
+            }
+        }
+        std::array<double, N> x{};
+        for (std::size_t col = N; col-- > 0;) {
+            double sum = b[col];
+            for (std::size_t k = col + 1; k < N; ++k) {
+                sum -= a[col][k] * x[k];
+            }
+            x[col] = sum / a[col][col];
+        }
+        return x;
+    }
+
+    void write_sample(std::ostream &os, const ShapeCostFeatures &features, const double seconds) {
+        os << seconds;
+        for (const double value: features.values) {
+            os << ' ' << value;
+        }
+        os << '\n';
+    }
+}
+
+ShapeCostFeatures shape_cost_features(const TopoDS_Shape &shape, const IMeshTools_Parameters &params) {
+    ShapeCostFeatures features;
+    auto &values = features.values;
+
+    TopTools_IndexedMapOfShape faces;
+    TopExp::MapShapes(shape, TopAbs_FACE, faces);
+    double curved_faces = 0.0;
+    for (Standard_Integer i = 1; i <= faces.Extent(); ++i) {
+        const BRepAdaptor_Surface surface(TopoDS::Face(faces(i)), Standard_False);
+        switch (surface.GetType()) {
+            case GeomAbs_Plane:
+                values[ShapeCostFeatures::PlanarFaces] += 1.0;
+                continue;
+            case GeomAbs_Cylinder:
+            case GeomAbs_Cone:
+            case GeomAbs_Sphere:
+            case GeomAbs_Torus:
+                values[ShapeCostFeatures::AnalyticFaces] += 1.0;
+                break;
+            case GeomAbs_BSplineSurface: {
+                const Handle(Geom_BSplineSurface) bspline = surface.BSpline();
+                values[ShapeCostFeatures::FreeformFaces] += 1.0;
+                values[ShapeCostFeatures::FreeformPoles] += bspline->NbUPoles() * bspline->NbVPoles();
+                values[ShapeCostFeatures::FreeformDegree] += bspline->UDegree() * bspline->VDegree();
+                break;
+            }
+            case GeomAbs_BezierSurface: {
+                const Handle(Geom_BezierSurface) bezier = surface.Bezier();
+                values[ShapeCostFeatures::FreeformFaces] += 1.0;
+                values[ShapeCostFeatures::FreeformPoles] += bezier->NbUPoles() * bezier->NbVPoles();
+                values[ShapeCostFeatures::FreeformDegree] += bezier->UDegree() * bezier->VDegree();
+                break;
+            }
+            default:
+                values[ShapeCostFeatures::OtherFaces] += 1.0;
+                break;
+        }
+        curved_faces += 1.0;
+    }
+
+    // Size relative to the deflection. A relative deflection is already a fraction of the size.
+    double resolution = 1.0;
+    if (params.Deflection > 0.0) {
+        if (params.Relative) {
+            resolution = 1.0 / params.Deflection;
+        } else {
+            Bnd_Box box;
+            BRepBndLib::Add(shape, box, Standard_False);
+            if (!box.IsVoid()) {
+                resolution = std::max(1.0, std::sqrt(box.SquareExtent()) / params.Deflection);
+            }
+        }
+    }
+    values[ShapeCostFeatures::CurvedResolution] = curved_faces * std::sqrt(resolution);
+    return features;
+}
+
+TessellationCostModel::TessellationCostModel(std::filesystem::path history_file)
+    : history_file_(std::move(history_file)), weights_(PRIOR) {
+    if (history_file_.empty()) {
+        return;
+    }
+    std::ifstream file(history_file_);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream is(line);
+        Sample sample{};
+        is >> sample.seconds;
+        for (double &value: sample.features.values) {
+            is >> value;
+        }
+        if (is.fail() || sample.seconds < 0.0) {
+            continue;
+        }
+        history_.push_back(sample);
+    }
+    if (history_.size() > MAX_SAMPLES) {
+        history_.erase(history_.begin(), history_.end() - MAX_SAMPLES);
+    }
+    fit();
+}
+
+void TessellationCostModel::fit() {
+    if (history_.empty()) {
+        return;
+    }
+    // Columns are scaled to unit RMS so that the regularization treats all features alike
+    std::array<double, NUM_WEIGHTS> scale{};
+    for (const auto &sample: history_) {
+        const auto x = regressors(sample.features);
+        for (std::size_t k = 0; k < NUM_WEIGHTS; ++k) {
+            scale[k] += x[k] * x[k];
+        }
+    }
+    for (double &s: scale) {
+        s = s > 0.0 ? std::sqrt(s / static_cast<double>(history_.size())) : 1.0;
+    }
+
+    // (Z^T Z + l I) v = Z^T t + l v_prior, with Z the scaled regressors
+    std::array<std::array<double, NUM_WEIGHTS>, NUM_WEIGHTS> normal{};
+    std::array<double, NUM_WEIGHTS> rhs{};
+    for (const auto &sample: history_) {
+        auto z = regressors(sample.features);
+        for (std::size_t k = 0; k < NUM_WEIGHTS; ++k) {
+            z[k] /= scale[k];
+        }
+        for (std::size_t r = 0; r < NUM_WEIGHTS; ++r) {
+            for (std::size_t c = 0; c < NUM_WEIGHTS; ++c) {
+                normal[r][c] += z[r] * z[c];
+            }
+            rhs[r] += z[r] * sample.seconds;
+        }
+    }
+    for (std::size_t k = 0; k < NUM_WEIGHTS; ++k) {
+        normal[k][k] += PRIOR_STRENGTH;
+        rhs[k] += PRIOR_STRENGTH * PRIOR[k] * scale[k];
+    }
+    const auto solution = solve(normal, rhs);
+    for (std::size_t k = 0; k < NUM_WEIGHTS; ++k) {
+        // Meshing never gets cheaper with more faces or poles
+        weights_[k] = std::max(0.0, solution[k] / scale[k]);
+    }
+}
+
+double TessellationCostModel::predict(const ShapeCostFeatures &features) const {
+    const auto x = regressors(features);
+    double seconds = 0.0;
+    for (std::size_t k = 0; k < NUM_WEIGHTS; ++k) {
+        seconds += weights_[k] * x[k];
+    }
+    return seconds;
+}
+
+bool TessellationCostModel::is_trained() const {
+    return history_.size() >= MIN_TRAINED_SAMPLES;
+}
+
+void TessellationCostModel::record(const ShapeCostFeatures &features, const double seconds) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    recorded_.push_back({features, seconds});
+}
+
+void TessellationCostModel::save() const {
+    if (history_file_.empty()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!history_file_.parent_path().empty()) {
+        create_directories(history_file_.parent_path());
+    }
+    const bool exists = std::filesystem::exists(history_file_);
+
+    if (history_.size() + recorded_.size() <= MAX_SAMPLES) {
+        std::ofstream file(history_file_, std::ios::app);
+        if (!exists) {
+            file << "# STP2GLB tessellation timings: seconds followed by the ShapeCostFeatures values\n";
+        }
+        for (const auto &sample: recorded_) {
+            write_sample(file, sample.features, sample.seconds);
+        }
+        return;
+    }
+
+    // Keep the most recent samples only
+    std::vector<Sample> samples = history_;
+    samples.insert(samples.end(), recorded_.begin(), recorded_.end());
+    samples.erase(samples.begin(), samples.end() - MAX_SAMPLES);
+    auto temp_path = history_file_;
+    temp_path += ".tmp";
+    {
+        std::ofstream file(temp_path);
+        file << "# STP2GLB tessellation timings: seconds followed by the ShapeCostFeatures values\n";
+        for (const auto &sample: samples) {
+            write_sample(file, sample.features, sample.seconds);
+        }
+    }
+    std::filesystem::rename(temp_path, history_file_);
+}
@@ -0,0 +1,67 @@
+#ifndef COST_MODEL_H
+#define COST_MODEL_H
+
+#include <array>
+#include <cstddef>
+#include <filesystem>
+#include <mutex>
+#include <vector>
+#include <IMeshTools_Parameters.hxx>
+#include <TopoDS_Shape.hxx>
+
+// Cheap features of a shape that drive its meshing time
+struct ShapeCostFeatures {
+    enum Index {
+        PlanarFaces = 0,
+        AnalyticFaces, // cylinders, cones, spheres and tori
+        FreeformFaces, // B-spline and Bezier surfaces
+        FreeformPoles, // sum of NbUPoles * NbVPoles
+        FreeformDegree, // sum of UDegree * VDegree
+        OtherFaces, // revolved, extruded, offset and other surfaces
+        CurvedResolution, // curved faces * sqrt(size / deflection)
+        Count
+    };
+
+    std::array<double, Count> values{};
+};
+
+ShapeCostFeatures shape_cost_features(const TopoDS_Shape &shape, const IMeshTools_Parameters &params);
+
+// Linear model of the meshing time in seconds, trained on the timings recorded by previous runs.
+//
+// Without recorded timings a hand tuned prior is used, which is good enough to order the shapes. Fitting is a
+// least squares fit regularized towards the prior, so a handful of samples only nudges it. Samples are kept in a
+// text file, one line of features and seconds per tessellated shape, trimmed to the most recent ones.
+class TessellationCostModel {
+public:
+    // Reads and fits the samples of history_file. An empty path gives the untrained prior.
+    explicit TessellationCostModel(std::filesystem::path history_file = {});
+
+    [[nodiscard]] double predict(const ShapeCostFeatures &features) const;
+
+    // True once enough timings have been recorded to act on a prediction, not only order by it
+    [[nodiscard]] bool is_trained() const;
+
+    // Records a measured meshing time. Safe to call from several threads.
+    void record(const ShapeCostFeatures &features, double seconds);
+
+    // Appends the recorded samples to the history file
+    void save() const;
+
+private:
+    struct Sample {
+        ShapeCostFeatures features;
+        double seconds;
+    };
+
+    void fit();
+
+    std::filesystem::path history_file_;
+    // Intercept followed by one weight per feature
+    std::array<double, ShapeCostFeatures::Count + 1> weights_{};
+    std::vector<Sample> history_;
+    mutable std::mutex mutex_;
+    std::vector<Sample> recorded_;
+};
+
+#endif //COST_MODEL_H
@@ -5,6 +5,25 @@
 #include <atomic>
 #include <chrono>
 
+SilentProgressIndicator::SilentProgressIndicator() : shouldCancel(false) {
+}
+
+Standard_Boolean SilentProgressIndicator::UserBreak() {
+    return shouldCancel;
+}
+
+void SilentProgressIndicator::Show(const Message_ProgressScope &theScope, const Standard_Boolean isForce) {
+    // Intentionally silent, progress of individual shapes is not printed
+}
+
+void SilentProgressIndicator::Cancel() {
+    shouldCancel = true;
+}
+
+void SilentProgressIndicator::Reset() {
+    shouldCancel = false;
+}
+
 CustomProgressIndicator::CustomProgressIndicator() : shouldCancel(false), progress(0.0), lastProgress(-1.0) {
     // Start the progress update thread
     progressThread = std::thread(&CustomProgressIndicator::UpdateProgress, this);
@@ -6,7 +6,32 @@
 #include <thread>
 #include <mutex>
 
-class CustomProgressIndicator : public Message_ProgressIndicator {
+//! Progress indicator that can be cancelled from another thread
+class CancellableProgressIndicator : public Message_ProgressIndicator {
+public:
+    //! Requests the running operation to stop at its next UserBreak() check
+    virtual void Cancel() = 0;
+};
+
+//! Cancel-only progress indicator without console output.
+//! One instance is used per in-flight shape so concurrent tessellations can time out independently.
+class SilentProgressIndicator : public CancellableProgressIndicator {
+public:
+    SilentProgressIndicator();
+
+    Standard_Boolean UserBreak() override;
+
+    void Show(const Message_ProgressScope &theScope, const Standard_Boolean isForce) override;
+
+    void Cancel() override;
+
+    void Reset() override;
+
+private:
+    std::atomic<bool> shouldCancel;
+};
+
+class CustomProgressIndicator : public CancellableProgressIndicator {
 public:
     CustomProgressIndicator();  // Constructor
     ~CustomProgressIndicator(); // Destructor
@@ -18,7 +43,7 @@ public:
     void Show(const Message_ProgressScope &theScope, const Standard_Boolean isForce) override;
 
     //! Cancels the progress update (stops background thread)
-    void Cancel();
+    void Cancel() override;
 
     //! Resets the progress indicator
     void Reset() override;
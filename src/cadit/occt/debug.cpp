@@ -3,6 +3,7 @@
 #include <RWGltf_CafWriter.hxx>
 #include <TDocStd_Document.hxx>
 #include <BRepMesh_IncrementalMesh.hxx>
+#include <chrono>
 #include <execution>
 #include <filesystem>
 #include <XCAFDoc_ShapeTool.hxx>
@@ -13,18 +14,36 @@
 #include <iostream>
 #include "debug.h"
 
+#include <fstream>
+#include <functional>
 #include <future>
+#include <iomanip>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include "step_writer.h"
 #include <Interface_Static.hxx>
 #include <Interface_Graph.hxx>
 #include <StepBasic_Product.hxx>
 
+#include "analytic_mesh.h"
 #include "custom_progress.h"
+#include "direct_glb.h"
+#include "gltf_writer.h"
 #include "helpers.h"
+#include "incremental.h"
+#include "mesh_extract.h"
+#include "mesh_params.h"
+#include "shape_metrics.h"
+#include "step_hash.h"
 #include "step_helpers.h"
 #include "step_tree.h"
+#include "../step/step_subset.h"
+#include "../../trace.h"
 #include "../../config_structs.h"
+#include "../../json_utils.h"
 
 
 bool should_process_geometry(const Handle(Standard_Transient) &brep, const ProductNode &node,
@@ -48,6 +67,47 @@ bool should_process_geometry(const Handle(Standard_Transient) &brep, const Produ
     return true;
 }
 
+namespace {
+    void write_hierarchy_json(const std::vector<std::unique_ptr<ProductNode> > &roots,
+                              const std::filesystem::path &json_file) {
+        std::ofstream file(json_file);
+        file << ExportHierarchyToJson(roots);
+        if (!file) {
+            throw std::runtime_error("Error writing hierarchy: " + json_file.string());
+        }
+    }
+
+    // Writes the geometries that were not added to the model
+    void write_skip_log(const std::vector<std::unique_ptr<ProductNode> > &roots,
+                        const std::filesystem::path &log_file_path) {
+        std::ofstream log_file(log_file_path);
+        log_file << "[";
+
+        bool first_entry = true;
+        for (const auto &node: GeometryRange(roots)) {
+            if (!node.processResult.added_to_model && node.processResult.geometryIndex != 0) {
+                log_file << (first_entry ? "\n" : ",\n");
+                first_entry = false;
+                log_file << "{\n";
+                log_file << R"("name": ")" << escape_json(node.name) << "\",\n";
+                log_file << "\"entityIndex\": " << node.entityIndex << ",\n";
+                log_file << "\"geometryIndex\": " << node.processResult.geometryIndex << ",\n";
+                log_file << R"("skipReason": ")" << escape_json(node.processResult.skip_reason) << "\"\n";
+                log_file << "}";
+            }
+        }
+        log_file << "\n]\n";
+        if (!log_file) {
+            throw std::runtime_error("Error writing log: " + log_file_path.string());
+        }
+    }
+
+    struct OutputTask {
+        std::string name;
+        std::future<double> seconds;
+    };
+}
+
 
 void debug_stp_to_glb(const GlobalConfig &config) {
     // Initialize the STEPCAFControl_Reader
@@ -70,17 +130,17 @@ void debug_stp_to_glb(const GlobalConfig &config) {
     params.ReadPrecisionVal = 1;
     params.ReadNonmanifold = true;
 
-    // Mesh parameters
-    IMeshTools_Parameters meshParams;
-    meshParams.Angle = config.angularDeflection;
-    meshParams.Deflection = config.linearDeflection;
-    meshParams.Relative = config.relativeDeflection;
-    meshParams.MinSize = 0.1;
-    meshParams.AngleInterior = 0.5;
-    meshParams.DeflectionInterior = 0.1;
-    meshParams.CleanModel = Standard_True;
-    meshParams.InParallel = Standard_True;
-    meshParams.AllowQualityDecrease = Standard_True;
+    // Mesh parameters. The shapes are meshed one at a time, so BRepMesh may use all cores on each.
+    const IMeshTools_Parameters meshParams = make_mesh_params(config, true);
+    DeflectionReport deflection_report(config.linearDeflection, config.relativeDeflection);
+    // The analytic generators work with absolute deflections only
+    const bool use_analytic_mesh = config.analyticFastPath &&
+                                   (config.autoDeflection > 0.0 || !config.relativeDeflection);
+    AnalyticMeshReport analytic_report;
+    std::optional<TriangulationCache> cache;
+    if (!config.cacheDir.empty()) {
+        cache.emplace(config.cacheDir, static_cast<std::uintmax_t>(config.cacheMaxMb) * 1024 * 1024);
+    }
 
     {
         TIME_BLOCK("Reading STEP file");
@@ -99,6 +159,7 @@ void debug_stp_to_glb(const GlobalConfig &config) {
 
     // Build the graph of references
     Interface_Graph theGraph(model, /*keepTransient*/ Standard_False);
+    StepGraphHasher hasher(model);
 
     auto iterator = model->Entities();
     auto num_entities = iterator.NbEntities();
@@ -106,22 +167,29 @@ void debug_stp_to_glb(const GlobalConfig &config) {
     std::cout << "Number of entities: " << num_entities << "\n";
 
     // Extract hierarchy
+    TraceScope hierarchy_trace("Extract product hierarchy");
     auto roots = ExtractProductHierarchy(model, theGraph);
     add_geometries_to_nodes(roots, theGraph);
-
-    auto step_store = StepStore(roots);
-
-    // Convert Hierarchy to JSON
-    std::string jsonOutput = ExportHierarchyToJson(roots);
-
-    // Then write to file or print to console:
-    const std::filesystem::path out_json_file = config.glbFile.parent_path() / config.glbFile.stem().concat(
-                                                    "-hierarchy.json");
-    std::ofstream file(out_json_file);
-    file << jsonOutput;
-    file.close();
-
-    std::cout << "Hierarchy exported to assembly_hierarchy.json\n";
+    hierarchy_trace.end();
+
+    // The GLB is written directly from the product tree and the meshes. The XCAF document is only built for the
+    // XCAF GLB writer; the STEP output is copied from the source file.
+    const bool direct_glb = config.glbWriter != "xcaf";
+    const bool xcaf_glb = config.glbWriter != "direct";
+    double xcaf_seconds = 0.0;
+    std::vector<StepShape> xcaf_shapes;
+    const auto entity_colors = read_entity_colors(default_reader.WS());
+
+    // The configuration gives --incremental a cache directory
+    std::optional<IncrementalConversion> incremental;
+    if (config.incremental && cache) {
+        TRACE_SCOPE("Hash product subtrees");
+        const auto filter = [&](const ProductNode &node, const int entity_index) {
+            return should_process_geometry(model->Entity(entity_index), node, config);
+        };
+        incremental.emplace(*cache, roots, model, hasher, entity_colors, filter, meshParams, use_analytic_mesh,
+                            config.autoDeflection);
+    }
 
     int num_geometry = 0;
     int num_products = 0;
@@ -134,9 +202,22 @@ void debug_stp_to_glb(const GlobalConfig &config) {
     auto curr_shape = 0;
     auto curr_product = 0;
 
-    // Create a custom progress indicator in a separate thread
-    const Handle(CustomProgressIndicator) progress = new CustomProgressIndicator();
-    Handle(XCAFDoc_ColorTool) colorTool = XCAFDoc_DocumentTool::ColorTool(step_store.doc_->Main());
+    MetricsLog metrics_log(config.glbFile);
+
+    // The direct GLB is written as the shapes are tessellated
+    std::optional<DirectGlbWriter> glb_writer;
+    if (direct_glb) {
+        glb_writer.emplace(config.glbFile, roots, static_cast<std::size_t>(config.maxBufferMb * 1024.0 * 1024.0));
+    }
+    // Geometries that made it into the model. The others are left out of the STEP output.
+    std::unordered_set<int> kept_geometries;
+    const auto add_to_step_store = [&](const ProductNode &node, const int entity_index, const TopoDS_Shape &shape,
+                                       const Color &color) {
+        kept_geometries.insert(entity_index);
+        if (xcaf_glb) {
+            xcaf_shapes.push_back({&node, shape, color});
+        }
+    };
 
     // Iterate over all nodes with geometry indices
     for (const auto &node: GeometryRange(roots)) {
@@ -145,26 +226,62 @@ void debug_stp_to_glb(const GlobalConfig &config) {
         std::cout << "Node: " << node.name << " (" << curr_product << "/" << num_products << ")"
                 << ", EntityIndex: " << node.entityIndex
                 << ", Geometry count: " << node.geometryInstances.size() << '\n';
-        for (const GeometryInstance geometry_instance: node.geometryInstances) {
+        // Products with an unchanged subtree are rebuilt from the cached meshes without transfer and tessellation
+        std::vector<Mesh> reused_meshes;
+        const bool reused = incremental && incremental->reuse(node, reused_meshes);
+        for (std::size_t i = 0; i < node.geometryInstances.size(); ++i) {
+            const GeometryInstance geometry_instance = node.geometryInstances[i];
+            TRACE_SCOPE("Geometry", geometry_instance.entityIndex);
 
             std::cout << "Geometry: " << geometry_instance.entityIndex << " (" << curr_shape << "/" << num_geometry << ")\n";
 
             auto geometry = model->Entity(geometry_instance.entityIndex);
+            ShapeMetrics metrics;
+            metrics.entity_index = geometry_instance.entityIndex;
+            metrics.product_name = node.name;
 
             if (!should_process_geometry(geometry, node, config)) {
                 std::cout << "Skipping shape: " << node.name << " (Entity: " << node.entityIndex << ")\n";
                 node.processResult.added_to_model = false;
                 node.processResult.geometryIndex = geometry_instance.entityIndex;
                 node.processResult.skip_reason = "Skipped by filter";
+                metrics.outcome = "skipped";
+                if (incremental && !reused) {
+                    incremental->add_skipped(node);
+                }
+                metrics_log.write(metrics);
                 curr_shape++;
                 continue;
             }
 
-            if (!default_reader.TransferEntity(geometry)) {
+            if (reused) {
+                const TopoDS_Shape shape = mesh_to_shape(reused_meshes[i]);
+                const Color color = reused_meshes[i].color;
+                std::cout << "Reusing Shape: " << node.name << " (Entity: " << node.entityIndex << ")\n";
+                add_to_step_store(node, geometry_instance.entityIndex, shape, color);
+                if (glb_writer) {
+                    glb_writer->add_shape(node, shape, color, curr_shape);
+                }
+                metrics.outcome = "reused";
+                add_mesh_metrics(shape, metrics);
+                metrics_log.write(metrics);
+                curr_shape++;
+                continue;
+            }
+
+            const auto transfer_start = std::chrono::steady_clock::now();
+            TraceScope transfer_trace("Transfer entity", geometry_instance.entityIndex);
+            const bool transferred = default_reader.TransferEntity(geometry);
+            transfer_trace.end();
+            metrics.transfer_seconds = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - transfer_start).count();
+            if (!transferred) {
                 std::cerr << "Error transferring entity" << "\n";
                 node.processResult.added_to_model = false;
                 node.processResult.geometryIndex = geometry_instance.entityIndex;
                 node.processResult.skip_reason = "Error transferring entity";
+                metrics.outcome = "transfer_failed";
+                metrics_log.write(metrics);
                 curr_shape++;
                 continue;
             };
@@ -175,25 +292,42 @@ void debug_stp_to_glb(const GlobalConfig &config) {
                 node.processResult.added_to_model = false;
                 node.processResult.geometryIndex = geometry_instance.entityIndex;
                 node.processResult.skip_reason = "Unable to convert entity to shape";
+                metrics.outcome = "transfer_failed";
+                metrics_log.write(metrics);
                 curr_shape++;
                 continue;
             }
-            Quantity_Color occ_color;
-            const Standard_Boolean hasColor = colorTool->GetColor(shape, XCAFDoc_ColorSurf, occ_color);
-            Color color;
-            if (!hasColor) {
-                color = random_color();
-            } else {
-                color = Color(occ_color.Red(), occ_color.Green(), occ_color.Blue());
-            }
+            const auto styled = entity_colors.find(geometry_instance.entityIndex);
+            // Unstyled geometries get the default color of the conversion, so they share one material
+            const Color color = styled != entity_colors.end() ? styled->second : Color();
 
-            std::cout << "Adding Shape: " << node.name << " (Entity: " << node.entityIndex << ") to STEP Writer\n";
-            step_store.add_shape(shape, node.name, color, node);
+            std::cout << "Adding Shape: " << node.name << " (Entity: " << node.entityIndex << ")\n";
+            add_to_step_store(node, geometry_instance.entityIndex, shape, color);
 
             // Updated code block
             {
-                TIME_BLOCK("Applying tessellation");
-                if (!perform_tessellation_with_timeout(shape, meshParams, config.tessellation_timout, progress)) {
+                TRACE_SCOPE("Tessellate shape", geometry_instance.entityIndex);
+                const double deflection = config.autoDeflection > 0.0
+                                              ? shape_deflection(shape, config.autoDeflection, config.linearDeflection)
+                                              : config.linearDeflection;
+                const auto shapeParams = config.autoDeflection > 0.0 ? with_deflection(meshParams, deflection) : meshParams;
+                bool cache_hit = false;
+                TessellationOptions options;
+                options.analytic = use_analytic_mesh ? &analytic_report : nullptr;
+                options.cache_hit = &cache_hit;
+                if (cache) {
+                    options.cache = &*cache;
+                    options.geometry_hash = hasher.hash(geometry);
+                }
+                const auto mesh_start = std::chrono::steady_clock::now();
+                const bool completed = perform_tessellation_with_timeout(shape, shapeParams, config.tessellation_timout,
+                                                                         options);
+                metrics.mesh_seconds = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - mesh_start).count();
+                metrics.outcome = !completed ? "timeout" : cache_hit ? "cached" : "converted";
+                add_mesh_metrics(shape, metrics);
+                metrics_log.write(metrics);
+                if (!completed) {
                     std::cout << "Tessellation timed out.\n";
                     node.processResult.added_to_model = false;
                     node.processResult.geometryIndex = geometry_instance.entityIndex;
@@ -201,6 +335,15 @@ void debug_stp_to_glb(const GlobalConfig &config) {
                     curr_shape++;
                     continue;
                 }
+                if (config.autoDeflection > 0.0) {
+                    deflection_report.add(shape, deflection);
+                }
+                if (incremental) {
+                    incremental->add(node, shape, color);
+                }
+                if (glb_writer) {
+                    glb_writer->add_shape(node, shape, color, curr_shape);
+                }
             }
             curr_shape++;
         }
@@ -211,29 +354,118 @@ void debug_stp_to_glb(const GlobalConfig &config) {
         curr_product++;
     }
 
-    step_store.to_glb(config.glbFile);
+    if (config.autoDeflection > 0.0) {
+        deflection_report.print(std::cout);
+    }
+    if (use_analytic_mesh) {
+        analytic_report.print(std::cout);
+    }
+    if (cache) {
+        cache->print_report(std::cout);
+        cache->evict();
+    }
+    if (incremental) {
+        incremental->print_report(std::cout);
+    }
 
-    const std::filesystem::path out_file = config.glbFile.parent_path() / config.glbFile.stem().concat("-debug.stp");
-    step_store.to_step(out_file.string().c_str());
+    // The XCAF document is built in one pass from the complete product tree and all shapes
+    std::optional<StepStore> step_store;
+    if (xcaf_glb) {
+        TRACE_SCOPE("Build XCAF document");
+        const auto start = std::chrono::steady_clock::now();
+        step_store.emplace(roots, xcaf_shapes);
+        xcaf_shapes.clear();
+        xcaf_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
 
-    // iterate over all nodes that werent added to the model and save the list to json
+    // The product tree and the XCAF document are complete, so from here on every output only reads them. The
+    // outputs are written concurrently and the stage takes as long as the slowest writer.
+    const std::filesystem::path out_json_file = config.glbFile.parent_path() / config.glbFile.stem().concat(
+                                                    "-hierarchy.json");
     const std::filesystem::path out_json_log_file = config.glbFile.parent_path() / config.glbFile.stem().concat(
-                                                    "-log.json");
-    std::ofstream log_file(out_json_log_file);
-    log_file << "[\n";
-
-    for (const auto &node: GeometryRange(roots)) {
-        if (!node.processResult.added_to_model && node.processResult.geometryIndex != 0) {
-            log_file << "{\n";
-            log_file << R"("name": ")" << node.name << "\",\n";
-            log_file << "\"entityIndex\": " << node.entityIndex << ",\n";
-            log_file << "\"geometryIndex\": " << node.processResult.geometryIndex << ",\n";
-            log_file << R"("skipReason": ")" << node.processResult.skip_reason << "\"\n";
-            log_file << "},\n";
+                                                        "-log.json");
+    // Both writers side by side: the XCAF output goes next to the direct one
+    const std::filesystem::path xcaf_file = direct_glb
+                                                ? config.glbFile.parent_path() / config.glbFile.stem().concat(
+                                                      "-xcaf.glb")
+                                                : config.glbFile;
+    const std::filesystem::path out_step_file = config.glbFile.parent_path() / config.glbFile.stem().concat(
+                                                    "-debug.stp");
+    // The STEP output is the source file without the geometries that were skipped or failed, named as in the file
+    std::unordered_set<std::uint64_t> excluded_geometries;
+    if (config.debugStep) {
+        for (const auto &node: GeometryRange(roots)) {
+            for (const GeometryInstance geometry_instance: node.geometryInstances) {
+                if (!kept_geometries.count(geometry_instance.entityIndex)) {
+                    excluded_geometries.insert(model->IdentLabel(model->Entity(geometry_instance.entityIndex)));
+                }
+            }
+        }
+    }
+    StepSubsetReport step_report;
+
+    std::vector<std::filesystem::path> glb_files;
+    std::vector<OutputTask> outputs;
+    std::optional<std::size_t> xcaf_output;
+    // Names are string literals, so the writer threads can trace them
+    const auto launch = [&outputs](const char *name, std::function<void()> write) {
+        outputs.push_back({
+            name, std::async(std::launch::async, [name, write = std::move(write)] {
+                TRACE_SCOPE(name);
+                const auto start = std::chrono::steady_clock::now();
+                write();
+                return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            })
+        });
+    };
+    {
+        TIME_BLOCK("Writing outputs");
+        launch("hierarchy", [&] { write_hierarchy_json(roots, out_json_file); });
+        launch("log", [&] { write_skip_log(roots, out_json_log_file); });
+        if (glb_writer) {
+            launch("direct GLB", [&] { glb_files = glb_writer->finish(); });
+        }
+        if (xcaf_glb) {
+            xcaf_output = outputs.size();
+            launch("XCAF GLB", [&] { step_store->to_glb(xcaf_file); });
+        }
+        if (config.debugStep) {
+            launch("STEP", [&] {
+                step_report = write_step_subset(config.stpFile, out_step_file, excluded_geometries);
+            });
+        }
+        for (const auto &output: outputs) {
+            output.seconds.wait();
         }
     }
-    log_file << "]\n";
-    log_file.close();
-
 
+    // The first failure is rethrown once all writers have stopped
+    for (std::size_t i = 0; i < outputs.size(); ++i) {
+        const double seconds = outputs[i].seconds.get();
+        std::cout << "Wrote " << outputs[i].name << " in " << std::setprecision(3) << seconds << " s\n";
+        if (i == xcaf_output) {
+            xcaf_seconds += seconds;
+        }
+    }
+    std::cout << "Hierarchy exported to " << out_json_file.string() << "\n";
+    if (config.debugStep) {
+        std::cout << "STEP subset: " << step_report.records_written << " of " << step_report.records_read
+                << " entities\n";
+    }
+    // Past the buffer limit the direct GLB references external buffers
+    if (glb_writer && !glb_files.empty()) {
+        std::cout << "Written to " << glb_files.front().string() << " with " << std::fixed << std::setprecision(1)
+                << static_cast<double>(glb_writer->bin_size()) / (1024.0 * 1024.0) << " MB of geometry";
+        if (glb_files.size() > 1) {
+            std::cout << ", " << glb_files.size() - 1 << " external buffers";
+        }
+        std::cout << "\n";
+    }
+    if (xcaf_glb) {
+        std::cout << "XCAF GLB written to " << xcaf_file.string() << "\n";
+    }
+    if (direct_glb && xcaf_glb) {
+        std::cout << "GLB writer A/B: direct " << std::setprecision(3) << glb_writer->seconds() << " s, xcaf "
+                << xcaf_seconds << " s\n";
+    }
 }
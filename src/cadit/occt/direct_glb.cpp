@@ -0,0 +1,119 @@
+#include "direct_glb.h"
+
+#include <chrono>
+#include <optional>
+#include <Interface_InterfaceModel.hxx>
+#include <Quantity_Color.hxx>
+#include <STEPConstruct_Styles.hxx>
+#include <StepRepr_RepresentationItem.hxx>
+#include <StepVisual_Colour.hxx>
+#include <StepVisual_StyledItem.hxx>
+#include <UnitsMethods.hxx>
+#include <UnitsMethods_LengthUnit.hxx>
+#include "gltf_writer.h"
+#include "mesh_extract.h"
+#include "../../json_utils.h"
+
+namespace {
+    double seconds_since(const std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Counts the nodes, meshes and name bytes the product tree adds to the JSON. Every product is a node and every
+    // geometry a mesh with a node, both named after the product.
+    void count_json(const std::vector<std::unique_ptr<ProductNode> > &nodes, std::size_t &num_nodes,
+                    std::size_t &num_meshes, std::size_t &name_bytes) {
+        for (const auto &node: nodes) {
+            const std::size_t name = escape_json(node->name).size();
+            num_nodes += 1 + node->geometryInstances.size();
+            num_meshes += node->geometryInstances.size();
+            name_bytes += name * (1 + 2 * node->geometryInstances.size());
+            count_json(node->children, num_nodes, num_meshes, name_bytes);
+        }
+    }
+
+    std::size_t json_reserve(const std::vector<std::unique_ptr<ProductNode> > &roots) {
+        std::size_t num_nodes = 0;
+        std::size_t num_meshes = 0;
+        std::size_t name_bytes = 0;
+        count_json(roots, num_nodes, num_meshes, name_bytes);
+        return GlbStreamWriter::json_reserve_estimate(num_nodes, num_meshes, name_bytes);
+    }
+}
+
+DirectGlbWriter::DirectGlbWriter(const std::filesystem::path &glb_file,
+                                 const std::vector<std::unique_ptr<ProductNode> > &roots,
+                                 const std::size_t max_buffer_size)
+    : glb_(glb_file, max_buffer_size, json_reserve(roots)) {
+    const auto start = std::chrono::steady_clock::now();
+    add_product_nodes(roots, -1);
+    seconds_ += seconds_since(start);
+}
+
+// Products carry no transformation; their geometries are placed with the absolute transformation of the product,
+// as in the STEP output. The root products convert the shapes, transferred in the session length unit, to glTF.
+void DirectGlbWriter::add_product_nodes(const std::vector<std::unique_ptr<ProductNode> > &nodes, const int parent) {
+    std::optional<GlbStreamWriter::Matrix> matrix;
+    if (parent < 0) {
+        matrix = trsf_to_matrix(gltf_conversion(UnitsMethods::GetCasCadeLengthUnit(UnitsMethods_LengthUnit_Meter)));
+    }
+    for (const auto &node: nodes) {
+        const int glb_node = glb_.add_node(node->name, -1, matrix);
+        if (parent < 0) {
+            glb_.add_root(glb_node);
+        } else {
+            glb_.add_child(parent, glb_node);
+        }
+        nodes_[node->instanceIndex] = glb_node;
+        add_product_nodes(node->children, glb_node);
+    }
+}
+
+void DirectGlbWriter::add_shape(const ProductNode &node, const TopoDS_Shape &shape, const Color &color, const int id) {
+    const auto start = std::chrono::steady_clock::now();
+    const Mesh mesh = shape_to_mesh(shape, id, color);
+    if (!mesh.indices.empty()) {
+        const int mesh_index = glb_.add_mesh(mesh, node.name);
+        glb_.add_child(nodes_.at(node.instanceIndex),
+                       glb_.add_node(node.name, mesh_index, trsf_to_matrix(node.transformation)));
+    }
+    seconds_ += seconds_since(start);
+}
+
+std::vector<std::filesystem::path> DirectGlbWriter::finish() {
+    const auto start = std::chrono::steady_clock::now();
+    auto files = glb_.finish();
+    seconds_ += seconds_since(start);
+    return files;
+}
+
+std::unordered_map<int, Color> read_entity_colors(const Handle(XSControl_WorkSession) &session) {
+    std::unordered_map<int, Color> colors;
+    STEPConstruct_Styles styles(session);
+    if (!styles.LoadStyles()) {
+        return colors;
+    }
+    const Handle(Interface_InterfaceModel) model = session->Model();
+    for (Standard_Integer i = 1; i <= styles.NbStyles(); i++) {
+        const Handle(StepVisual_StyledItem) style = styles.Style(i);
+        if (style.IsNull() || style->Item().IsNull()) {
+            continue;
+        }
+        Handle(StepVisual_Colour) surface_color, boundary_color, curve_color, render_color;
+        Standard_Real render_transparency = 0.0;
+        Standard_Boolean is_component = Standard_False;
+        if (!styles.GetColors(style, surface_color, boundary_color, curve_color, render_color, render_transparency,
+                              is_component)) {
+            continue;
+        }
+        const Handle(StepVisual_Colour) &colour = !surface_color.IsNull() ? surface_color : render_color;
+        Quantity_Color occ_color;
+        if (colour.IsNull() || !STEPConstruct_Styles::DecodeColor(colour, occ_color)) {
+            continue;
+        }
+        colors.emplace(model->Number(style->Item()),
+                       Color(static_cast<float>(occ_color.Red()), static_cast<float>(occ_color.Green()),
+                             static_cast<float>(occ_color.Blue())));
+    }
+    return colors;
+}
@@ -0,0 +1,48 @@
+#ifndef DIRECT_GLB_H
+#define DIRECT_GLB_H
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <TopoDS_Shape.hxx>
+#include <XSControl_WorkSession.hxx>
+#include "step_tree.h"
+#include "../glb/glb_stream_writer.h"
+#include "../../geom/Color.h"
+
+// Writes the GLB straight from the product tree and the triangulated shapes, without an XCAF document.
+//
+// The product tree becomes the node hierarchy up front. Every tessellated geometry is turned into a Mesh and
+// streamed below the node of its product with the absolute transformation of the product.
+class DirectGlbWriter {
+public:
+    // Geometry beyond max_buffer_size bytes (0 = the 4 GB GLB limit) is spilled to external buffers referenced from
+    // the GLB, see GlbStreamWriter. The JSON is reserved from the product tree.
+    DirectGlbWriter(const std::filesystem::path &glb_file, const std::vector<std::unique_ptr<ProductNode> > &roots,
+                    std::size_t max_buffer_size = 0);
+
+    void add_shape(const ProductNode &node, const TopoDS_Shape &shape, const Color &color, int id);
+
+    // Returns the written files, the GLB followed by its external buffers
+    std::vector<std::filesystem::path> finish();
+
+    [[nodiscard]] std::size_t bin_size() const { return glb_.bin_size(); }
+
+    // Time spent building and writing the GLB, tessellation excluded
+    [[nodiscard]] double seconds() const { return seconds_; }
+
+private:
+    void add_product_nodes(const std::vector<std::unique_ptr<ProductNode> > &nodes, int parent);
+
+    GlbStreamWriter glb_;
+    // Instance index of every product to its glTF node
+    std::unordered_map<int, int> nodes_;
+    double seconds_ = 0.0;
+};
+
+// Surface colors of the styled items in the STEP model, keyed by the entity index of the styled representation item
+std::unordered_map<int, Color> read_entity_colors(const Handle(XSControl_WorkSession) &session);
+
+#endif //DIRECT_GLB_H
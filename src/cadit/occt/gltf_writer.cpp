@@ -2,9 +2,17 @@
 // Created by Kristoffer on 07/05/2023.
 //
 
+#include <array>
+#include <iostream>
+#include <map>
+#include <optional>
 #include <vector>
 #include <filesystem>
 
+#include <gp.hxx>
+#include <gp_Trsf.hxx>
+#include <gp_Vec.hxx>
+#include <gp_XYZ.hxx>
 #include <Message_ProgressRange.hxx>
 #include <RWGltf_CafWriter.hxx>
 #include <RWGltf_WriterTrsfFormat.hxx>
@@ -16,7 +24,13 @@
 #include <XCAFDoc_ColorTool.hxx>
 #include <XCAFDoc_DocumentTool.hxx>
 #include <XCAFDoc_ShapeTool.hxx>
+#include <TDF_LabelSequence.hxx>
+#include <TDF_Tool.hxx>
+#include <UnitsMethods.hxx>
+#include <UnitsMethods_LengthUnit.hxx>
 #include "../../geom/OccShape.h"
+#include "../glb/glb_writer.h"
+#include "gltf_writer.h"
 #include "helpers.h"
 
 
@@ -73,9 +87,34 @@ void to_gltf_from_shapes(
 }
 
 
+double document_length_unit(const Handle(TDocStd_Document)& doc)
+{
+    Standard_Real length_unit = 0.0;
+    if (XCAFDoc_DocumentTool::GetLengthUnit(doc, length_unit, UnitsMethods_LengthUnit_Meter) && length_unit > 0.0)
+        return length_unit;
+    return UnitsMethods::GetCasCadeLengthUnit(UnitsMethods_LengthUnit_Meter);
+}
+
+gp_Trsf gltf_conversion(const double length_unit)
+{
+    // (x, y, z) -> (x, z, -y), scaled to meters
+    gp_Trsf trsf;
+    trsf.SetValues(length_unit, 0, 0, 0,
+                   0, 0, length_unit, 0,
+                   0, -length_unit, 0, 0);
+    return trsf;
+}
+
 void to_glb_from_doc(const std::filesystem::path& glb_file, const Handle(TDocStd_Document)& doc) {
     RWGltf_CafWriter writer(glb_file.c_str(), true); // true for binary format
 
+    // Same conversion as the GlbWriter outputs, see gltf_conversion
+    RWMesh_CoordinateSystemConverter& converter = writer.ChangeCoordinateSystemConverter();
+    converter.SetInputLengthUnit(document_length_unit(doc));
+    converter.SetInputCoordinateSystem(RWMesh_CoordinateSystem_Zup);
+    converter.SetOutputLengthUnit(1.0);
+    converter.SetOutputCoordinateSystem(RWMesh_CoordinateSystem_glTF);
+
     // Additional file information (can be empty if not needed)
     const TColStd_IndexedDataMapOfStringString file_info;
 
@@ -91,4 +130,279 @@ void to_glb_from_doc(const std::filesystem::path& glb_file, const Handle(TDocStd
     {
         throw std::runtime_error("Error writing GLB file");
     }
-}
\ No newline at end of file
+}
+
+GlbWriter::Matrix trsf_to_matrix(const gp_Trsf& trsf)
+{
+    std::array<double, 12> row_major{};
+    for (int row = 1; row <= 3; ++row)
+        for (int col = 1; col <= 4; ++col)
+            row_major[(row - 1) * 4 + col - 1] = trsf.Value(row, col);
+    return to_gltf_matrix(row_major);
+}
+
+namespace {
+    class LodSceneBuilder
+    {
+    public:
+        LodSceneBuilder(GlbWriter& writer, const std::map<std::string, std::vector<LodMesh>>& lod_meshes)
+            : writer_(writer), lod_meshes_(lod_meshes)
+        {
+        }
+
+        // Adds the node tree of a shape definition (assembly or part) and returns its root node
+        int add_definition(const TDF_Label& label, const std::string& name, const std::optional<GlbWriter::Matrix>& matrix)
+        {
+            const int node = writer_.add_node(name, -1, matrix);
+
+            if (XCAFDoc_ShapeTool::IsAssembly(label))
+            {
+                TDF_LabelSequence components;
+                XCAFDoc_ShapeTool::GetComponents(label, components);
+                for (Standard_Integer i = 1; i <= components.Length(); ++i)
+                {
+                    const TDF_Label& component = components.Value(i);
+                    TDF_Label referred;
+                    if (!XCAFDoc_ShapeTool::GetReferredShape(component, referred))
+                        continue;
+                    std::string component_name = get_label_name(component);
+                    if (component_name.empty())
+                        component_name = get_label_name(referred);
+
+                    std::optional<GlbWriter::Matrix> component_matrix;
+                    if (const TopLoc_Location location = XCAFDoc_ShapeTool::GetLocation(component); !location.IsIdentity())
+                        component_matrix = trsf_to_matrix(location.Transformation());
+
+                    writer_.add_child(node, add_definition(referred, component_name, component_matrix));
+                }
+                return node;
+            }
+
+            TCollection_AsciiString entry;
+            TDF_Tool::Entry(label, entry);
+            const auto it = lod_meshes_.find(entry.ToCString());
+            if (it == lod_meshes_.end() || it->second.empty())
+                return node;
+
+            const auto& mesh_indices = get_mesh_indices(entry.ToCString(), it->second, name);
+
+            // Every instance gets its own LOD nodes, as MSFT_lod ids may not be shared between nodes
+            const int fine = writer_.add_node(name, mesh_indices[0]);
+            writer_.add_child(node, fine);
+            if (mesh_indices.size() > 1)
+            {
+                std::vector<int> lod_nodes;
+                std::vector<double> screen_coverage{it->second[0].screen_coverage};
+                for (std::size_t level = 1; level < mesh_indices.size(); ++level)
+                {
+                    lod_nodes.push_back(writer_.add_node(name + "_LOD" + std::to_string(level), mesh_indices[level]));
+                    screen_coverage.push_back(it->second[level].screen_coverage);
+                }
+                writer_.set_lods(fine, lod_nodes, screen_coverage);
+            }
+            return node;
+        }
+
+    private:
+        // Meshes are written once per part, regardless of how many times the part is instanced
+        const std::vector<int>& get_mesh_indices(const std::string& entry, const std::vector<LodMesh>& levels,
+                                                 const std::string& name)
+        {
+            auto [it, inserted] = mesh_indices_.try_emplace(entry);
+            if (inserted)
+            {
+                for (std::size_t level = 0; level < levels.size(); ++level)
+                {
+                    const std::string mesh_name = level == 0 ? name : name + "_LOD" + std::to_string(level);
+                    it->second.push_back(writer_.add_mesh(levels[level].mesh, mesh_name));
+                }
+            }
+            return it->second;
+        }
+
+        GlbWriter& writer_;
+        const std::map<std::string, std::vector<LodMesh>>& lod_meshes_;
+        std::map<std::string, std::vector<int>> mesh_indices_;
+    };
+
+    // Calls visit(mesh, path, trsf) for every instance of a meshed simple shape below label, with the finest level
+    // of its mesh, the assembly path of the instance and its world transformation
+    template<typename Visit>
+    void visit_instances(const TDF_Label& label, const std::string& path, const gp_Trsf& trsf,
+                         const std::map<std::string, std::vector<LodMesh>>& lod_meshes, Visit&& visit)
+    {
+        if (XCAFDoc_ShapeTool::IsAssembly(label))
+        {
+            TDF_LabelSequence components;
+            XCAFDoc_ShapeTool::GetComponents(label, components);
+            for (Standard_Integer i = 1; i <= components.Length(); ++i)
+            {
+                const TDF_Label& component = components.Value(i);
+                TDF_Label referred;
+                if (!XCAFDoc_ShapeTool::GetReferredShape(component, referred))
+                    continue;
+                std::string component_name = get_label_name(component);
+                if (component_name.empty())
+                    component_name = get_label_name(referred);
+                const gp_Trsf component_trsf = trsf * XCAFDoc_ShapeTool::GetLocation(component).Transformation();
+                visit_instances(referred, path + "/" + component_name, component_trsf, lod_meshes, visit);
+            }
+            return;
+        }
+
+        TCollection_AsciiString entry;
+        TDF_Tool::Entry(label, entry);
+        const auto it = lod_meshes.find(entry.ToCString());
+        if (it == lod_meshes.end() || it->second.empty() || it->second[0].mesh.indices.empty())
+            return;
+        visit(it->second[0].mesh, path, trsf);
+    }
+
+    // Calls visit_instances for every free shape of the document, placed with root_trsf
+    template<typename Visit>
+    void visit_document_instances(const Handle(TDocStd_Document)& doc, const gp_Trsf& root_trsf,
+                                  const std::map<std::string, std::vector<LodMesh>>& lod_meshes, Visit&& visit)
+    {
+        const Handle(XCAFDoc_ShapeTool) shape_tool = XCAFDoc_DocumentTool::ShapeTool(doc->Main());
+        TDF_LabelSequence free_shapes;
+        shape_tool->GetFreeShapes(free_shapes);
+        for (Standard_Integer i = 1; i <= free_shapes.Length(); ++i)
+        {
+            const TDF_Label& label = free_shapes.Value(i);
+            visit_instances(label, get_label_name(label), root_trsf, lod_meshes, visit);
+        }
+    }
+
+    // Collects the shape instances of a document into one world space mesh per material
+    class BatchBuilder
+    {
+    public:
+        [[nodiscard]] const std::vector<Mesh>& batches() const { return batches_; }
+
+        [[nodiscard]] const std::vector<std::string>& feature_names() const { return feature_names_; }
+
+        void add_instance(const Mesh& mesh, const std::string& path, const gp_Trsf& trsf)
+        {
+            const std::array<float, 4> key{mesh.color.r, mesh.color.g, mesh.color.b, mesh.color.a};
+            const auto [it, inserted] = batch_lookup_.try_emplace(key, batches_.size());
+            if (inserted)
+                batches_.emplace_back(static_cast<int>(batches_.size()), std::vector<float>{},
+                                      std::vector<uint32_t>{}, std::vector<uint32_t>{}, std::vector<float>{},
+                                      MeshType::TRIANGLES, mesh.color);
+            Mesh& batch = batches_[it->second];
+
+            // Normals are kept only as long as every instance in the batch has them
+            const bool with_normals = mesh.normals.size() == mesh.positions.size() &&
+                batch.normals.size() == batch.positions.size();
+            if (!with_normals)
+                batch.normals.clear();
+
+            const auto base = static_cast<uint32_t>(batch.positions.size() / 3);
+            batch.positions.reserve(batch.positions.size() + mesh.positions.size());
+            for (std::size_t i = 0; i < mesh.positions.size(); i += 3)
+            {
+                gp_XYZ point(mesh.positions[i], mesh.positions[i + 1], mesh.positions[i + 2]);
+                trsf.Transforms(point);
+                batch.positions.insert(batch.positions.end(), {
+                                           static_cast<float>(point.X()), static_cast<float>(point.Y()),
+                                           static_cast<float>(point.Z())
+                                       });
+            }
+            if (with_normals)
+            {
+                batch.normals.reserve(batch.normals.size() + mesh.normals.size());
+                for (std::size_t i = 0; i < mesh.normals.size(); i += 3)
+                {
+                    gp_Vec normal(mesh.normals[i], mesh.normals[i + 1], mesh.normals[i + 2]);
+                    normal.Transform(trsf);
+                    if (const double magnitude = normal.Magnitude(); magnitude > 0.0)
+                        normal /= magnitude;
+                    batch.normals.insert(batch.normals.end(), {
+                                             static_cast<float>(normal.X()), static_cast<float>(normal.Y()),
+                                             static_cast<float>(normal.Z())
+                                         });
+                }
+            }
+
+            const auto first_triangle = static_cast<int>(batch.indices.size() / 3);
+            batch.indices.reserve(batch.indices.size() + mesh.indices.size());
+            for (const uint32_t index : mesh.indices)
+                batch.indices.push_back(base + index);
+
+            batch.group_reference.emplace_back(static_cast<int>(feature_names_.size()), first_triangle,
+                                               static_cast<int>(mesh.indices.size() / 3));
+            feature_names_.push_back(path);
+        }
+
+    private:
+        std::map<std::array<float, 4>, std::size_t> batch_lookup_;
+        std::vector<Mesh> batches_;
+        std::vector<std::string> feature_names_;
+    };
+}
+
+std::vector<std::filesystem::path> to_glb_with_lods(const std::filesystem::path& glb_file,
+                                                    const Handle(TDocStd_Document)& doc,
+                                                    const std::map<std::string, std::vector<LodMesh>>& lod_meshes,
+                                                    const GlbOptions& options)
+{
+    const Handle(XCAFDoc_ShapeTool) shape_tool = XCAFDoc_DocumentTool::ShapeTool(doc->Main());
+
+    GlbWriter writer(options);
+    LodSceneBuilder builder(writer, lod_meshes);
+    const GlbWriter::Matrix root_matrix = trsf_to_matrix(gltf_conversion(document_length_unit(doc)));
+
+    TDF_LabelSequence free_shapes;
+    shape_tool->GetFreeShapes(free_shapes);
+    for (Standard_Integer i = 1; i <= free_shapes.Length(); ++i)
+    {
+        const TDF_Label& label = free_shapes.Value(i);
+        writer.add_root(builder.add_definition(label, get_label_name(label), root_matrix));
+    }
+
+    return writer.write(glb_file);
+}
+
+std::vector<std::filesystem::path> to_glb_batched(const std::filesystem::path& glb_file,
+                                                  const Handle(TDocStd_Document)& doc,
+                                                  const std::map<std::string, std::vector<LodMesh>>& lod_meshes,
+                                                  const GlbOptions& options)
+{
+    BatchBuilder builder;
+    visit_document_instances(doc, gltf_conversion(document_length_unit(doc)), lod_meshes, [&](const Mesh& mesh, const std::string& path, const gp_Trsf& trsf)
+    {
+        builder.add_instance(mesh, path, trsf);
+    });
+
+    GlbWriter writer(options);
+    const auto& batches = builder.batches();
+    for (std::size_t i = 0; i < batches.size(); ++i)
+    {
+        const std::string name = "batch_" + std::to_string(i);
+        writer.add_root(writer.add_node(name, writer.add_mesh(batches[i], name)));
+    }
+    writer.set_feature_names(builder.feature_names());
+    auto files = writer.write(glb_file);
+
+    std::cout << "Batched " << builder.feature_names().size() << " shape instances into " << batches.size()
+        << " meshes\n";
+    return files;
+}
+
+void to_tileset(const std::filesystem::path& directory, const Handle(TDocStd_Document)& doc,
+                const std::map<std::string, std::vector<LodMesh>>& lod_meshes, const TilesetOptions& options)
+{
+    // Tiles are in meters, in the Z-up frame of the tileset
+    gp_Trsf to_meters;
+    to_meters.SetScale(gp::Origin(), document_length_unit(doc));
+    std::vector<TileInstance> instances;
+    visit_document_instances(doc, to_meters, lod_meshes, [&](const Mesh& mesh, const std::string& path, const gp_Trsf& trsf)
+    {
+        TileInstance instance{&mesh, trsf_to_matrix(trsf), {}, {}, path};
+        instance_bounds(mesh, instance.matrix, instance.min, instance.max);
+        instances.push_back(std::move(instance));
+    });
+    const std::size_t num_tiles = write_tileset(directory, instances, options);
+    std::cout << "Tileset written to " << (directory / "tileset.json").string() << " with " << instances.size()
+        << " shape instances in " << num_tiles << " tiles\n";
+}
@@ -6,10 +6,51 @@
 #define NANO_OCCT_GLTF_WRITER_H
 
 #include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+#include <gp_Trsf.hxx>
 #include <Standard_Handle.hxx>
 #include <TDocStd_Document.hxx>
+#include "../../geom/Mesh.h"
+#include "../glb/glb_writer.h"
+#include "../glb/tileset_writer.h"
+
+// Meters per model unit of doc, as set by the STEP reader, or the session length unit if it has none
+double document_length_unit(const Handle(TDocStd_Document)& doc);
+
+// Converts model coordinates (length_unit meters per unit, Z up) to glTF coordinates (meters, Y up). Every GLB
+// writer applies it, so the outputs are interchangeable.
+gp_Trsf gltf_conversion(double length_unit);
 
 void to_glb_from_doc(const std::filesystem::path& glb_file, const Handle(TDocStd_Document)& doc);
 
+GlbWriter::Matrix trsf_to_matrix(const gp_Trsf& trsf);
+
+// One level of detail of a shape and the screen coverage below which the viewer switches to the next level
+struct LodMesh {
+    Mesh mesh;
+    double screen_coverage;
+};
+
+// Writes the assembly structure of doc to a GLB using the MSFT_lod extension.
+// lod_meshes maps the entry (TDF_Tool::Entry) of every simple shape label to its levels, finest first.
+// Shapes with a single level are written as plain meshes. Returns the written files, see GlbWriter::write.
+std::vector<std::filesystem::path> to_glb_with_lods(const std::filesystem::path& glb_file,
+                                                    const Handle(TDocStd_Document)& doc,
+                                                    const std::map<std::string, std::vector<LodMesh>>& lod_meshes,
+                                                    const GlbOptions& options = {});
+
+// Writes every shape instance of doc in world coordinates, merged into one mesh per material (finest level only).
+// The triangles of each instance are recorded as a GroupReference of the merged mesh and written with
+// EXT_mesh_features; the scene extras list the assembly path of every instance by its feature id.
+std::vector<std::filesystem::path> to_glb_batched(const std::filesystem::path& glb_file,
+                                                  const Handle(TDocStd_Document)& doc,
+                                                  const std::map<std::string, std::vector<LodMesh>>& lod_meshes,
+                                                  const GlbOptions& options = {});
+
+// Writes every shape instance of doc (finest level only) to a 3D Tiles tileset in directory, see write_tileset
+void to_tileset(const std::filesystem::path& directory, const Handle(TDocStd_Document)& doc,
+                const std::map<std::string, std::vector<LodMesh>>& lod_meshes, const TilesetOptions& options);
 
 #endif //NANO_OCCT_GLTF_WRITER_H
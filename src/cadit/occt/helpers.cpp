@@ -5,16 +5,16 @@
 #include <TopoDS_Solid.hxx>
 #include <BRepPrimAPI_MakeBox.hxx>
 #include <TDF_Label.hxx>
+#include <TCollection_AsciiString.hxx>
 #include <TDataStd_Name.hxx>
 #include <Quantity_Color.hxx>
+#include <Quantity_ColorRGBA.hxx>
 #include <XCAFDoc_ColorType.hxx>
 #include <XCAFDoc_ColorTool.hxx>
 #include <optional>
 #include "../../geom/Color.h"
 #include "helpers.h"
 
-#include <chrono>
-
 
 TopoDS_Solid create_box(const std::vector<float>& box_origin, const std::vector<float>& box_dims)
 {
@@ -42,6 +42,14 @@ void set_name(const TDF_Label& label, const std::optional<std::string>& name)
     TDataStd_Name::Set(label, ext_name);
 }
 
+std::string get_label_name(const TDF_Label& label)
+{
+    Handle(TDataStd_Name) name;
+    if (!label.FindAttribute(TDataStd_Name::GetID(), name))
+        return {};
+    return TCollection_AsciiString(name->Get()).ToCString();
+}
+
 void set_color(const TDF_Label& label, const Color& color,
                const Handle(XCAFDoc_ColorTool)& tool)
 {
@@ -53,6 +61,19 @@ void set_color(const TDF_Label& label, const Color& color,
     tool->SetColor(label, qty_color, XCAFDoc_ColorType::XCAFDoc_ColorSurf);
 }
 
+std::optional<Color> get_color(const TDF_Label& label, const Handle(XCAFDoc_ColorTool)& tool)
+{
+    Quantity_ColorRGBA qty_color;
+    if (!tool->GetColor(label, XCAFDoc_ColorType::XCAFDoc_ColorSurf, qty_color) &&
+        !tool->GetColor(label, XCAFDoc_ColorType::XCAFDoc_ColorGen, qty_color))
+    {
+        return std::nullopt;
+    }
+    const Quantity_Color& rgb = qty_color.GetRGB();
+    return Color(static_cast<float>(rgb.Red()), static_cast<float>(rgb.Green()), static_cast<float>(rgb.Blue()),
+                 qty_color.Alpha());
+}
+
 // Utility function to split a string by a delimiter
 std::vector<std::string> split(const std::string& input, char delimiter) {
     std::vector<std::string> tokens;
@@ -85,19 +106,3 @@ bool check_if_string_in_vector(const std::vector<std::string>& vec, const std::s
                           });
     });
 }
-
-TimingContext::TimingContext(std::string name)
-    : label(std::move(name)), start(std::chrono::high_resolution_clock::now())
-{
-    std::cout << "Starting: " << label << std::endl;
-}
-
-TimingContext::~TimingContext()
-{
-    auto stop = std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration<double>(stop - start).count();
-    std::cout << label << " took " << std::fixed << std::setprecision(2)
-        << duration << " seconds." << std::endl;
-}
-
-#define TIME_BLOCK(name) TimingContext timer_##__LINE__(name)
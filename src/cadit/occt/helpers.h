@@ -8,7 +8,6 @@
 #include <optional>
 #include "../../geom/Color.h"
 #include <string>
-#include <chrono>
 
 std::string strip_quotes(const std::string& input);
 
@@ -22,23 +21,14 @@ Color random_color();
 
 void set_name(const TDF_Label &label, const std::optional<std::string> &name);
 
+// Name of the label, empty if it has none
+std::string get_label_name(const TDF_Label &label);
+
 void set_color(const TDF_Label &label, const Color &color,
                const Handle(XCAFDoc_ColorTool) &tool);
 
+// Surface color of the label, falling back to its generic color
+std::optional<Color> get_color(const TDF_Label &label, const Handle(XCAFDoc_ColorTool) &tool);
 
 
-class TimingContext
-{
-public:
-    explicit TimingContext(std::string name);
-    ~TimingContext();
-
-private:
-    std::string label;
-    std::chrono::time_point<std::chrono::high_resolution_clock> start;
-};
-
-// Macro to create a timing block
-#define TIME_BLOCK(name) TimingContext timer_##__LINE__(name)
-
 #endif // NANO_OCCT_HELPERS_H
@@ -0,0 +1,102 @@
+#include "incremental.h"
+
+#include <sstream>
+#include "geometry_iterator.h"
+#include "mesh_extract.h"
+#include "step_hash.h"
+#include "triangulation_cache.h"
+
+namespace {
+    // Bump when the meaning of the key changes
+    constexpr char MAGIC[] = "STPINC03";
+
+    std::string subtree_hash(const ProductNode &node, const Handle(StepData_StepModel) &model, StepGraphHasher &hasher,
+                             const std::unordered_map<int, Color> &entity_colors,
+                             const IncrementalConversion::Filter &filter,
+                             std::unordered_map<int, std::string> &hashes) {
+        std::ostringstream os;
+        os << "product|" << node.geometryInstances.size() << std::hexfloat;
+        for (const auto &geometry_instance: node.geometryInstances) {
+            if (!filter(node, geometry_instance.entityIndex)) {
+                os << "|skipped";
+                continue;
+            }
+            const auto styled = entity_colors.find(geometry_instance.entityIndex);
+            const Color color = styled != entity_colors.end() ? styled->second : Color();
+            os << '|' << hasher.hash(model->Entity(geometry_instance.entityIndex))
+                    << ',' << color.r << ',' << color.g << ',' << color.b << ',' << color.a;
+        }
+        os << '|' << node.children.size();
+        for (const auto &child: node.children) {
+            os << '|' << subtree_hash(*child, model, hasher, entity_colors, filter, hashes);
+        }
+        Fnv128 digest;
+        digest.update(os.str());
+        return hashes[node.instanceIndex] = digest.hex();
+    }
+}
+
+IncrementalConversion::IncrementalConversion(TriangulationCache &cache,
+                                             const std::vector<std::unique_ptr<ProductNode> > &roots,
+                                             const Handle(StepData_StepModel) &model, StepGraphHasher &hasher,
+                                             const std::unordered_map<int, Color> &entity_colors,
+                                             const Filter &filter, const IMeshTools_Parameters &params,
+                                             const bool analytic_mesh, const double auto_deflection) : cache_(cache) {
+    std::unordered_map<int, std::string> hashes;
+    for (const auto &root: roots) {
+        subtree_hash(*root, model, hasher, entity_colors, filter, hashes);
+    }
+    for (const auto &node: GeometryRange(roots)) {
+        if (!node.geometryInstances.empty()) {
+            ++products_;
+        }
+    }
+    for (const auto &[instance_index, hash]: hashes) {
+        std::ostringstream os;
+        os << MAGIC << '|' << TriangulationCache::make_key(hash, params, analytic_mesh) << '|' << std::hexfloat
+                << auto_deflection;
+        Fnv128 digest;
+        digest.update(os.str());
+        keys_.emplace(instance_index, digest.hex());
+    }
+}
+
+bool IncrementalConversion::reuse(const ProductNode &node, std::vector<Mesh> &meshes) {
+    const auto key = keys_.find(node.instanceIndex);
+    if (key == keys_.end() || !cache_.load_meshes(key->second, meshes) ||
+        meshes.size() != node.geometryInstances.size()) {
+        return false;
+    }
+    ++reused_;
+    return true;
+}
+
+void IncrementalConversion::add(const ProductNode &node, const TopoDS_Shape &shape, const Color &color) {
+    auto &meshes = pending_[node.instanceIndex];
+    meshes.push_back(shape_to_mesh(shape, static_cast<int>(meshes.size()), color));
+    store(node, meshes);
+}
+
+void IncrementalConversion::add_skipped(const ProductNode &node) {
+    auto &meshes = pending_[node.instanceIndex];
+    meshes.emplace_back(static_cast<int>(meshes.size()), std::vector<float>{}, std::vector<uint32_t>{});
+    store(node, meshes);
+}
+
+// Products with a failed geometry are never complete, and not stored
+void IncrementalConversion::store(const ProductNode &node, std::vector<Mesh> &meshes) {
+    if (meshes.size() != node.geometryInstances.size()) {
+        return;
+    }
+    if (const auto key = keys_.find(node.instanceIndex); key != keys_.end()) {
+        cache_.store_meshes(key->second, meshes);
+    }
+    pending_.erase(node.instanceIndex);
+    ++converted_;
+}
+
+void IncrementalConversion::print_report(std::ostream &os) const {
+    os << "Incremental conversion: " << reused_ << " products reused from the cache, " << converted_
+            << " converted, " << products_ - reused_ - converted_
+            << " not stored because a geometry failed or was not converted\n";
+}
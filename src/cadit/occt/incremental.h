@@ -0,0 +1,64 @@
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <IMeshTools_Parameters.hxx>
+#include <StepData_StepModel.hxx>
+#include <TopoDS_Shape.hxx>
+#include "step_tree.h"
+#include "../../geom/Color.h"
+#include "../../geom/Mesh.h"
+
+class StepGraphHasher;
+class TriangulationCache;
+
+// Reuses the meshes of unchanged products of a previous conversion from the triangulation cache.
+//
+// Every product is keyed by the Merkle hash of its subtree: the hashes and colors of its own geometries (see
+// StepGraphHasher) and the subtree hashes of its children, combined with the mesh settings. The meshes of a
+// product whose subtree is unchanged are taken from the cache, so its geometries are neither transferred nor
+// tessellated. A product is stored once all its geometries were added or skipped by the filter.
+//
+// Geometries the filter skips are keyed as skipped instead of by their hash and stored as empty meshes, so a
+// product is reused only under the same filter outcome. Products with a failed geometry are not stored.
+class IncrementalConversion {
+public:
+    // Whether the geometry with the entity index below a product passes the filter
+    using Filter = std::function<bool(const ProductNode &, int)>;
+
+    IncrementalConversion(TriangulationCache &cache, const std::vector<std::unique_ptr<ProductNode> > &roots,
+                          const Handle(StepData_StepModel) &model, StepGraphHasher &hasher,
+                          const std::unordered_map<int, Color> &entity_colors, const Filter &filter,
+                          const IMeshTools_Parameters &params, bool analytic_mesh, double auto_deflection);
+
+    // The meshes of the geometries of node, in geometryInstances order. Returns false if the subtree changed.
+    bool reuse(const ProductNode &node, std::vector<Mesh> &meshes);
+
+    // Records a tessellated geometry of node, in geometryInstances order
+    void add(const ProductNode &node, const TopoDS_Shape &shape, const Color &color);
+
+    // Records a geometry of node that the filter skipped, in geometryInstances order
+    void add_skipped(const ProductNode &node);
+
+    void print_report(std::ostream &os) const;
+
+private:
+    void store(const ProductNode &node, std::vector<Mesh> &meshes);
+
+    TriangulationCache &cache_;
+    // Cache key of every product, by instance index
+    std::unordered_map<int, std::string> keys_;
+    std::unordered_map<int, std::vector<Mesh> > pending_;
+    // Products with geometry, which are reused, stored or left incomplete
+    std::size_t products_ = 0;
+    std::size_t reused_ = 0;
+    std::size_t converted_ = 0;
+};
+
+#endif //INCREMENTAL_H
@@ -0,0 +1,90 @@
+#include "mesh_extract.h"
+
+#include <BRep_Builder.hxx>
+#include <BRep_Tool.hxx>
+#include <BRepLib_ToolTriangulatedShape.hxx>
+#include <Poly_Triangulation.hxx>
+#include <TopExp_Explorer.hxx>
+#include <TopoDS.hxx>
+#include <TopoDS_Compound.hxx>
+#include <TopoDS_Face.hxx>
+
+Mesh shape_to_mesh(const TopoDS_Shape &shape, const int id, const Color &color) {
+    std::vector<float> positions;
+    std::vector<float> normals;
+    std::vector<uint32_t> indices;
+
+    for (TopExp_Explorer explorer(shape, TopAbs_FACE); explorer.More(); explorer.Next()) {
+        const TopoDS_Face &face = TopoDS::Face(explorer.Current());
+        TopLoc_Location location;
+        const Handle(Poly_Triangulation) &triangulation = BRep_Tool::Triangulation(face, location);
+        if (triangulation.IsNull() || triangulation->NbTriangles() == 0) {
+            continue;
+        }
+        if (!triangulation->HasNormals()) {
+            BRepLib_ToolTriangulatedShape::ComputeNormals(face, triangulation);
+        }
+
+        const gp_Trsf trsf = location.Transformation();
+        const bool reversed = face.Orientation() == TopAbs_REVERSED;
+        const auto offset = static_cast<uint32_t>(positions.size() / 3);
+
+        for (Standard_Integer i = 1; i <= triangulation->NbNodes(); ++i) {
+            const gp_Pnt node = triangulation->Node(i).Transformed(trsf);
+            positions.push_back(static_cast<float>(node.X()));
+            positions.push_back(static_cast<float>(node.Y()));
+            positions.push_back(static_cast<float>(node.Z()));
+
+            gp_Dir normal = triangulation->Normal(i).Transformed(trsf);
+            if (reversed) {
+                normal.Reverse();
+            }
+            normals.push_back(static_cast<float>(normal.X()));
+            normals.push_back(static_cast<float>(normal.Y()));
+            normals.push_back(static_cast<float>(normal.Z()));
+        }
+
+        for (Standard_Integer i = 1; i <= triangulation->NbTriangles(); ++i) {
+            Standard_Integer n1, n2, n3;
+            triangulation->Triangle(i).Get(n1, n2, n3);
+            if (reversed) {
+                std::swap(n2, n3);
+            }
+            indices.push_back(offset + n1 - 1);
+            indices.push_back(offset + n2 - 1);
+            indices.push_back(offset + n3 - 1);
+        }
+    }
+
+    return {id, std::move(positions), std::move(indices), {}, std::move(normals), MeshType::TRIANGLES, color};
+}
+
+TopoDS_Shape mesh_to_shape(const Mesh &mesh) {
+    BRep_Builder builder;
+    const auto num_vertices = static_cast<Standard_Integer>(mesh.positions.size() / 3);
+    const auto num_triangles = static_cast<Standard_Integer>(mesh.indices.size() / 3);
+    if (num_triangles == 0) {
+        TopoDS_Compound empty;
+        builder.MakeCompound(empty);
+        return empty;
+    }
+    const bool has_normals = mesh.normals.size() == mesh.positions.size();
+    Handle(Poly_Triangulation) triangulation = new Poly_Triangulation(num_vertices, num_triangles, Standard_False,
+                                                                      has_normals);
+    for (Standard_Integer i = 0; i < num_vertices; ++i) {
+        triangulation->SetNode(i + 1, gp_Pnt(mesh.positions[3 * i], mesh.positions[3 * i + 1],
+                                             mesh.positions[3 * i + 2]));
+        if (has_normals) {
+            triangulation->SetNormal(i + 1, gp_Vec3f(mesh.normals[3 * i], mesh.normals[3 * i + 1],
+                                                     mesh.normals[3 * i + 2]));
+        }
+    }
+    for (Standard_Integer i = 0; i < num_triangles; ++i) {
+        triangulation->SetTriangle(i + 1, Poly_Triangle(static_cast<Standard_Integer>(mesh.indices[3 * i] + 1),
+                                                        static_cast<Standard_Integer>(mesh.indices[3 * i + 1] + 1),
+                                                        static_cast<Standard_Integer>(mesh.indices[3 * i + 2] + 1)));
+    }
+    TopoDS_Face face;
+    builder.MakeFace(face, triangulation);
+    return face;
+}
@@ -0,0 +1,17 @@
+#ifndef MESH_EXTRACT_H
+#define MESH_EXTRACT_H
+
+#include <TopoDS_Shape.hxx>
+#include "../../geom/Color.h"
+#include "../../geom/Mesh.h"
+
+// Collects the current face triangulations of a tessellated shape into a single triangle mesh.
+// Face locations are applied, so the mesh is expressed in the coordinate system of the shape.
+// Faces without a triangulation are skipped. Missing normals are computed from the surface.
+Mesh shape_to_mesh(const TopoDS_Shape &shape, int id, const Color &color = Color());
+
+// The inverse for a stored mesh: one face without surface that carries the mesh as its triangulation, or an empty
+// compound for a mesh without triangles
+TopoDS_Shape mesh_to_shape(const Mesh &mesh);
+
+#endif //MESH_EXTRACT_H
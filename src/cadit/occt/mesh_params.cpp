@@ -0,0 +1,132 @@
+#include "mesh_params.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <Bnd_Box.hxx>
+#include <BRep_Tool.hxx>
+#include <BRepAdaptor_Surface.hxx>
+#include <BRepBndLib.hxx>
+#include <Poly_Triangulation.hxx>
+#include <Precision.hxx>
+#include <TopExp_Explorer.hxx>
+#include <TopoDS.hxx>
+
+IMeshTools_Parameters make_mesh_params(const GlobalConfig &config, const bool in_parallel) {
+    IMeshTools_Parameters meshParams;
+    meshParams.Angle = config.angularDeflection;
+    meshParams.Deflection = config.linearDeflection;
+    meshParams.Relative = config.relativeDeflection;
+    meshParams.MinSize = 0.1;
+    meshParams.AngleInterior = 0.5;
+    meshParams.DeflectionInterior = 0.1;
+    meshParams.CleanModel = Standard_True;
+    meshParams.InParallel = in_parallel ? Standard_True : Standard_False;
+    meshParams.AllowQualityDecrease = Standard_True;
+    return meshParams;
+}
+
+static bool shape_bounds(const TopoDS_Shape &shape, Bnd_Box &box) {
+    // Bounds of the geometry only; existing triangulations of the shape may be outdated
+    BRepBndLib::Add(shape, box, Standard_False);
+    return !box.IsVoid();
+}
+
+double shape_deflection(const TopoDS_Shape &shape, const double ratio, const double fallback) {
+    Bnd_Box box;
+    if (!shape_bounds(shape, box)) {
+        return fallback;
+    }
+    const double diagonal = std::sqrt(box.SquareExtent());
+    if (diagonal <= Precision::Confusion()) {
+        return fallback;
+    }
+    return std::max(ratio * diagonal, Precision::Confusion());
+}
+
+IMeshTools_Parameters with_deflection(const IMeshTools_Parameters &base, const double deflection) {
+    IMeshTools_Parameters params = base;
+    params.Deflection = deflection;
+    params.DeflectionInterior = deflection;
+    params.MinSize = 0.1 * deflection;
+    params.Relative = Standard_False;
+    return params;
+}
+
+IMeshTools_Parameters coarsen_params(const IMeshTools_Parameters &base, const double factor) {
+    IMeshTools_Parameters params = base;
+    params.Deflection *= factor;
+    params.DeflectionInterior *= factor;
+    params.MinSize *= factor;
+    params.Angle = std::min(params.Angle * std::sqrt(factor), 1.0);
+    params.AngleInterior = std::min(params.AngleInterior * std::sqrt(factor), 1.0);
+    return params;
+}
+
+// How the triangle count of a face scales with the deflection, as a power of 1 / deflection. A chord of length l
+// deviates from an arc of radius r by about l^2 / 8r, so the segments per curved direction grow with
+// 1 / sqrt(deflection): planes do not refine, singly curved surfaces refine in one direction and doubly curved ones
+// in two.
+static double deflection_exponent(const GeomAbs_SurfaceType type) {
+    switch (type) {
+        case GeomAbs_Plane:
+            return 0.0;
+        case GeomAbs_Cylinder:
+        case GeomAbs_Cone:
+        case GeomAbs_SurfaceOfExtrusion:
+            return 0.5;
+        default:
+            return 1.0;
+    }
+}
+
+DeflectionReport::DeflectionReport(const double global_deflection, const bool global_relative)
+    : global_deflection_(global_deflection), global_relative_(global_relative) {
+}
+
+void DeflectionReport::add(const TopoDS_Shape &shape, const double deflection) {
+    double global_deflection = global_deflection_;
+    if (global_relative_) {
+        // BRepMesh scales a relative deflection by the largest dimension of the shape
+        Bnd_Box box;
+        if (shape_bounds(shape, box)) {
+            Standard_Real xmin, ymin, zmin, xmax, ymax, zmax;
+            box.Get(xmin, ymin, zmin, xmax, ymax, zmax);
+            global_deflection *= std::max({xmax - xmin, ymax - ymin, zmax - zmin});
+        }
+    }
+    const double ratio = global_deflection > 0.0 ? deflection / global_deflection : 1.0;
+
+    std::size_t triangles = 0;
+    double global_triangles = 0.0;
+
+    for (TopExp_Explorer explorer(shape, TopAbs_FACE); explorer.More(); explorer.Next()) {
+        const TopoDS_Face &face = TopoDS::Face(explorer.Current());
+        TopLoc_Location location;
+        const Handle(Poly_Triangulation) &triangulation = BRep_Tool::Triangulation(face, location);
+        if (triangulation.IsNull()) {
+            continue;
+        }
+        const auto num_triangles = static_cast<std::size_t>(triangulation->NbTriangles());
+        triangles += num_triangles;
+
+        const double exponent = deflection_exponent(BRepAdaptor_Surface(face, Standard_False).GetType());
+        global_triangles += static_cast<double>(num_triangles) * std::pow(ratio, exponent);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    triangles_ += triangles;
+    global_triangles_ += global_triangles;
+    ++num_shapes_;
+}
+
+void DeflectionReport::print(std::ostream &os) const {
+    const double saved = global_triangles_ - static_cast<double>(triangles_);
+    os << "Auto deflection: " << triangles_ << " triangles in " << num_shapes_ << " shapes, an estimated "
+            << static_cast<std::size_t>(global_triangles_) << " with the global deflection";
+    if (global_triangles_ > 0.0) {
+        os << " (estimated " << std::fixed << std::setprecision(1) << 100.0 * saved / global_triangles_
+                << "% saved)";
+    }
+    os << "\n";
+}
@@ -0,0 +1,49 @@
+#ifndef MESH_PARAMS_H
+#define MESH_PARAMS_H
+
+#include <cstddef>
+#include <mutex>
+#include <ostream>
+#include <IMeshTools_Parameters.hxx>
+#include <TopoDS_Shape.hxx>
+#include "../../config_structs.h"
+
+// Mesh parameters given by the command line options. BRepMesh meshes the faces of a shape in parallel only when the
+// shapes are not already meshed concurrently, as nested parallelism oversubscribes the cores.
+IMeshTools_Parameters make_mesh_params(const GlobalConfig &config, bool in_parallel);
+
+// Absolute deflection for a shape in auto deflection mode: a fraction of its bounding box diagonal.
+// Returns fallback for shapes without a bounding box.
+double shape_deflection(const TopoDS_Shape &shape, double ratio, double fallback);
+
+// The parameters of base with an absolute linear deflection. The minimum element size follows the deflection.
+IMeshTools_Parameters with_deflection(const IMeshTools_Parameters &base, double deflection);
+
+// The parameters of base made coarser by factor: linear deflection and minimum size are scaled by factor, the
+// angular deflection by its square root (at most 1 rad). Works for absolute and relative deflections.
+IMeshTools_Parameters coarsen_params(const IMeshTools_Parameters &base, double factor);
+
+// Accumulates the triangles produced with per shape deflections and an estimate of what the global
+// deflection would have produced, without meshing twice. The estimate scales the triangles of every face by the
+// deflection ratio per surface type: not at all for planes, with its square root for cylinders, cones and
+// extrusions, and linearly for doubly curved surfaces. The angular deflection, which also bounds the refinement,
+// is not taken into account.
+class DeflectionReport {
+public:
+    DeflectionReport(double global_deflection, bool global_relative);
+
+    // Adds a tessellated shape meshed with the given absolute deflection. Safe to call from several threads.
+    void add(const TopoDS_Shape &shape, double deflection);
+
+    void print(std::ostream &os) const;
+
+private:
+    double global_deflection_;
+    bool global_relative_;
+    std::mutex mutex_;
+    std::size_t num_shapes_ = 0;
+    std::size_t triangles_ = 0;
+    double global_triangles_ = 0.0;
+};
+
+#endif //MESH_PARAMS_H
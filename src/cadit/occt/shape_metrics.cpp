@@ -0,0 +1,99 @@
+#include "shape_metrics.h"
+
+#include <cstdint>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <BRep_Tool.hxx>
+#include <BRepAdaptor_Surface.hxx>
+#include <Geom_Surface.hxx>
+#include <Poly_Triangulation.hxx>
+#include <TopExp.hxx>
+#include <TopoDS.hxx>
+#include <TopTools_IndexedMapOfShape.hxx>
+#include "../../json_utils.h"
+
+namespace {
+    // Keys of ShapeMetrics::surface_types, in GeomAbs_SurfaceType order
+    constexpr std::array<const char *, GeomAbs_OtherSurface + 1> SURFACE_TYPE_NAMES = {
+        "plane", "cylinder", "cone", "sphere", "torus", "bezier", "bspline", "revolution", "extrusion", "offset",
+        "other"
+    };
+
+    std::size_t primitive_bytes(const std::size_t num_vertices, const std::size_t num_indices) {
+        // Positions and normals, then 16 or 32 bit indices padded to 4 bytes
+        const std::size_t index_size = num_vertices <= std::numeric_limits<std::uint16_t>::max() ? 2 : 4;
+        return 24 * num_vertices + (index_size * num_indices + 3) / 4 * 4;
+    }
+}
+
+void add_mesh_metrics(const TopoDS_Shape &shape, ShapeMetrics &metrics) {
+    TopTools_IndexedMapOfShape faces;
+    TopExp::MapShapes(shape, TopAbs_FACE, faces);
+    metrics.num_faces += faces.Extent();
+    for (Standard_Integer i = 1; i <= faces.Extent(); ++i) {
+        const TopoDS_Face &face = TopoDS::Face(faces(i));
+        TopLoc_Location location;
+        // Faces rebuilt from an earlier mesh have a triangulation but no surface
+        if (!BRep_Tool::Surface(face, location).IsNull()) {
+            const BRepAdaptor_Surface surface(face, Standard_False);
+            ++metrics.surface_types[surface.GetType()];
+        }
+        const Handle(Poly_Triangulation) &triangulation = BRep_Tool::Triangulation(face, location);
+        if (triangulation.IsNull()) {
+            continue;
+        }
+        metrics.num_triangles += triangulation->NbTriangles();
+        metrics.num_vertices += triangulation->NbNodes();
+        metrics.glb_bytes += primitive_bytes(triangulation->NbNodes(), 3 * triangulation->NbTriangles());
+    }
+}
+
+std::size_t mesh_glb_bytes(const Mesh &mesh) {
+    return primitive_bytes(mesh.positions.size() / 3, mesh.indices.size());
+}
+
+MetricsLog::MetricsLog(const std::filesystem::path &glb_file) {
+    if (!glb_file.parent_path().empty()) {
+        create_directories(glb_file.parent_path());
+    }
+    const auto path = glb_file.parent_path() / glb_file.stem().concat("-metrics.jsonl");
+    file_.open(path);
+    if (!file_.is_open()) {
+        throw std::runtime_error("Unable to write " + path.string());
+    }
+}
+
+void MetricsLog::write(const ShapeMetrics &metrics) {
+    // Format outside the lock, the file only sees complete lines
+    std::ostringstream os;
+    os << std::fixed << std::setprecision(6);
+    os << R"({"entityIndex":)" << metrics.entity_index
+            << R"(,"product":")" << escape_json(metrics.product_name) << "\"";
+    os << R"(,"transferSeconds":)";
+    if (metrics.transfer_seconds) {
+        os << *metrics.transfer_seconds;
+    } else {
+        os << "null";
+    }
+    os << R"(,"meshSeconds":)" << metrics.mesh_seconds
+            << R"(,"faces":)" << metrics.num_faces
+            << R"(,"triangles":)" << metrics.num_triangles
+            << R"(,"vertices":)" << metrics.num_vertices
+            << R"(,"surfaceTypes":{)";
+    bool first = true;
+    for (std::size_t i = 0; i < metrics.surface_types.size(); ++i) {
+        if (metrics.surface_types[i] == 0) {
+            continue;
+        }
+        os << (first ? "" : ",") << "\"" << SURFACE_TYPE_NAMES[i] << "\":" << metrics.surface_types[i];
+        first = false;
+    }
+    os << R"(},"glbBytes":)" << metrics.glb_bytes
+            << R"(,"outcome":")" << metrics.outcome << "\"}\n";
+
+    const std::string line = os.str();
+    std::lock_guard<std::mutex> lock(mutex_);
+    file_ << line;
+}
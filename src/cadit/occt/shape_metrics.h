@@ -0,0 +1,54 @@
+#ifndef SHAPE_METRICS_H
+#define SHAPE_METRICS_H
+
+#include <array>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <GeomAbs_SurfaceType.hxx>
+#include <TopoDS_Shape.hxx>
+#include "../../geom/Mesh.h"
+
+// Conversion metrics of one geometry
+struct ShapeMetrics {
+    // STEP entity number of the geometry, 0 if unknown
+    int entity_index = 0;
+    std::string product_name;
+    // Empty when the whole document is transferred at once
+    std::optional<double> transfer_seconds;
+    double mesh_seconds = 0.0;
+    std::size_t num_faces = 0;
+    std::size_t num_triangles = 0;
+    std::size_t num_vertices = 0;
+    // Faces per GeomAbs_SurfaceType
+    std::array<std::size_t, GeomAbs_OtherSurface + 1> surface_types{};
+    // Estimated size of the vertex and index data in the GLB binary chunk
+    std::size_t glb_bytes = 0;
+    // converted, cached, reused, timeout, transfer_failed or skipped
+    std::string outcome;
+};
+
+// Adds the faces, triangles, vertices, surface types and estimated GLB bytes of a tessellated shape. Faces are
+// counted once, like the GLB writer exports them; each face is one primitive with float positions and normals.
+void add_mesh_metrics(const TopoDS_Shape &shape, ShapeMetrics &metrics);
+
+// Size of a mesh in the GLB binary chunk (positions, normals and indices)
+std::size_t mesh_glb_bytes(const Mesh &mesh);
+
+// Writes one JSON object per geometry and line (JSON Lines) to <glb stem>-metrics.jsonl as the conversion runs,
+// so the log never has to be held in memory. Safe to call from several threads.
+class MetricsLog {
+public:
+    explicit MetricsLog(const std::filesystem::path &glb_file);
+
+    void write(const ShapeMetrics &metrics);
+
+private:
+    std::mutex mutex_;
+    std::ofstream file_;
+};
+
+#endif //SHAPE_METRICS_H
@@ -0,0 +1,129 @@
+#include "step_hash.h"
+
+#include <cctype>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <StepData_Protocol.hxx>
+#include <StepData_StepWriter.hxx>
+
+namespace {
+    constexpr char REFERENCE_MARK = '\x01';
+}
+
+void Fnv128::update(const void *data, const std::size_t length) {
+    // The prime is 2^88 + 0x13b, so the product modulo 2^128 is state * 0x13b + (state << 88), computed in 64 bit
+    // halves without a 128 bit integer type
+    constexpr std::uint64_t prime_low = 0x13b;
+    const auto *bytes = static_cast<const unsigned char *>(data);
+    for (std::size_t i = 0; i < length; ++i) {
+        low_ ^= bytes[i];
+        const std::uint64_t low_product = (low_ & 0xffffffffULL) * prime_low;
+        const std::uint64_t high_product = (low_ >> 32) * prime_low + (low_product >> 32);
+        high_ = high_ * prime_low + (high_product >> 32) + (low_ << 24);
+        low_ = (high_product << 32) | (low_product & 0xffffffffULL);
+    }
+}
+
+std::string Fnv128::hex() const {
+    std::ostringstream os;
+    os << std::hex << std::setfill('0') << std::setw(16) << high_ << std::setw(16) << low_;
+    return os.str();
+}
+
+StepGraphHasher::StepGraphHasher(const Handle(StepData_StepModel) &model)
+    : model_(model), lib_(Handle(StepData_Protocol)::DownCast(model->Protocol())) {
+}
+
+std::string StepGraphHasher::entity_record(const Standard_Integer num, std::vector<Standard_Integer> &references) const {
+    StepData_StepWriter writer(model_);
+    writer.SendEntity(num, lib_);
+    std::ostringstream os;
+    writer.Print(os);
+    const std::string text = os.str();
+
+    // Drop the "#n =" label of the entity itself
+    std::size_t start = text.find('=');
+    start = start == std::string::npos ? 0 : start + 1;
+
+    std::string record;
+    record.reserve(text.size() - start);
+    bool in_string = false;
+    for (std::size_t i = start; i < text.size(); ++i) {
+        const char c = text[i];
+        if (c == '\'') {
+            // A quote inside a string is written as two quotes, which toggles twice
+            in_string = !in_string;
+        } else if (c == '#' && !in_string && i + 1 < text.size() && std::isdigit(static_cast<unsigned char>(text[i + 1]))) {
+            Standard_Integer ref = 0;
+            while (i + 1 < text.size() && std::isdigit(static_cast<unsigned char>(text[i + 1]))) {
+                ref = ref * 10 + (text[++i] - '0');
+            }
+            references.push_back(ref);
+            // Placeholder, replaced by the hash of the referenced entity. Not a valid character in STEP text.
+            record += REFERENCE_MARK;
+            continue;
+        } else if (c == '\n' || c == '\r') {
+            continue;
+        }
+        record += c;
+    }
+    return record;
+}
+
+std::string StepGraphHasher::hash(const Handle(Standard_Transient) &entity) {
+    const Standard_Integer root = model_->Number(entity);
+    if (root == 0) {
+        return {};
+    }
+    if (const auto it = memo_.find(root); it != memo_.end()) {
+        return it->second;
+    }
+
+    // Iterative post-order traversal, STEP graphs of large solids are too deep for recursion
+    struct Frame {
+        Standard_Integer num;
+        std::string record;
+        std::vector<Standard_Integer> references;
+        std::size_t next = 0;
+    };
+    std::vector<Frame> stack;
+    std::unordered_map<Standard_Integer, bool> in_progress;
+    stack.push_back({root, {}, {}});
+    stack.back().record = entity_record(root, stack.back().references);
+    in_progress[root] = true;
+
+    while (!stack.empty()) {
+        Frame &frame = stack.back();
+        if (frame.next < frame.references.size()) {
+            const Standard_Integer ref = frame.references[frame.next++];
+            if (memo_.count(ref) || in_progress[ref]) {
+                continue;
+            }
+            Frame child{ref, {}, {}};
+            child.record = entity_record(ref, child.references);
+            in_progress[ref] = true;
+            stack.push_back(std::move(child));
+            continue;
+        }
+
+        Fnv128 digest;
+        std::size_t ref_index = 0;
+        std::size_t last = 0;
+        for (std::size_t pos = frame.record.find(REFERENCE_MARK); pos != std::string::npos;
+             pos = frame.record.find(REFERENCE_MARK, pos + 1)) {
+            digest.update(frame.record.data() + last, pos - last);
+            const Standard_Integer ref = frame.references[ref_index++];
+            // A reference back into the current path (a cycle) only contributes a marker
+            const auto it = memo_.find(ref);
+            digest.update(it != memo_.end() ? "#" + it->second : std::string("#cycle"));
+            last = pos + 1;
+        }
+        digest.update(frame.record.data() + last, frame.record.size() - last);
+
+        in_progress[frame.num] = false;
+        memo_[frame.num] = digest.hex();
+        stack.pop_back();
+    }
+    return memo_[root];
+}
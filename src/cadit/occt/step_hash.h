@@ -0,0 +1,48 @@
+#ifndef STEP_HASH_H
+#define STEP_HASH_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <Standard_Handle.hxx>
+#include <StepData_StepModel.hxx>
+#include <StepData_WriterLib.hxx>
+
+// 128 bit FNV-1a digest (offset basis and prime of the 128 bit variant), written as 32 hex characters. Not a
+// cryptographic hash, but over n distinct inputs the chance of any collision stays around n^2 / 2^129.
+class Fnv128 {
+public:
+    void update(const void *data, std::size_t length);
+
+    void update(const std::string &text) { update(text.data(), text.size()); }
+
+    [[nodiscard]] std::string hex() const;
+
+private:
+    std::uint64_t high_ = 0x6c62272e07bb0142ULL;
+    std::uint64_t low_ = 0x62b821756295c58dULL;
+};
+
+// Content hash of the STEP subgraph below an entity.
+//
+// Every entity is hashed from its written STEP record with the entity numbers of its references replaced by
+// the hashes of the referenced entities (a Merkle hash). The result is independent of the entity numbering,
+// so the same solid in another revision of a file gets the same hash. Results are memoized, so hashing
+// several solids sharing geometry (e.g. a common context) is cheap. Not thread-safe.
+class StepGraphHasher {
+public:
+    explicit StepGraphHasher(const Handle(StepData_StepModel) &model);
+
+    // Empty if the entity is not part of the model
+    std::string hash(const Handle(Standard_Transient) &entity);
+
+private:
+    // STEP record of the entity without its own "#n =" label, and the numbers of the entities it references
+    std::string entity_record(Standard_Integer num, std::vector<Standard_Integer> &references) const;
+
+    Handle(StepData_StepModel) model_;
+    StepData_WriterLib lib_;
+    std::unordered_map<Standard_Integer, std::string> memo_;
+};
+
+#endif //STEP_HASH_H
@@ -3,6 +3,8 @@
 #include <RWGltf_CafWriter.hxx>
 #include <TDocStd_Document.hxx>
 #include <BRepMesh_IncrementalMesh.hxx>
+#include <IMeshData_Status.hxx>
+#include <chrono>
 #include <filesystem>
 #include <XCAFDoc_ShapeTool.hxx>
 #include <Interface_EntityIterator.hxx>
@@ -31,11 +33,12 @@
 #include <StepBasic_Product.hxx>
 #include <StepRepr_Representation.hxx>
 #include <TCollection_HAsciiString.hxx>
-#include <thread>
 #include <unordered_set>
 
 #include "custom_progress.h"
 #include "helpers.h"
+#include "tessellation_watchdog.h"
+#include "../../trace.h"
 
 Handle(Standard_Transient) get_entity_from_graph_path(const Handle(Standard_Transient)& entity,
                                                       Interface_Graph& theGraph, std::vector<std::string> path)
@@ -389,7 +392,7 @@ TopoDS_Shape make_shape(const Handle(StepShape_SolidModel)& solid_model, STEPCon
 {
     if (!solid_model.IsNull())
     {
-        TIME_BLOCK("Transferring solid model entity");
+        TRACE_SCOPE("Transfer solid model entity");
         // Convert the solid model into an OpenCascade shape
         if (!reader.TransferEntity(solid_model))
         {
@@ -406,7 +409,7 @@ TopoDS_Shape make_shape(const Handle(StepShape_Face)& face, STEPControl_Reader&
 {
     if (!face.IsNull())
     {
-        TIME_BLOCK("Transferring face entity");
+        TRACE_SCOPE("Transfer face entity");
         if (!reader.TransferEntity(face))
         {
             std::cerr << "Error transferring face entity" << std::endl;
@@ -428,14 +431,14 @@ TDF_Label add_shape_to_document(const TopoDS_Shape& shape, const std::string& na
     if (!shape.IsNull())
     {
         {
-            TIME_BLOCK("Applying tessellation");
+            TRACE_SCOPE("Apply tessellation");
             // Perform tessellation (discretization) on the shape
             BRepMesh_IncrementalMesh mesh(shape, meshParams); // Adjust 0.1 for finer/coarser tessellation
         }
 
         // Add the TopoDS_Shape to the document
         {
-            TIME_BLOCK("Adding shape '" + name + "' to document\n");
+            TRACE_SCOPE("Add shape to document", name);
             shape_label = shape_tool->AddShape(shape);
         }
     }
@@ -652,47 +655,47 @@ Interface_EntityIterator Get_Associated_SolidModel_BiDirectional(
 }
 
 
-// Function to perform tessellation with a timeout
+// Function to perform tessellation with a timeout.
+// The mesher runs on the calling thread and returns as soon as it is done; the deadline is
+// enforced by the shared watchdog, which cancels this task's own token when it expires.
 bool perform_tessellation_with_timeout(const TopoDS_Shape &shape, const IMeshTools_Parameters &meshParams,
-                                       const int timeoutSeconds, const Handle(CustomProgressIndicator) &progress) {
-
-
-    // Create a progress range with a default name and range
-    const Message_ProgressRange progressRange = progress->Start();
-
-    // Flag to track if the operation timed out
-    std::atomic tessellationComplete = false;
-
-    // Launch tessellation in a separate thread
-    std::thread tessellationThread([&]() {
-        try {
-            // Run tessellation with progress monitoring
-            BRepMesh_IncrementalMesh mesh(shape, meshParams, progressRange);
-
-            // Mark as complete
-            tessellationComplete = true;
-        } catch (const Standard_Failure &e) {
-            std::cerr << "Tessellation failed: " << e.GetMessageString() << "\n";
-        }
-    });
-
-    // Monitor the tessellation thread for timeout
-    const auto start = std::chrono::steady_clock::now();
-    while (std::chrono::steady_clock::now() - start < std::chrono::seconds(timeoutSeconds)) {
-        if (tessellationComplete) {
-            // Tessellation finished successfully
-            std::cout << "Tessellation completed successfully.\n";
-            tessellationThread.join();
+                                       const int timeoutSeconds, const TessellationOptions &options) {
+    const bool use_cache = options.cache != nullptr && !options.geometry_hash.empty();
+    std::string cache_key;
+    if (use_cache) {
+        cache_key = TriangulationCache::make_key(options.geometry_hash, meshParams, options.analytic != nullptr);
+        if (options.cache->load(cache_key, shape)) {
+            if (options.cache_hit != nullptr) {
+                *options.cache_hit = true;
+            }
             return true;
         }
-        std::this_thread::sleep_for(std::chrono::milliseconds(50)); // Poll every 50 ms
     }
 
-    // Timeout occurred, cancel tessellation
-    progress->Cancel();
-    if (tessellationThread.joinable()) {
-        tessellationThread.join();
+    IMeshTools_Parameters params = meshParams;
+    if (options.analytic != nullptr) {
+        options.analytic->add(mesh_analytic_faces(shape, params));
+        // BRepMesh meshes the remaining faces and keeps the analytic ones
+        params.CleanModel = Standard_False;
     }
 
-    return false; // Tessellation timed out
-}
\ No newline at end of file
+    const Handle(SilentProgressIndicator) token = new SilentProgressIndicator();
+    const Message_ProgressRange progressRange = token->Start();
+
+    WatchdogGuard deadline(token, std::chrono::seconds(timeoutSeconds));
+    try {
+        const BRepMesh_IncrementalMesh mesh(shape, params, progressRange);
+        deadline.release();
+        // A deadline that expires after the last UserBreak() check does not invalidate the result
+        if (mesh.GetStatusFlags() & IMeshData_UserBreak) {
+            return false;
+        }
+        if (use_cache) {
+            options.cache->store(cache_key, shape);
+        }
+        return true;
+    } catch (const Standard_Failure &e) {
+        std::cerr << "Tessellation failed: " << e.GetMessageString() << "\n";
+    }
+    return false;
+}
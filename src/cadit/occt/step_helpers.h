@@ -14,7 +14,9 @@
 #include <StepShape_Face.hxx>
 #include <string>
 #include <TopoDS_Shape.hxx> // Include the necessary OpenCascade header for TopoDS_Shape
+#include "analytic_mesh.h"
 #include "custom_progress.h"
+#include "triangulation_cache.h"
 
 std::string getStepProductName(const Handle(Standard_Transient) &entity, Interface_Graph &theGraph);
 
@@ -61,7 +63,20 @@ Interface_EntityIterator Get_Associated_SolidModel_BiDirectional(
 
 gp_Trsf get_product_transform(TopoDS_Shape& shape, const Handle(StepBasic_Product)& product);
 
+// Optional stages around BRepMesh_IncrementalMesh
+struct TessellationOptions {
+    // Run the analytic fast path first and count its faces here
+    AnalyticMeshReport *analytic = nullptr;
+    // Looked up before meshing and filled after a successful tessellation. Requires geometry_hash.
+    TriangulationCache *cache = nullptr;
+    // Hash of the STEP subgraph the shape was transferred from (StepGraphHasher)
+    std::string geometry_hash;
+    // Set to true when the triangulation was loaded from the cache instead of being computed
+    bool *cache_hit = nullptr;
+};
+
+// Returns false if the tessellation failed or was cancelled because it exceeded its timeout
 bool perform_tessellation_with_timeout(const TopoDS_Shape &shape, const IMeshTools_Parameters &meshParams,
-                                       const int timeoutSeconds, const Handle(CustomProgressIndicator) &progress);
+                                       const int timeoutSeconds, const TessellationOptions &options = {});
 
 #endif //STEP_HELPERS_H
@@ -640,7 +640,7 @@ static void ProductNodeToJson(const ProductNode &node, std::ostream &os, int ind
     os << "\"InstanceIndex\": " << node.instanceIndex << ",\n";
 
     indent(indentLevel + 1);
-    os << "\"targetIndex\": " << node.targetIndex.Tag() << ",\n";
+    os << "\"targetIndex\": " << (node.targetIndex.IsNull() ? 0 : node.targetIndex.Tag()) << ",\n";
 
     indent(indentLevel + 1);
     os << "\"name\": \"" << node.name << "\",\n";
@@ -1,42 +1,52 @@
 #include "step_writer.h"
 
-#include <BRepBuilderAPI_Transform.hxx>
+#include <algorithm>
 #include <iostream>
 #include <filesystem>
+#include <limits>
 
-#include <BRep_Builder.hxx>
-#include <Interface_Static.hxx>
 #include <Quantity_Color.hxx>
 #include <Quantity_TypeOfColor.hxx>
-#include <RWGltf_CafWriter.hxx>
-#include <STEPCAFControl_Writer.hxx>
 #include <TCollection_ExtendedString.hxx>
 #include <TDataStd_Name.hxx>
 #include <TDocStd_Application.hxx>
 #include <TDocStd_Document.hxx>
-#include <TopoDS_Compound.hxx>
+#include <TDF_TagSource.hxx>
+#include <UnitsMethods.hxx>
+#include <UnitsMethods_LengthUnit.hxx>
+#include <XCAFDoc_Color.hxx>
 #include <XCAFDoc_DocumentTool.hxx>
-#include <XSControl_WorkSession.hxx>
 #include <TDF_Label.hxx>
 #include <XCAFDoc_ColorTool.hxx>
 #include <XCAFDoc_ShapeTool.hxx>
+#include "gltf_writer.h"
 #include "helpers.h"
 #include "step_tree.h"
 #include "../../geom/Color.h"
 #include <Standard_Handle.hxx>  // For Handle
 
 
-// Constructor with only top-level name
-StepStore::StepStore(const std::string &top_level_name) {
+StepStore::StepStore(const std::vector<std::unique_ptr<ProductNode> > &product_hierarchy,
+                     const std::vector<StepShape> &shapes) {
     initialize();
-    tll_ = shape_tool_->AddShape(comp_, Standard_True);
-    set_name(tll_, top_level_name);
-}
 
-// Constructor with product hierarchy
-StepStore::StepStore(const std::vector<std::unique_ptr<ProductNode> > &product_hierarchy) {
-    initialize();
-    create_hierarchy(product_hierarchy, tll_);
+    // The shapes of every node, indexed by instance index relative to the first node with shapes
+    int first_instance = std::numeric_limits<int>::max();
+    int last_instance = std::numeric_limits<int>::min();
+    for (const auto &shape: shapes) {
+        first_instance = std::min(first_instance, shape.node->instanceIndex);
+        last_instance = std::max(last_instance, shape.node->instanceIndex);
+    }
+    std::vector<std::vector<const StepShape *> > node_shapes;
+    if (!shapes.empty()) {
+        node_shapes.resize(static_cast<std::size_t>(last_instance - first_instance) + 1);
+    }
+    for (const auto &shape: shapes) {
+        node_shapes[shape.node->instanceIndex - first_instance].push_back(&shape);
+    }
+
+    create_hierarchy(product_hierarchy, TDF_Label(), first_instance, node_shapes);
+    shape_tool_->UpdateAssemblies();
 }
 
 
@@ -45,33 +55,35 @@ void StepStore::initialize() {
     app_ = new TDocStd_Application();
     doc_ = new TDocStd_Document(TCollection_ExtendedString("XmlOcaf"));
     app_->InitDocument(doc_);
+    // The document is built without commands, so no deltas are recorded, and is never undone
+    doc_->SetUndoLimit(0);
+    // The shapes are transferred in the session length unit
+    XCAFDoc_DocumentTool::SetLengthUnit(doc_, UnitsMethods::GetCasCadeLengthUnit(UnitsMethods_LengthUnit_Meter));
 
     shape_tool_ = XCAFDoc_DocumentTool::ShapeTool(doc_->Main());
     XCAFDoc_ShapeTool::SetAutoNaming(false);
     color_tool_ = XCAFDoc_DocumentTool::ColorTool(doc_->Main());
-    comp_builder_.MakeCompound(comp_);
 }
 
-// Create a hierarchy of products
+// Create a hierarchy of products with their shapes
 void StepStore::create_hierarchy(const std::vector<std::unique_ptr<ProductNode> > &nodes,
-                                 const TDF_Label &parent_label) {
+                                 const TDF_Label &parent_label, const int first_instance,
+                                 const std::vector<std::vector<const StepShape *> > &node_shapes) {
     for (auto &node: nodes) {
-        TDF_Label child_label = shape_tool_->NewShape();
-        TDF_Label target_label;
-        if (parent_label.IsNull()) {
-            tll_ = shape_tool_->AddShape(comp_, Standard_True);
-            target_label = tll_;
-        } else {
-            target_label = shape_tool_->AddComponent(parent_label, child_label, TopLoc_Location());
-        }
-
+        const TDF_Label child_label = shape_tool_->NewShape();
         set_name(child_label, node->name);
-        product_labels_[node->name] = child_label;
-        entity_labels_[node->instanceIndex] = child_label;
-        node->targetIndex = target_label;
+        node->targetIndex = parent_label.IsNull()
+                                ? child_label
+                                : shape_tool_->AddComponent(parent_label, child_label, TopLoc_Location());
+
+        if (const std::size_t index = node->instanceIndex - first_instance; index < node_shapes.size()) {
+            for (const StepShape *shape: node_shapes[index]) {
+                add_shape(*shape, parent_label.IsNull() ? child_label : parent_label);
+            }
+        }
 
         if (!node->children.empty()) {
-            create_hierarchy(node->children, child_label);
+            create_hierarchy(node->children, child_label, first_instance, node_shapes);
         }
     }
 }
@@ -81,85 +93,26 @@ void StepStore::set_name(const TDF_Label &label, const std::string &name) {
     TDataStd_Name::Set(label, TCollection_ExtendedString(name.c_str()));
 }
 
-// Set color for a label
-void StepStore::set_color(const TDF_Label &label, const Color &rgb_color,
-                          const Handle(XCAFDoc_ColorTool) &color_tool) {
-    Quantity_Color color(rgb_color.r, rgb_color.g, rgb_color.b, Quantity_TOC_RGB);
-    color_tool->SetColor(label, color, XCAFDoc_ColorGen);
-}
-
-// Add a shape
-void StepStore::add_shape(const TopoDS_Shape &shape, const std::string &name,
-                          const Color &rgb_color, const ProductNode &dummy_product) {
-    const TDF_Label dummy_label = entity_labels_[dummy_product.instanceIndex];
-    const TDF_Label parent_label = entity_labels_[dummy_product.parent->instanceIndex];
-
-    if (dummy_label.IsNull()) {
-        throw std::runtime_error("Parent product not found: " + dummy_product.name);
+// Colors are shared by their labels, so each one is added to the color table once
+TDF_Label StepStore::color_label(const Color &rgb_color) {
+    const std::array<float, 3> key{rgb_color.r, rgb_color.g, rgb_color.b};
+    auto [it, inserted] = color_labels_.try_emplace(key);
+    if (inserted) {
+        it->second = TDF_TagSource::NewChild(color_tool_->BaseLabel());
+        XCAFDoc_Color::Set(it->second, Quantity_Color(rgb_color.r, rgb_color.g, rgb_color.b, Quantity_TOC_RGB));
     }
-    const auto location = TopLoc_Location(dummy_product.transformation);
-    // replace the dummy label with the actual shape
-
-    // get parent of dummy label
-    shape_tool_->RemoveComponent(dummy_label);
-    const TDF_Label shape_label = shape_tool_->AddShape(shape, Standard_False, Standard_False);
-    shape_tool_->AddComponent(parent_label, shape_label, location);
-
-    set_color(shape_label, rgb_color, color_tool_);
-    set_name(shape_label, name);
-
-    const auto new_shape = XCAFDoc_ShapeTool::GetShape(shape_label);
-
-    // Add any additional location transformations from product to shape
-    BRepBuilderAPI_Transform shapeTransform(dummy_product.transformation);
-    shapeTransform.Perform(new_shape, Standard_False);
+    return it->second;
 }
 
-// Export the STEP file
-void StepStore::to_step(const std::filesystem::path &step_file) const {
-    shape_tool_->UpdateAssemblies();
-
-    if (!step_file.parent_path().empty() && step_file.parent_path() != "") {
-        create_directories(step_file.parent_path());
-    }
-
-    const Handle(XSControl_WorkSession) session = new XSControl_WorkSession();
-
-    STEPCAFControl_Writer writer(session, Standard_False);
-    writer.SetColorMode(Standard_True);
-    writer.SetNameMode(Standard_True);
-
-    Interface_Static::SetCVal("write.step.assembly", "ON");
-    Interface_Static::SetCVal("write.step.product.context", "PRODUCT");
-    Interface_Static::SetCVal("write.step.unit", "m");
-    Interface_Static::SetCVal("write.step.schema", "AP242");
-
-    writer.Transfer(doc_, STEPControl_AsIs);
-    const IFSelect_ReturnStatus status = writer.Write(step_file.string().c_str());
-
-    if (status != IFSelect_RetDone) {
-        throw std::runtime_error("STEP export failed");
-    }
+// Add a shape, placed with the absolute transformation of its product
+void StepStore::add_shape(const StepShape &shape, const TDF_Label &parent_label) {
+    const TDF_Label shape_label = shape_tool_->AddShape(shape.shape, Standard_False, Standard_False);
+    shape_tool_->AddComponent(parent_label, shape_label, TopLoc_Location(shape.node->transformation));
 
-    std::cout << "STEP export status: " << status << "\n";
+    color_tool_->SetColor(shape_label, color_label(shape.color), XCAFDoc_ColorGen);
+    set_name(shape_label, shape.node->name);
 }
 
 void StepStore::to_glb(const std::filesystem::path &glb_file) const {
-    shape_tool_->UpdateAssemblies();
-
-    RWGltf_CafWriter writer(glb_file.c_str(), true); // true for binary format
-
-    // Additional file information (can be empty if not needed)
-    const TColStd_IndexedDataMapOfStringString file_info;
-
-    // Progress indicator (can be null if progress tracking is not needed)
-    const Message_ProgressRange progress;
-
-    // if output parent directory is != "" and does not exist, create it
-    if (const std::filesystem::path glb_dir = glb_file.parent_path(); !glb_dir.empty() && !exists(glb_dir)) {
-        create_directories(glb_dir);
-    }
-    if (!writer.Perform(doc_, file_info, progress)) {
-        throw std::runtime_error("Error writing GLB file");
-    }
+    to_glb_from_doc(glb_file, doc_);
 }
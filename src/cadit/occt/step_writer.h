@@ -2,31 +2,35 @@
 
 #pragma once
 
-#include <BRep_Builder.hxx>
+#include <array>
 #include <filesystem>
+#include <map>
+#include <memory>
+#include <vector>
 #include <TDocStd_Application.hxx>
 #include <TDocStd_Document.hxx>
-#include <TopoDS_Compound.hxx>
 #include <TDF_Label.hxx>
+#include <TopoDS_Shape.hxx>
 #include <XCAFDoc_ColorTool.hxx>
 #include <XCAFDoc_ShapeTool.hxx>
 #include "step_tree.h"
 #include "../../geom/Color.h"
 
-
+// A converted geometry of a product node
+struct StepShape {
+    const ProductNode* node;
+    TopoDS_Shape shape;
+    Color color;
+};
 
 class StepStore {
 public:
     Handle(TDocStd_Document) doc_;
 
-    explicit StepStore(const std::string& top_level_name = "Assembly");
-
-    explicit StepStore(const std::vector<std::unique_ptr<ProductNode>>& product_hierarchy);
-
-    void add_shape(const TopoDS_Shape& shape, const std::string& name, const Color& rgb_color,
-        const ProductNode& parent_node);
-
-    void to_step(const std::filesystem::path& step_file) const;
+    // Builds the XCAF document of the whole product hierarchy and its shapes in one pass. Every node becomes an
+    // assembly placed in its parent; the shapes of a node are placed in the node's parent with the node's
+    // transformation. The document is complete afterwards and only read by the writers.
+    StepStore(const std::vector<std::unique_ptr<ProductNode>>& product_hierarchy, const std::vector<StepShape>& shapes);
 
     void to_glb(const std::filesystem::path& glb_file) const;
 
@@ -36,18 +40,13 @@ private:
     Handle(XCAFDoc_ShapeTool) shape_tool_;
     Handle(XCAFDoc_ColorTool) color_tool_;
 
-    TopoDS_Compound comp_;
-    BRep_Builder comp_builder_;
-    TDF_Label tll_;
-
-    // Map to store product name to TDF_Label mapping for hierarchy
-    std::unordered_map<std::string, TDF_Label> product_labels_;
-
-    // Map to store source entity index to TDF_Label mapping for shapes
-    std::unordered_map<int, TDF_Label> entity_labels_;
+    // Color labels by RGB. XCAFDoc_ColorTool searches all colors when a color is set by value.
+    std::map<std::array<float, 3>, TDF_Label> color_labels_;
 
     void initialize();
-    void create_hierarchy(const std::vector<std::unique_ptr<ProductNode>> &nodes, const TDF_Label &parent_label);
+    void create_hierarchy(const std::vector<std::unique_ptr<ProductNode>>& nodes, const TDF_Label& parent_label,
+                          int first_instance, const std::vector<std::vector<const StepShape*>>& node_shapes);
+    void add_shape(const StepShape& shape, const TDF_Label& parent_label);
+    TDF_Label color_label(const Color& rgb_color);
     static void set_name(const TDF_Label& label, const std::string& name);
-    static void set_color(const TDF_Label& label, const Color& rgb_color, const Handle(XCAFDoc_ColorTool)& color_tool);
 };
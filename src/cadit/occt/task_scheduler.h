@@ -0,0 +1,68 @@
+#ifndef TASK_SCHEDULER_H
+#define TASK_SCHEDULER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+#ifdef STP2GLB_USE_TBB
+#include <tbb/task_arena.h>
+#include <tbb/task_group.h>
+#endif
+
+// Number of worker threads to use. A value <= 0 means "use all hardware threads".
+inline int resolve_num_threads(const int requested) {
+    if (requested > 0) {
+        return requested;
+    }
+    return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+}
+
+// Run func(i) for i in [0, count) on a pool of workers.
+//
+// Items are handed out strictly in index order through a shared cursor, so callers that
+// sort their work (e.g. largest shape first) get that order honoured by the scheduler.
+// Each worker keeps pulling the next index until the range is exhausted.
+template<typename Func>
+void parallel_for_each_index(const std::size_t count, const int num_threads, Func &&func) {
+    if (count == 0) {
+        return;
+    }
+    const auto num_workers = static_cast<std::size_t>(resolve_num_threads(num_threads));
+    std::atomic<std::size_t> cursor{0};
+
+    auto worker = [&]() {
+        for (std::size_t i = cursor.fetch_add(1); i < count; i = cursor.fetch_add(1)) {
+            func(i);
+        }
+    };
+
+    if (num_workers == 1 || count == 1) {
+        worker();
+        return;
+    }
+
+#ifdef STP2GLB_USE_TBB
+    tbb::task_arena arena(static_cast<int>(num_workers));
+    arena.execute([&]() {
+        tbb::task_group group;
+        for (std::size_t w = 0; w < std::min(num_workers, count); ++w) {
+            group.run(worker);
+        }
+        group.wait();
+    });
+#else
+    std::vector<std::thread> threads;
+    for (std::size_t w = 1; w < std::min(num_workers, count); ++w) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto &thread: threads) {
+        thread.join();
+    }
+#endif
+}
+
+#endif //TASK_SCHEDULER_H
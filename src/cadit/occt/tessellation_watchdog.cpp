@@ -0,0 +1,94 @@
+#include "tessellation_watchdog.h"
+
+TessellationWatchdog &TessellationWatchdog::instance() {
+    static TessellationWatchdog watchdog;
+    return watchdog;
+}
+
+TessellationWatchdog::TessellationWatchdog() {
+    thread_ = std::thread(&TessellationWatchdog::run, this);
+}
+
+TessellationWatchdog::~TessellationWatchdog() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wakeup_.notify_one();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+TessellationWatchdog::Ticket TessellationWatchdog::watch(const Handle(CancellableProgressIndicator) &token,
+                                                         const Clock::time_point deadline) {
+    bool is_earliest;
+    Ticket ticket;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ticket = next_ticket_++;
+        slots_[ticket] = Slot{token, false};
+        is_earliest = deadlines_.empty() || deadline < deadlines_.top().when;
+        deadlines_.push({deadline, ticket});
+    }
+    // Only an earlier deadline changes how long the service thread has to sleep
+    if (is_earliest) {
+        wakeup_.notify_one();
+    }
+    return ticket;
+}
+
+bool TessellationWatchdog::release(const Ticket ticket) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto it = slots_.find(ticket);
+    if (it == slots_.end()) {
+        return false;
+    }
+    const bool expired = it->second.expired;
+    slots_.erase(it);
+    // The heap entry is dropped lazily once it reaches the top
+    return expired;
+}
+
+void TessellationWatchdog::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_) {
+        // Discard deadlines of tasks that already finished
+        while (!deadlines_.empty() && !slots_.contains(deadlines_.top().ticket)) {
+            deadlines_.pop();
+        }
+
+        if (deadlines_.empty()) {
+            wakeup_.wait(lock);
+            continue;
+        }
+
+        const Deadline next = deadlines_.top();
+        if (Clock::now() < next.when) {
+            wakeup_.wait_until(lock, next.when);
+            continue;
+        }
+
+        deadlines_.pop();
+        if (const auto it = slots_.find(next.ticket); it != slots_.end()) {
+            it->second.expired = true;
+            it->second.token->Cancel();
+        }
+    }
+}
+
+WatchdogGuard::WatchdogGuard(const Handle(CancellableProgressIndicator) &token, const std::chrono::seconds timeout)
+    : ticket_(TessellationWatchdog::instance().watch(token, TessellationWatchdog::Clock::now() + timeout)) {
+}
+
+WatchdogGuard::~WatchdogGuard() {
+    release();
+}
+
+bool WatchdogGuard::release() {
+    if (!released_) {
+        expired_ = TessellationWatchdog::instance().release(ticket_);
+        released_ = true;
+    }
+    return expired_;
+}
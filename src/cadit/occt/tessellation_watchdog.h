@@ -0,0 +1,83 @@
+#ifndef TESSELLATION_WATCHDOG_H
+#define TESSELLATION_WATCHDOG_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <Standard_Handle.hxx>
+#include "custom_progress.h"
+
+//! Single background service that enforces the deadlines of all in-flight tessellations.
+//!
+//! Deadlines are kept in a min-heap and the service thread sleeps on a condition variable
+//! until the earliest one is due (or a new, earlier one is registered). When a deadline
+//! passes, the cancellation token of that task is triggered. Tasks that finish in time
+//! simply release their ticket, so no thread is spawned or polled per shape.
+class TessellationWatchdog {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Ticket = std::uint64_t;
+
+    static TessellationWatchdog &instance();
+
+    ~TessellationWatchdog();
+
+    TessellationWatchdog(const TessellationWatchdog &) = delete;
+
+    TessellationWatchdog &operator=(const TessellationWatchdog &) = delete;
+
+    //! Registers a token to be cancelled once the deadline has passed
+    Ticket watch(const Handle(CancellableProgressIndicator) &token, Clock::time_point deadline);
+
+    //! Unregisters a ticket. Returns true if the deadline had already expired and the token was cancelled
+    bool release(Ticket ticket);
+
+private:
+    TessellationWatchdog();
+
+    void run();
+
+    struct Deadline {
+        Clock::time_point when;
+        Ticket ticket;
+
+        bool operator>(const Deadline &other) const { return when > other.when; }
+    };
+
+    struct Slot {
+        Handle(CancellableProgressIndicator) token;
+        bool expired = false;
+    };
+
+    std::priority_queue<Deadline, std::vector<Deadline>, std::greater<> > deadlines_;
+    std::unordered_map<Ticket, Slot> slots_;
+    Ticket next_ticket_ = 1;
+    bool stop_ = false;
+
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    std::thread thread_;
+};
+
+//! RAII registration of a single task with the watchdog
+class WatchdogGuard {
+public:
+    WatchdogGuard(const Handle(CancellableProgressIndicator) &token, std::chrono::seconds timeout);
+
+    ~WatchdogGuard();
+
+    //! Releases the ticket now. Returns true if the deadline expired before the task finished
+    bool release();
+
+private:
+    TessellationWatchdog::Ticket ticket_;
+    bool released_ = false;
+    bool expired_ = false;
+};
+
+#endif //TESSELLATION_WATCHDOG_H
@@ -0,0 +1,97 @@
+#include "triangle_budget.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <TDF_LabelSequence.hxx>
+#include <TDF_Tool.hxx>
+#include <XCAFDoc_ShapeTool.hxx>
+#include "task_scheduler.h"
+#include "../../geom/decimation.h"
+
+namespace {
+    // Number of times a shape label is placed in the scene, through all levels of assemblies
+    std::size_t count_instances(const TDF_Label &label, std::map<std::string, std::size_t> &memo) {
+        TCollection_AsciiString entry;
+        TDF_Tool::Entry(label, entry);
+        if (const auto it = memo.find(entry.ToCString()); it != memo.end()) {
+            return it->second;
+        }
+        std::size_t count = XCAFDoc_ShapeTool::IsFree(label) ? 1 : 0;
+        TDF_LabelSequence users;
+        XCAFDoc_ShapeTool::GetUsers(label, users, Standard_False);
+        for (Standard_Integer i = 1; i <= users.Length(); ++i) {
+            // Users are component labels, their father is the assembly holding them
+            count += count_instances(users.Value(i).Father(), memo);
+        }
+        memo[entry.ToCString()] = count;
+        return count;
+    }
+
+    double squared_diagonal(const Mesh &mesh) {
+        if (mesh.positions.empty()) {
+            return 0.0;
+        }
+        float lo[3] = {std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+                       std::numeric_limits<float>::max()};
+        float hi[3] = {std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(),
+                       std::numeric_limits<float>::lowest()};
+        for (std::size_t i = 0; i < mesh.positions.size(); ++i) {
+            lo[i % 3] = std::min(lo[i % 3], mesh.positions[i]);
+            hi[i % 3] = std::max(hi[i % 3], mesh.positions[i]);
+        }
+        double sum = 0.0;
+        for (int k = 0; k < 3; ++k) {
+            const double extent = static_cast<double>(hi[k]) - static_cast<double>(lo[k]);
+            sum += extent * extent;
+        }
+        return sum;
+    }
+}
+
+void fit_triangle_budget(std::vector<BudgetMesh> &meshes, const Handle(TDocStd_Document) &doc,
+                         const std::size_t max_triangles, const int num_threads, std::ostream &os) {
+    std::map<std::string, std::size_t> instance_memo;
+
+    std::vector<TriangleBudgetItem> items;
+    items.reserve(meshes.size());
+    for (const auto &budget_mesh: meshes) {
+        TDF_Label label;
+        TDF_Tool::Label(doc->GetData(), budget_mesh.entry.c_str(), label);
+        const std::size_t instances = label.IsNull() ? 1 : std::max<std::size_t>(count_instances(label, instance_memo), 1);
+        items.push_back({budget_mesh.mesh.indices.size() / 3, instances,
+                         static_cast<double>(instances) * squared_diagonal(budget_mesh.mesh)});
+    }
+    const auto targets = allocate_triangle_budget(items, max_triangles);
+
+    std::vector<DecimationResult> results(meshes.size());
+    parallel_for_each_index(meshes.size(), num_threads, [&](const std::size_t i) {
+        results[i] = decimate_mesh(meshes[i].mesh, targets[i]);
+    });
+
+    std::size_t rendered_before = 0;
+    std::size_t rendered_after = 0;
+    std::size_t num_decimated = 0;
+    std::size_t worst = meshes.size();
+    for (std::size_t i = 0; i < meshes.size(); ++i) {
+        rendered_before += results[i].triangles_before * items[i].instances;
+        rendered_after += results[i].triangles_after * items[i].instances;
+        if (results[i].triangles_after < results[i].triangles_before) {
+            ++num_decimated;
+        }
+        if (results[i].max_error > 0.0 && (worst == meshes.size() || results[i].max_error > results[worst].max_error)) {
+            worst = i;
+        }
+    }
+    os << "Triangle budget: " << rendered_before << " -> " << rendered_after << " rendered triangles (budget "
+            << max_triangles << "), " << num_decimated << " of " << meshes.size() << " meshes decimated\n";
+    if (rendered_after > max_triangles) {
+        os << "Triangle budget: decimation stopped early to keep the meshes valid, the budget is exceeded\n";
+    }
+    if (worst != meshes.size()) {
+        os << "Triangle budget: largest decimation error " << std::scientific << std::setprecision(3)
+                << results[worst].max_error << std::defaultfloat << " in " << meshes[worst].name << " ("
+                << results[worst].triangles_before << " -> " << results[worst].triangles_after << " triangles)\n";
+    }
+}
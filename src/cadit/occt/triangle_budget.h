@@ -0,0 +1,27 @@
+#ifndef TRIANGLE_BUDGET_H
+#define TRIANGLE_BUDGET_H
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <Standard_Handle.hxx>
+#include <TDocStd_Document.hxx>
+#include "../../geom/Mesh.h"
+
+// Mesh of a simple shape label, identified by its TDF_Tool::Entry
+struct BudgetMesh {
+    std::string entry;
+    std::string name;
+    Mesh mesh;
+};
+
+// Decimates the part meshes of doc so that all instances together have at most max_triangles triangles.
+//
+// The budget is shared by visual importance: the number of instances of a part times its squared bounding box
+// diagonal, a measure of its projected size. Meshes are decimated in parallel and a report of the triangle
+// counts and the largest error introduced is printed to os.
+void fit_triangle_budget(std::vector<BudgetMesh> &meshes, const Handle(TDocStd_Document) &doc,
+                         std::size_t max_triangles, int num_threads, std::ostream &os);
+
+#endif //TRIANGLE_BUDGET_H
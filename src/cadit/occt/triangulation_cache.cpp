@@ -0,0 +1,238 @@
+#include "triangulation_cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <vector>
+#include <BRep_Builder.hxx>
+#include <BRep_Tool.hxx>
+#include <Poly_Triangulation.hxx>
+#include <TopExp.hxx>
+#include <TopoDS.hxx>
+#include <TopTools_IndexedMapOfShape.hxx>
+#include "step_hash.h"
+#include "triangulation_io.h"
+
+namespace {
+    // Bump when the layout of an entry or the meaning of the key changes
+    constexpr char MAGIC[8] = {'S', 'T', 'P', 'T', 'R', 'I', '0', '1'};
+    constexpr char MESH_MAGIC[8] = {'S', 'T', 'P', 'M', 'S', 'H', '0', '1'};
+}
+
+TriangulationCache::TriangulationCache(std::filesystem::path directory, const std::uintmax_t max_bytes)
+    : directory_(std::move(directory)), max_bytes_(max_bytes) {
+    create_directories(directory_);
+}
+
+std::string TriangulationCache::make_key(const std::string &geometry_hash, const IMeshTools_Parameters &params,
+                                         const bool analytic_mesh) {
+    // Only the parameters that change the result. Doubles are written exactly.
+    std::ostringstream os;
+    os << std::string(MAGIC, sizeof(MAGIC)) << '|' << geometry_hash << '|' << std::hexfloat
+            << params.Angle << ',' << params.Deflection << ',' << params.AngleInterior << ','
+            << params.DeflectionInterior << ',' << params.MinSize << ',' << params.Relative << ','
+            << params.InternalVerticesMode << ',' << params.ControlSurfaceDeflection << ','
+            << params.AdjustMinSize << ',' << params.ForceFaceDeflection << ',' << analytic_mesh;
+    Fnv128 digest;
+    digest.update(os.str());
+    return digest.hex();
+}
+
+std::filesystem::path TriangulationCache::entry_path(const std::string &key) const {
+    return directory_ / (key + ".tri");
+}
+
+bool TriangulationCache::read_entry(const std::string &key, std::vector<char> &data) const {
+    std::ifstream file(entry_path(key), std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+void TriangulationCache::mark_used(const std::string &key) {
+    // The modification time orders the entries for the eviction
+    std::error_code ec;
+    last_write_time(entry_path(key), std::filesystem::file_time_type::clock::now(), ec);
+    ++hits_;
+}
+
+void TriangulationCache::write_entry(const std::string &key, const std::vector<char> &data) {
+    // Write to a unique temporary file first, so readers never see a partial entry
+    static thread_local std::mt19937_64 generator(std::random_device{}());
+    const auto path = entry_path(key);
+    auto temp_path = path;
+    temp_path += "." + std::to_string(generator()) + ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::binary);
+        if (!file.is_open()) {
+            return;
+        }
+        file.write(data.data(), static_cast<std::streamsize>(data.size()));
+        if (!file) {
+            file.close();
+            std::error_code ec;
+            remove(temp_path, ec);
+            return;
+        }
+    }
+    std::error_code ec;
+    rename(temp_path, path, ec);
+    if (ec) {
+        remove(temp_path, ec);
+        return;
+    }
+    ++stores_;
+    bytes_written_ += data.size();
+}
+
+bool TriangulationCache::load(const std::string &key, const TopoDS_Shape &shape) {
+    std::vector<char> data;
+    if (!read_entry(key, data)) {
+        ++misses_;
+        return false;
+    }
+
+    TopTools_IndexedMapOfShape faces;
+    TopExp::MapShapes(shape, TopAbs_FACE, faces);
+
+    // Everything is parsed before the shape is touched, so a damaged entry is just a miss
+    ByteReader reader(data);
+    char magic[sizeof(MAGIC)];
+    std::uint32_t num_faces = 0;
+    if (!reader.get(magic) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || !reader.get(num_faces) ||
+        static_cast<Standard_Integer>(num_faces) != faces.Extent()) {
+        ++misses_;
+        return false;
+    }
+    std::vector<Handle(Poly_Triangulation)> triangulations;
+    triangulations.reserve(num_faces);
+    for (std::uint32_t i = 0; i < num_faces; ++i) {
+        Handle(Poly_Triangulation) triangulation;
+        if (!read_triangulation(reader, triangulation)) {
+            ++misses_;
+            return false;
+        }
+        triangulations.push_back(triangulation);
+    }
+
+    BRep_Builder builder;
+    for (Standard_Integer i = 1; i <= faces.Extent(); ++i) {
+        if (!triangulations[i - 1].IsNull()) {
+            builder.UpdateFace(TopoDS::Face(faces(i)), triangulations[i - 1]);
+        }
+    }
+    mark_used(key);
+    return true;
+}
+
+void TriangulationCache::store(const std::string &key, const TopoDS_Shape &shape) {
+    TopTools_IndexedMapOfShape faces;
+    TopExp::MapShapes(shape, TopAbs_FACE, faces);
+
+    ByteWriter writer;
+    writer.put(MAGIC);
+    writer.put(static_cast<std::uint32_t>(faces.Extent()));
+    for (Standard_Integer i = 1; i <= faces.Extent(); ++i) {
+        TopLoc_Location location;
+        write_triangulation(writer, BRep_Tool::Triangulation(TopoDS::Face(faces(i)), location));
+    }
+    write_entry(key, writer.data);
+}
+
+bool TriangulationCache::load_meshes(const std::string &key, std::vector<Mesh> &meshes) {
+    std::vector<char> data;
+    if (!read_entry(key, data)) {
+        ++misses_;
+        return false;
+    }
+    ByteReader reader(data);
+    char magic[sizeof(MESH_MAGIC)];
+    std::uint32_t num_meshes = 0;
+    if (!reader.get(magic) || std::memcmp(magic, MESH_MAGIC, sizeof(MESH_MAGIC)) != 0 || !reader.get(num_meshes) ||
+        num_meshes > reader.remaining()) {
+        ++misses_;
+        return false;
+    }
+    std::vector<Mesh> loaded;
+    loaded.reserve(num_meshes);
+    for (std::uint32_t i = 0; i < num_meshes; ++i) {
+        Mesh mesh(static_cast<int>(i), {}, {});
+        if (!read_mesh(reader, mesh)) {
+            ++misses_;
+            return false;
+        }
+        loaded.push_back(std::move(mesh));
+    }
+    meshes = std::move(loaded);
+    mark_used(key);
+    return true;
+}
+
+void TriangulationCache::store_meshes(const std::string &key, const std::vector<Mesh> &meshes) {
+    ByteWriter writer;
+    writer.put(MESH_MAGIC);
+    writer.put(static_cast<std::uint32_t>(meshes.size()));
+    for (const auto &mesh: meshes) {
+        write_mesh(writer, mesh);
+    }
+    write_entry(key, writer.data);
+}
+
+void TriangulationCache::evict() const {
+    struct Entry {
+        std::filesystem::path path;
+        std::uintmax_t size;
+        std::filesystem::file_time_type last_used;
+    };
+    std::vector<Entry> entries;
+    std::uintmax_t total = 0;
+    std::error_code ec;
+    for (const auto &item: std::filesystem::directory_iterator(directory_, ec)) {
+        if (!item.is_regular_file(ec) || item.path().extension() != ".tri") {
+            continue;
+        }
+        const auto size = item.file_size(ec);
+        if (ec) {
+            continue;
+        }
+        entries.push_back({item.path(), size, item.last_write_time(ec)});
+        total += size;
+    }
+    if (total <= max_bytes_) {
+        return;
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+        return a.last_used < b.last_used;
+    });
+    std::size_t removed = 0;
+    for (const auto &entry: entries) {
+        if (total <= max_bytes_) {
+            break;
+        }
+        if (remove(entry.path, ec)) {
+            total -= entry.size;
+            ++removed;
+        }
+    }
+    std::cout << "Triangulation cache: evicted " << removed << " entries\n";
+}
+
+void TriangulationCache::print_report(std::ostream &os) const {
+    const std::size_t hits = hits_;
+    const std::size_t lookups = hits + misses_;
+    os << "Triangulation cache: " << hits << " hits, " << misses_ << " misses";
+    if (lookups > 0) {
+        os << " (" << std::fixed << std::setprecision(1)
+                << 100.0 * static_cast<double>(hits) / static_cast<double>(lookups) << "% hit rate)";
+    }
+    os << ", " << stores_ << " entries written (" << std::setprecision(1)
+            << static_cast<double>(bytes_written_) / (1024.0 * 1024.0) << " MB)\n";
+}
@@ -0,0 +1,63 @@
+#ifndef TRIANGULATION_CACHE_H
+#define TRIANGULATION_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <IMeshTools_Parameters.hxx>
+#include <TopoDS_Shape.hxx>
+#include "../../geom/Mesh.h"
+
+// Content addressed on-disk cache of face triangulations.
+//
+// An entry holds the triangulation of every face of a shape, in TopExp::MapShapes order, and is keyed by the
+// hash of the STEP subgraph the shape was transferred from (see StepGraphHasher) and the mesh parameters.
+// Entries are written atomically (temporary file + rename), so concurrent threads and processes can share a
+// directory. Loading an entry marks it as recently used; evict() removes the least recently used entries
+// until the directory fits in its size limit.
+//
+// The cache also holds extracted meshes, for conversions that skip the transfer of unchanged geometry altogether
+// (see IncrementalConversion). They are stored and evicted like the triangulations.
+class TriangulationCache {
+public:
+    TriangulationCache(std::filesystem::path directory, std::uintmax_t max_bytes);
+
+    static std::string make_key(const std::string &geometry_hash, const IMeshTools_Parameters &params,
+                                bool analytic_mesh);
+
+    // Applies the cached triangulations to the faces of shape. Returns false on a miss.
+    bool load(const std::string &key, const TopoDS_Shape &shape);
+
+    void store(const std::string &key, const TopoDS_Shape &shape);
+
+    // Returns false on a miss
+    bool load_meshes(const std::string &key, std::vector<Mesh> &meshes);
+
+    void store_meshes(const std::string &key, const std::vector<Mesh> &meshes);
+
+    void evict() const;
+
+    void print_report(std::ostream &os) const;
+
+private:
+    [[nodiscard]] std::filesystem::path entry_path(const std::string &key) const;
+
+    bool read_entry(const std::string &key, std::vector<char> &data) const;
+
+    // Counts the hit and marks the entry as recently used
+    void mark_used(const std::string &key);
+
+    void write_entry(const std::string &key, const std::vector<char> &data);
+
+    std::filesystem::path directory_;
+    std::uintmax_t max_bytes_;
+    std::atomic<std::size_t> hits_{0};
+    std::atomic<std::size_t> misses_{0};
+    std::atomic<std::size_t> stores_{0};
+    std::atomic<std::uintmax_t> bytes_written_{0};
+};
+
+#endif //TRIANGULATION_CACHE_H
@@ -0,0 +1,158 @@
+#include "triangulation_io.h"
+
+#include <cstdint>
+
+namespace {
+    constexpr std::uint8_t HAS_NORMALS = 1;
+    constexpr std::uint8_t HAS_UV = 2;
+}
+
+void write_triangulation(ByteWriter &writer, const Handle(Poly_Triangulation) &triangulation) {
+    if (triangulation.IsNull()) {
+        writer.put(std::uint32_t{0});
+        writer.put(std::uint32_t{0});
+        writer.put(std::uint8_t{0});
+        writer.put(0.0);
+        return;
+    }
+    const Standard_Integer num_nodes = triangulation->NbNodes();
+    const Standard_Integer num_triangles = triangulation->NbTriangles();
+    std::uint8_t flags = 0;
+    if (triangulation->HasNormals()) flags |= HAS_NORMALS;
+    if (triangulation->HasUVNodes()) flags |= HAS_UV;
+
+    writer.put(static_cast<std::uint32_t>(num_nodes));
+    writer.put(static_cast<std::uint32_t>(num_triangles));
+    writer.put(flags);
+    writer.put(triangulation->Deflection());
+    for (Standard_Integer i = 1; i <= num_nodes; ++i) {
+        const gp_Pnt node = triangulation->Node(i);
+        const double xyz[3] = {node.X(), node.Y(), node.Z()};
+        writer.put(xyz);
+    }
+    if (flags & HAS_UV) {
+        for (Standard_Integer i = 1; i <= num_nodes; ++i) {
+            const gp_Pnt2d uv_node = triangulation->UVNode(i);
+            const double uv[2] = {uv_node.X(), uv_node.Y()};
+            writer.put(uv);
+        }
+    }
+    if (flags & HAS_NORMALS) {
+        for (Standard_Integer i = 1; i <= num_nodes; ++i) {
+            gp_Vec3f normal;
+            triangulation->Normal(i, normal);
+            const float xyz[3] = {normal.x(), normal.y(), normal.z()};
+            writer.put(xyz);
+        }
+    }
+    for (Standard_Integer i = 1; i <= num_triangles; ++i) {
+        Standard_Integer n1, n2, n3;
+        triangulation->Triangle(i).Get(n1, n2, n3);
+        const std::int32_t nodes[3] = {n1, n2, n3};
+        writer.put(nodes);
+    }
+}
+
+bool read_triangulation(ByteReader &reader, Handle(Poly_Triangulation) &triangulation) {
+    std::uint32_t num_nodes = 0, num_triangles = 0;
+    std::uint8_t flags = 0;
+    double deflection = 0.0;
+    if (!reader.get(num_nodes) || !reader.get(num_triangles) || !reader.get(flags) || !reader.get(deflection)) {
+        return false;
+    }
+    if (num_nodes == 0) {
+        return true;
+    }
+    // Smallest possible size of the arrays, to reject damaged counts before allocating
+    if (24ULL * num_nodes + 12ULL * num_triangles > reader.remaining()) {
+        return false;
+    }
+
+    triangulation = new Poly_Triangulation(
+        static_cast<Standard_Integer>(num_nodes), static_cast<Standard_Integer>(num_triangles),
+        (flags & HAS_UV) != 0, (flags & HAS_NORMALS) != 0);
+    for (Standard_Integer i = 1; i <= static_cast<Standard_Integer>(num_nodes); ++i) {
+        double xyz[3];
+        if (!reader.get(xyz)) {
+            return false;
+        }
+        triangulation->SetNode(i, gp_Pnt(xyz[0], xyz[1], xyz[2]));
+    }
+    if (flags & HAS_UV) {
+        for (Standard_Integer i = 1; i <= static_cast<Standard_Integer>(num_nodes); ++i) {
+            double uv[2];
+            if (!reader.get(uv)) {
+                return false;
+            }
+            triangulation->SetUVNode(i, gp_Pnt2d(uv[0], uv[1]));
+        }
+    }
+    if (flags & HAS_NORMALS) {
+        for (Standard_Integer i = 1; i <= static_cast<Standard_Integer>(num_nodes); ++i) {
+            float normal[3];
+            if (!reader.get(normal)) {
+                return false;
+            }
+            triangulation->SetNormal(i, gp_Vec3f(normal[0], normal[1], normal[2]));
+        }
+    }
+    for (Standard_Integer i = 1; i <= static_cast<Standard_Integer>(num_triangles); ++i) {
+        std::int32_t nodes[3];
+        if (!reader.get(nodes)) {
+            return false;
+        }
+        triangulation->SetTriangle(i, Poly_Triangle(nodes[0], nodes[1], nodes[2]));
+    }
+    triangulation->Deflection(deflection);
+    return true;
+}
+
+void write_mesh(ByteWriter &writer, const Mesh &mesh) {
+    const float color[4] = {mesh.color.r, mesh.color.g, mesh.color.b, mesh.color.a};
+    writer.put(color);
+    writer.put(static_cast<std::uint32_t>(mesh.positions.size() / 3));
+    writer.put(static_cast<std::uint8_t>(mesh.normals.size() == mesh.positions.size() ? HAS_NORMALS : 0));
+    writer.put(static_cast<std::uint32_t>(mesh.indices.size()));
+    for (const float value: mesh.positions) {
+        writer.put(value);
+    }
+    if (mesh.normals.size() == mesh.positions.size()) {
+        for (const float value: mesh.normals) {
+            writer.put(value);
+        }
+    }
+    for (const std::uint32_t index: mesh.indices) {
+        writer.put(index);
+    }
+}
+
+bool read_mesh(ByteReader &reader, Mesh &mesh) {
+    float color[4];
+    std::uint32_t num_vertices = 0, num_indices = 0;
+    std::uint8_t flags = 0;
+    if (!reader.get(color) || !reader.get(num_vertices) || !reader.get(flags) || !reader.get(num_indices) ||
+        num_indices % 3 != 0) {
+        return false;
+    }
+    const std::size_t num_values = 3ULL * num_vertices;
+    if (4ULL * (num_values * ((flags & HAS_NORMALS) ? 2 : 1) + num_indices) > reader.remaining()) {
+        return false;
+    }
+    mesh.color = Color(color[0], color[1], color[2], color[3]);
+    mesh.positions.resize(num_values);
+    for (float &value: mesh.positions) {
+        reader.get(value);
+    }
+    mesh.normals.resize((flags & HAS_NORMALS) ? num_values : 0);
+    for (float &value: mesh.normals) {
+        reader.get(value);
+    }
+    mesh.indices.resize(num_indices);
+    for (std::uint32_t &index: mesh.indices) {
+        reader.get(index);
+        if (index >= num_vertices) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,69 @@
+#ifndef TRIANGULATION_IO_H
+#define TRIANGULATION_IO_H
+
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include <Poly_Triangulation.hxx>
+#include "../../geom/Mesh.h"
+
+// Little helpers for the binary entries of the triangulation cache. Values are written in native byte order.
+class ByteWriter {
+public:
+    template<typename T>
+    void put(const T &value) {
+        const auto *bytes = reinterpret_cast<const char *>(&value);
+        data.insert(data.end(), bytes, bytes + sizeof(T));
+    }
+
+    std::vector<char> data;
+};
+
+class ByteReader {
+public:
+    explicit ByteReader(const std::vector<char> &data) : data_(data) {
+    }
+
+    template<typename T>
+    bool get(T &value) {
+        if (pos_ + sizeof(T) > data_.size()) {
+            return false;
+        }
+        std::memcpy(&value, data_.data() + pos_, sizeof(T));
+        pos_ += sizeof(T);
+        return true;
+    }
+
+    // Skips count bytes and returns a pointer to them, or nullptr if the data is too short
+    const char *skip(const std::size_t count) {
+        if (count > remaining()) {
+            return nullptr;
+        }
+        const char *start = data_.data() + pos_;
+        pos_ += count;
+        return start;
+    }
+
+    [[nodiscard]] std::size_t position() const { return pos_; }
+
+    [[nodiscard]] std::size_t remaining() const { return data_.size() - pos_; }
+
+private:
+    const std::vector<char> &data_;
+    std::size_t pos_ = 0;
+};
+
+// Nodes, UV nodes, normals, triangles and deflection of a triangulation. A null triangulation is written as an
+// empty record.
+void write_triangulation(ByteWriter &writer, const Handle(Poly_Triangulation) &triangulation);
+
+// Returns false for a damaged record. An empty record leaves triangulation null.
+bool read_triangulation(ByteReader &reader, Handle(Poly_Triangulation) &triangulation);
+
+// Color, positions, normals and triangle indices of a mesh
+void write_mesh(ByteWriter &writer, const Mesh &mesh);
+
+// Returns false for a damaged record
+bool read_mesh(ByteReader &reader, Mesh &mesh);
+
+#endif //TRIANGULATION_IO_H
@@ -0,0 +1,521 @@
+#include "step_subset.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+    constexpr std::size_t BLOCK_SIZE = 1 << 20;
+    constexpr std::uint32_t NONE = std::numeric_limits<std::uint32_t>::max();
+    // Set on the references of single valued attributes
+    constexpr std::uint64_t SINGLE = std::uint64_t{1} << 63;
+
+    // Splits a STEP file into statements, each up to and including the ';' that ends it outside strings and
+    // comments. Text after the last statement is returned as a statement of its own.
+    class StatementReader {
+    public:
+        explicit StatementReader(const std::filesystem::path &step_file)
+            : file_(step_file, std::ios::binary), buffer_(BLOCK_SIZE) {
+            if (!file_.is_open()) {
+                throw std::runtime_error("Error opening STEP file: " + step_file.string());
+            }
+        }
+
+        bool next(std::string &statement) {
+            statement.clear();
+            while (true) {
+                if (pos_ == end_) {
+                    file_.read(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+                    pos_ = 0;
+                    end_ = static_cast<std::size_t>(file_.gcount());
+                    if (end_ == 0) {
+                        return !statement.empty();
+                    }
+                }
+                const std::size_t begin = pos_;
+                const bool complete = scan();
+                statement.append(buffer_.data() + begin, pos_ - begin);
+                if (complete) {
+                    return true;
+                }
+            }
+        }
+
+    private:
+        enum class State { Normal, String, Comment };
+
+        // Advances pos_ through the buffer, up to and including the end of the statement if it is in the buffer.
+        // Runs of ordinary characters are skipped at once. A "/*" or "*/" split by the buffer boundary is completed
+        // at the start of the next buffer.
+        bool scan() {
+            const char *data = buffer_.data();
+            while (pos_ < end_) {
+                switch (state_) {
+                    case State::Normal: {
+                        if (pending_ && data[pos_] == '*') {
+                            state_ = State::Comment;
+                            pending_ = false;
+                            ++pos_;
+                            break;
+                        }
+                        pending_ = false;
+                        while (pos_ < end_ && !is_special(data[pos_])) {
+                            ++pos_;
+                        }
+                        if (pos_ == end_) {
+                            break;
+                        }
+                        const char c = data[pos_++];
+                        if (c == ';') {
+                            return true;
+                        }
+                        if (c == '\'') {
+                            state_ = State::String;
+                        } else if (pos_ == end_) {
+                            pending_ = true;
+                        } else if (data[pos_] == '*') {
+                            state_ = State::Comment;
+                            ++pos_;
+                        }
+                        break;
+                    }
+                    case State::String: {
+                        // An escaped quote ('') leaves the string and enters it again
+                        const auto *quote = static_cast<const char *>(std::memchr(data + pos_, '\'', end_ - pos_));
+                        pos_ = quote ? static_cast<std::size_t>(quote - data) + 1 : end_;
+                        if (quote) {
+                            state_ = State::Normal;
+                        }
+                        break;
+                    }
+                    case State::Comment: {
+                        if (pending_ && data[pos_] == '/') {
+                            state_ = State::Normal;
+                            pending_ = false;
+                            ++pos_;
+                            break;
+                        }
+                        pending_ = false;
+                        const auto *star = static_cast<const char *>(std::memchr(data + pos_, '*', end_ - pos_));
+                        pos_ = star ? static_cast<std::size_t>(star - data) + 1 : end_;
+                        if (!star) {
+                            break;
+                        }
+                        if (pos_ == end_) {
+                            pending_ = true;
+                        } else if (data[pos_] == '/') {
+                            state_ = State::Normal;
+                            ++pos_;
+                        }
+                        break;
+                    }
+                }
+            }
+            return false;
+        }
+
+        static bool is_special(const char c) {
+            return c == ';' || c == '\'' || c == '/';
+        }
+
+        std::ifstream file_;
+        std::vector<char> buffer_;
+        std::size_t pos_ = 0;
+        std::size_t end_ = 0;
+        State state_ = State::Normal;
+        // The buffer ended in the first character of "/*" (Normal) or "*/" (Comment)
+        bool pending_ = false;
+    };
+
+    // Position of the first character that is neither white space nor part of a comment
+    std::size_t skip_blank(const std::string &text, std::size_t pos) {
+        while (pos < text.size()) {
+            if (std::isspace(static_cast<unsigned char>(text[pos]))) {
+                ++pos;
+            } else if (text.compare(pos, 2, "/*") == 0) {
+                const std::size_t end = text.find("*/", pos + 2);
+                pos = end == std::string::npos ? text.size() : end + 2;
+            } else {
+                break;
+            }
+        }
+        return pos;
+    }
+
+    bool starts_with_keyword(const std::string &statement, const std::size_t pos, const std::string &keyword) {
+        if (statement.compare(pos, keyword.size(), keyword) != 0) {
+            return false;
+        }
+        const std::size_t end = pos + keyword.size();
+        return end == statement.size() || !(std::isalnum(static_cast<unsigned char>(statement[end])) ||
+                                            statement[end] == '_' || statement[end] == '-');
+    }
+
+    enum class NameKind { Record, Single, Aggregate };
+
+    // Visits the instance names (#id) of an entity record: the name of the record itself, followed by its
+    // references. A reference directly in the attribute list is single valued, deeper ones are aggregate members.
+    // Complex entities, "#1=(A() B(#2));", carry their attribute lists one level deeper. Aggregate members come with
+    // the number of their innermost aggregate in the record, counted in the order the aggregates open.
+    template<typename Visitor>
+    void visit_names(const std::string &record, Visitor &&visit) {
+        int depth = 0;
+        int attribute_depth = 1;
+        std::uint32_t num_aggregates = 0;
+        std::vector<std::uint32_t> aggregates;
+        bool in_string = false;
+        bool seen_equals = false;
+        bool seen_body = false;
+        for (std::size_t i = 0; i < record.size(); ++i) {
+            const char c = record[i];
+            if (in_string) {
+                in_string = c != '\'';
+                continue;
+            }
+            if (c == '/' && i + 1 < record.size() && record[i + 1] == '*') {
+                const std::size_t end = record.find("*/", i + 2);
+                i = end == std::string::npos ? record.size() : end + 1;
+                continue;
+            }
+            if (seen_equals && !seen_body && !std::isspace(static_cast<unsigned char>(c))) {
+                seen_body = true;
+                attribute_depth = c == '(' ? 2 : 1;
+            }
+            if (c == '\'') {
+                in_string = true;
+            } else if (c == '=') {
+                seen_equals = true;
+            } else if (c == '(') {
+                if (++depth > attribute_depth) {
+                    aggregates.push_back(num_aggregates++);
+                }
+            } else if (c == ')') {
+                if (depth-- > attribute_depth && !aggregates.empty()) {
+                    aggregates.pop_back();
+                }
+            } else if (c == '#') {
+                std::size_t end = i + 1;
+                std::uint64_t id = 0;
+                while (end < record.size() && std::isdigit(static_cast<unsigned char>(record[end]))) {
+                    id = id * 10 + static_cast<std::uint64_t>(record[end] - '0');
+                    ++end;
+                }
+                if (end == i + 1) {
+                    continue;
+                }
+                const NameKind kind = !seen_equals
+                                          ? NameKind::Record
+                                          : depth <= attribute_depth
+                                                ? NameKind::Single
+                                                : NameKind::Aggregate;
+                visit(i, end, id, kind, kind == NameKind::Aggregate && !aggregates.empty() ? aggregates.back() : NONE);
+                i = end - 1;
+            }
+        }
+    }
+
+    // Instance name of an entity record, or nothing if the statement is not one
+    bool record_name(const std::string &statement, std::uint64_t &id) {
+        std::size_t pos = skip_blank(statement, 0);
+        if (pos >= statement.size() || statement[pos] != '#') {
+            return false;
+        }
+        id = 0;
+        bool has_digits = false;
+        for (++pos; pos < statement.size() && std::isdigit(static_cast<unsigned char>(statement[pos])); ++pos) {
+            id = id * 10 + static_cast<std::uint64_t>(statement[pos] - '0');
+            has_digits = true;
+        }
+        return has_digits;
+    }
+
+    // Tracks the DATA sections of the file; entity records only occur in them
+    class SectionTracker {
+    public:
+        // Returns true if statement is an entity record
+        bool is_record(const std::string &statement, std::uint64_t &id) {
+            if (in_data_ && record_name(statement, id)) {
+                return true;
+            }
+            const std::size_t pos = skip_blank(statement, 0);
+            if (starts_with_keyword(statement, pos, "DATA")) {
+                in_data_ = true;
+            } else if (starts_with_keyword(statement, pos, "ENDSEC")) {
+                in_data_ = false;
+            }
+            return false;
+        }
+
+    private:
+        bool in_data_ = false;
+    };
+
+    struct RecordGraph {
+        std::vector<std::uint64_t> ids;
+        // Record of an instance name. Instance names are usually numbered densely, then they index a vector.
+        std::vector<std::uint32_t> dense_index;
+        std::unordered_map<std::uint64_t, std::uint32_t> sparse_index;
+        // References of record i: refs[ref_offsets[i] .. ref_offsets[i + 1]), as ids with the SINGLE flag
+        std::vector<std::size_t> ref_offsets{0};
+        std::vector<std::uint64_t> refs;
+        // Aggregate of every reference within its record, NONE for single valued ones
+        std::vector<std::uint32_t> ref_aggregates;
+
+        [[nodiscard]] std::uint32_t find(const std::uint64_t id) const {
+            if (sparse_index.empty()) {
+                return id < dense_index.size() ? dense_index[id] : NONE;
+            }
+            const auto it = sparse_index.find(id);
+            return it == sparse_index.end() ? NONE : it->second;
+        }
+
+        void build_index(const std::filesystem::path &step_file) {
+            std::uint64_t max_id = 0;
+            for (const auto id: ids) {
+                max_id = std::max(max_id, id);
+            }
+            bool unique = true;
+            if (max_id <= 4 * ids.size() + 1024) {
+                dense_index.assign(max_id + 1, NONE);
+                for (std::uint32_t i = 0; i < ids.size() && unique; ++i) {
+                    unique = dense_index[ids[i]] == NONE;
+                    dense_index[ids[i]] = i;
+                }
+            } else {
+                for (std::uint32_t i = 0; i < ids.size() && unique; ++i) {
+                    unique = sparse_index.emplace(ids[i], i).second;
+                }
+            }
+            if (!unique) {
+                throw std::runtime_error("Duplicate entity instance name in " + step_file.string());
+            }
+        }
+    };
+
+    RecordGraph read_graph(const std::filesystem::path &step_file) {
+        RecordGraph graph;
+        StatementReader reader(step_file);
+        SectionTracker sections;
+        std::string statement;
+        std::uint64_t id = 0;
+        while (reader.next(statement)) {
+            if (!sections.is_record(statement, id)) {
+                continue;
+            }
+            graph.ids.push_back(id);
+            visit_names(statement, [&](std::size_t, std::size_t, const std::uint64_t ref, const NameKind kind,
+                                       const std::uint32_t aggregate) {
+                if (kind != NameKind::Record) {
+                    graph.refs.push_back(kind == NameKind::Single ? ref | SINGLE : ref);
+                    graph.ref_aggregates.push_back(aggregate);
+                }
+            });
+            graph.ref_offsets.push_back(graph.refs.size());
+        }
+        graph.build_index(step_file);
+        return graph;
+    }
+
+    // Marks the records that are written: everything reachable from the unreferenced records without passing
+    // through an excluded one
+    std::vector<bool> select_records(const RecordGraph &graph, const std::unordered_set<std::uint64_t> &excluded_ids) {
+        const std::size_t count = graph.ids.size();
+        std::vector<std::uint32_t> targets(graph.refs.size());
+        for (std::size_t r = 0; r < graph.refs.size(); ++r) {
+            targets[r] = graph.find(graph.refs[r] & ~SINGLE);
+        }
+
+        // Incoming references per record, as (referrer, reference)
+        std::vector<std::size_t> in_offsets(count + 1, 0);
+        for (const auto target: targets) {
+            if (target != NONE) {
+                ++in_offsets[target + 1];
+            }
+        }
+        for (std::size_t i = 0; i < count; ++i) {
+            in_offsets[i + 1] += in_offsets[i];
+        }
+        std::vector<std::pair<std::uint32_t, std::size_t> > incoming(in_offsets[count]);
+        {
+            std::vector<std::size_t> fill(in_offsets.begin(), in_offsets.end() - 1);
+            for (std::uint32_t i = 0; i < count; ++i) {
+                for (std::size_t r = graph.ref_offsets[i]; r < graph.ref_offsets[i + 1]; ++r) {
+                    if (targets[r] != NONE) {
+                        incoming[fill[targets[r]]++] = {i, r};
+                    }
+                }
+            }
+        }
+
+        // Members left in every aggregate that holds references. An aggregate that loses all of them would be written
+        // empty, "()", which the schema does not allow where the source had members.
+        std::vector<std::size_t> slots(graph.refs.size(), 0);
+        std::vector<std::uint32_t> members;
+        const auto loses_last_member = [&](const std::size_t r) {
+            return graph.ref_aggregates[r] != NONE && --members[slots[r]] == 0;
+        };
+        for (std::uint32_t i = 0; i < count; ++i) {
+            const std::size_t base = members.size();
+            for (std::size_t r = graph.ref_offsets[i]; r < graph.ref_offsets[i + 1]; ++r) {
+                if (graph.ref_aggregates[r] == NONE) {
+                    continue;
+                }
+                slots[r] = base + graph.ref_aggregates[r];
+                if (members.size() <= slots[r]) {
+                    members.resize(slots[r] + 1, 0);
+                }
+                if (targets[r] != NONE) {
+                    ++members[slots[r]];
+                }
+            }
+        }
+
+        // Exclusion spreads to the records that cannot do without an excluded one: through single valued
+        // references, and through aggregates that lose their last member. Undefined references are treated as
+        // excluded.
+        std::vector<bool> excluded(count, false);
+        std::vector<std::uint32_t> queue;
+        for (std::uint32_t i = 0; i < count; ++i) {
+            bool exclude = excluded_ids.count(graph.ids[i]) > 0;
+            for (std::size_t r = graph.ref_offsets[i]; r < graph.ref_offsets[i + 1] && !exclude; ++r) {
+                exclude = targets[r] == NONE && ((graph.refs[r] & SINGLE) != 0 ||
+                                                 (graph.ref_aggregates[r] != NONE && members[slots[r]] == 0));
+            }
+            if (exclude) {
+                excluded[i] = true;
+                queue.push_back(i);
+            }
+        }
+        while (!queue.empty()) {
+            const std::uint32_t i = queue.back();
+            queue.pop_back();
+            for (std::size_t k = in_offsets[i]; k < in_offsets[i + 1]; ++k) {
+                const auto [referrer, r] = incoming[k];
+                if (excluded[referrer]) {
+                    continue;
+                }
+                if ((graph.refs[r] & SINGLE) != 0 || loses_last_member(r)) {
+                    excluded[referrer] = true;
+                    queue.push_back(referrer);
+                }
+            }
+        }
+
+        std::vector<bool> selected(count, false);
+        for (std::uint32_t i = 0; i < count; ++i) {
+            if (in_offsets[i] == in_offsets[i + 1] && !excluded[i]) {
+                selected[i] = true;
+                queue.push_back(i);
+            }
+        }
+        while (!queue.empty()) {
+            const std::uint32_t i = queue.back();
+            queue.pop_back();
+            for (std::size_t r = graph.ref_offsets[i]; r < graph.ref_offsets[i + 1]; ++r) {
+                const std::uint32_t target = targets[r];
+                if (target != NONE && !excluded[target] && !selected[target]) {
+                    selected[target] = true;
+                    queue.push_back(target);
+                }
+            }
+        }
+        return selected;
+    }
+
+    // Copies a record with its instance names renumbered. References to records that are not written only occur in
+    // aggregates and are removed together with their separator.
+    void rewrite_record(const std::string &record, const RecordGraph &graph,
+                        const std::vector<std::uint32_t> &new_ids, std::string &out) {
+        std::size_t copied = 0;
+        bool skip_separator = false;
+        const auto copy_until = [&](const std::size_t end) {
+            std::size_t begin = copied;
+            if (skip_separator) {
+                begin = skip_blank(record, begin);
+                if (begin < end && record[begin] == ',') {
+                    ++begin;
+                }
+                skip_separator = false;
+            }
+            if (begin < end) {
+                out.append(record, begin, end - begin);
+            }
+        };
+        visit_names(record, [&](const std::size_t begin, const std::size_t end, const std::uint64_t id, NameKind,
+                                std::uint32_t) {
+            copy_until(begin);
+            copied = end;
+            const std::uint32_t index = graph.find(id);
+            const std::uint32_t new_id = index == NONE ? NONE : new_ids[index];
+            if (new_id != NONE) {
+                char digits[16];
+                digits[0] = '#';
+                const auto result = std::to_chars(digits + 1, digits + sizeof(digits), new_id);
+                out.append(digits, result.ptr);
+                return;
+            }
+            while (!out.empty() && std::isspace(static_cast<unsigned char>(out.back()))) {
+                out.pop_back();
+            }
+            if (!out.empty() && out.back() == ',') {
+                out.pop_back();
+            } else {
+                skip_separator = true;
+            }
+        });
+        copy_until(record.size());
+    }
+}
+
+StepSubsetReport write_step_subset(const std::filesystem::path &step_file, const std::filesystem::path &subset_file,
+                                   const std::unordered_set<std::uint64_t> &excluded) {
+    const RecordGraph graph = read_graph(step_file);
+    const std::vector<bool> selected = select_records(graph, excluded);
+
+    StepSubsetReport report;
+    report.records_read = graph.ids.size();
+    std::vector<std::uint32_t> new_ids(graph.ids.size(), NONE);
+    for (std::size_t i = 0; i < graph.ids.size(); ++i) {
+        if (selected[i]) {
+            new_ids[i] = static_cast<std::uint32_t>(++report.records_written);
+        }
+    }
+
+    if (const std::filesystem::path dir = subset_file.parent_path(); !dir.empty() && !exists(dir)) {
+        create_directories(dir);
+    }
+    std::ofstream file(subset_file, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("Error opening STEP file for writing: " + subset_file.string());
+    }
+
+    // Everything but the entity records is copied as it is
+    StatementReader reader(step_file);
+    SectionTracker sections;
+    std::string statement;
+    std::string out;
+    std::uint64_t id = 0;
+    while (reader.next(statement)) {
+        if (!sections.is_record(statement, id)) {
+            out += statement;
+        } else if (new_ids[graph.find(id)] != NONE) {
+            rewrite_record(statement, graph, new_ids, out);
+        }
+        if (out.size() >= BLOCK_SIZE) {
+            file.write(out.data(), static_cast<std::streamsize>(out.size()));
+            out.clear();
+        }
+    }
+    file.write(out.data(), static_cast<std::streamsize>(out.size()));
+    if (!file) {
+        throw std::runtime_error("Error writing STEP file: " + subset_file.string());
+    }
+    return report;
+}
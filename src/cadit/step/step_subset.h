@@ -0,0 +1,25 @@
+#ifndef STEP_SUBSET_H
+#define STEP_SUBSET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <unordered_set>
+
+struct StepSubsetReport {
+    std::size_t records_read = 0;
+    std::size_t records_written = 0;
+};
+
+// Writes the part of a STEP (ISO 10303-21) file that remains without the excluded entities, given by their
+// instance names (#id) in step_file.
+//
+// The records are copied byte for byte from the source, only the instance names are renumbered. A record that refers
+// to an excluded entity through a single valued attribute is excluded as well; references inside aggregates are
+// removed from the aggregate, and a record one of whose aggregates loses all its members is excluded too. The output
+// is the closure of the records nothing refers to, so entities that were only used by excluded records are dropped
+// with them. Both files are streamed, the source is read twice.
+StepSubsetReport write_step_subset(const std::filesystem::path &step_file, const std::filesystem::path &subset_file,
+                                   const std::unordered_set<std::uint64_t> &excluded);
+
+#endif //STEP_SUBSET_H
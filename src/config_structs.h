@@ -7,6 +7,7 @@
 
 #include <vector>
 #include <filesystem>
+#include <string>
 
 struct BuildConfig {
     bool build_bspline_surf;
@@ -22,12 +23,69 @@ struct GlobalConfig {
     double linearDeflection;
     double angularDeflection;
     bool relativeDeflection;
+    // Per shape linear deflection as a fraction of the shape's bounding box diagonal (0 = off)
+    double autoDeflection;
+    // Mesh planes, cylinders, cones, spheres and tori with closed-form generators before falling back to BRepMesh
+    bool analyticFastPath;
 
     // Debug parameters
     bool solidOnly;
     int max_geometry_num;
     int tessellation_timout;
 
+    // Parallelism (0 = all hardware threads)
+    int num_threads;
+
+    // On-disk triangulation cache. An empty directory disables it.
+    std::filesystem::path cacheDir;
+    int cacheMaxMb;
+
+    // Reuse the meshes of unchanged product subtrees from the triangulation cache (debug path only)
+    bool incremental;
+
+    // Recorded tessellation timings used to predict the meshing time of each shape (empty = built-in estimate)
+    std::filesystem::path costModelFile;
+
+    // Levels of detail written with MSFT_lod. Linear deflections ordered from fine to coarse and
+    // the screen coverage at which each level is replaced by the next. Empty disables LOD output.
+    std::vector<double> lod_deflections;
+    std::vector<double> lod_screen_coverage;
+
+    // Upper limit of the rendered triangles (instances included). Meshes are decimated to fit. 0 disables.
+    std::size_t maxTriangles;
+
+    // Weld and reorder the meshes for vertex cache, overdraw and vertex fetch efficiency before writing
+    bool optimizeMeshes;
+
+    // Write the GLB buffers with EXT_meshopt_compression
+    bool meshoptCompression;
+
+    // Write positions as 16-bit and normals as 8- or 16-bit normalized integers (KHR_mesh_quantization)
+    bool quantize;
+    int normalBits;
+
+    // Merge the meshes of the same material into one primitive each, with per-product triangle ranges
+    bool batchMeshes;
+
+    // Write a 3D Tiles tileset (<glb stem>-tiles/tileset.json and one GLB per octree tile) instead of a single GLB
+    bool tiles;
+    std::size_t tileTriangles;
+
+    // Write a BVH of the world bounds of the mesh nodes next to the GLB (<glb stem>-bvh.bin)
+    bool bvhSidecar;
+
+    // Largest GLB buffer in MB before the geometry is spilled to external .bin files (0 = the 4 GB GLB limit)
+    double maxBufferMb;
+
+    // Debug mode GLB writer: "direct" from the product tree and the meshes, "xcaf" through the XCAF document and
+    // RWGltf, or "both" to time them against each other
+    std::string glbWriter;
+    // Write the converted shapes to <glb>-debug.stp in debug mode
+    bool debugStep;
+
+    // Chrome trace-event JSON of the conversion stages and of every shape per thread (empty = off)
+    std::filesystem::path traceFile;
+
     std::vector<std::string> filter_names_include;
     std::vector<std::string> filter_names_exclude;
 
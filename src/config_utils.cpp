@@ -51,6 +51,59 @@ std::vector<std::string> process_filter_names(const std::string& input, const st
     return filter_names;
 }
 
+// Helper function to parse a comma separated list of numbers
+std::vector<double> process_number_list(const std::string& input, const std::string& option_name)
+{
+    std::vector<double> values;
+    for (const auto& token : split(strip_quotes(input), ','))
+    {
+        if (token.empty())
+            continue;
+        try
+        {
+            values.push_back(std::stod(token));
+        }
+        catch (const std::exception&)
+        {
+            throw std::invalid_argument("Invalid value \"" + token + "\" in " + option_name);
+        }
+    }
+    return values;
+}
+
+// Validates the LOD deflections and derives the default screen coverage of each level
+void process_lods(std::vector<double>& deflections, std::vector<double>& screen_coverage)
+{
+    if (deflections.empty())
+    {
+        if (!screen_coverage.empty())
+            throw std::invalid_argument("--lod-coverage requires --lods");
+        return;
+    }
+    for (std::size_t i = 0; i < deflections.size(); ++i)
+    {
+        if (deflections[i] <= 0.0)
+            throw std::invalid_argument("--lods deflections must be positive");
+        if (i > 0 && deflections[i] <= deflections[i - 1])
+            throw std::invalid_argument("--lods deflections must be ordered from fine to coarse");
+    }
+
+    if (screen_coverage.empty())
+    {
+        // A level that is n times coarser gives the same on-screen error at 1/n of the screen size
+        for (const double deflection : deflections)
+            screen_coverage.push_back(0.5 * deflections.front() / deflection);
+        return;
+    }
+    if (screen_coverage.size() != deflections.size())
+        throw std::invalid_argument("--lod-coverage needs one value per --lods deflection");
+    for (std::size_t i = 1; i < screen_coverage.size(); ++i)
+    {
+        if (screen_coverage[i] >= screen_coverage[i - 1])
+            throw std::invalid_argument("--lod-coverage values must be decreasing");
+    }
+}
+
 // Helper function to check if a string ends with a specific suffix (case insensitive)
 bool endsWithCaseInsensitive(const std::string& str, const std::string& suffix) {
     if (str.size() < suffix.size()) {
@@ -79,6 +132,71 @@ GlobalConfig process_parameters(CLI::App& app)
     const auto filter_names_include = process_filter_names(filter_names_include_input, filter_names_file_include);
     const auto filter_names_exclude = process_filter_names(filter_names_exclude_input, filter_names_file_exclude);
 
+    auto lod_deflections = process_number_list(app.get_option("--lods")->as<std::string>(), "--lods");
+    auto lod_screen_coverage = process_number_list(app.get_option("--lod-coverage")->as<std::string>(), "--lod-coverage");
+    process_lods(lod_deflections, lod_screen_coverage);
+
+    // Skipping unchanged products needs them transferred one by one, which only the debug path does
+    const bool incremental = app.get_option("--incremental")->as<bool>();
+    const bool debug_mode = app.get_option("--debug")->as<bool>();
+    if (incremental && !debug_mode) {
+        throw std::invalid_argument("--incremental requires --debug, the default conversion transfers the whole model at once");
+    }
+    if (!lod_deflections.empty() && debug_mode) {
+        std::cout << "Warning: --lods is not supported in debug mode and will be ignored.\n";
+    }
+
+    // Per shape deflection as a fraction of the size
+    const double auto_deflection = app.get_option("--auto-defl")->as<double>();
+    const auto max_triangles = app.get_option("--max-triangles")->as<std::size_t>();
+    if (max_triangles > 0 && !lod_deflections.empty()) {
+        std::cout << "Warning: --max-triangles is ignored when --lods is given.\n";
+    }
+    if (max_triangles > 0 && debug_mode) {
+        std::cout << "Warning: --max-triangles is not supported in debug mode and will be ignored.\n";
+    }
+    const bool optimize_meshes = app.get_option("--optimize-mesh")->as<bool>();
+    if (optimize_meshes && debug_mode) {
+        std::cout << "Warning: --optimize-mesh is not supported in debug mode and will be ignored.\n";
+    }
+    const bool meshopt_compression = app.get_option("--compression")->as<std::string>() == "meshopt";
+    if (meshopt_compression && debug_mode) {
+        std::cout << "Warning: --compression is not supported in debug mode and will be ignored.\n";
+    }
+    const bool quantize = app.get_option("--quantize")->as<bool>();
+    if (quantize && debug_mode) {
+        std::cout << "Warning: --quantize is not supported in debug mode and will be ignored.\n";
+    }
+    const bool batch_meshes = app.get_option("--batch")->as<bool>();
+    if (batch_meshes && debug_mode) {
+        std::cout << "Warning: --batch is not supported in debug mode and will be ignored.\n";
+    }
+    if (batch_meshes && !lod_deflections.empty()) {
+        std::cout << "Warning: --batch writes the finest level of detail only.\n";
+    }
+    const bool tiles = app.get_option("--tiles")->as<bool>();
+    if (tiles && debug_mode) {
+        std::cout << "Warning: --tiles is not supported in debug mode and will be ignored.\n";
+    }
+    if (tiles && batch_meshes) {
+        std::cout << "Warning: --batch is ignored when --tiles is given.\n";
+    }
+    const bool bvh_sidecar = app.get_option("--bvh")->as<bool>();
+    if (bvh_sidecar && debug_mode) {
+        std::cout << "Warning: --bvh is not supported in debug mode and will be ignored.\n";
+    }
+    const double max_buffer_mb = app.get_option("--max-buffer-mb")->as<double>();
+    const auto glb_writer = app.get_option("--glb-writer")->as<std::string>();
+    if (max_buffer_mb > 0.0 && debug_mode && glb_writer != "direct") {
+        std::cout << "Warning: --max-buffer-mb is not supported by the xcaf GLB writer and will be ignored for its output.\n";
+    }
+    if (glb_writer != "direct" && !debug_mode) {
+        std::cout << "Warning: --glb-writer is only supported in debug mode and will be ignored.\n";
+    }
+    if (auto_deflection > 0.0 && !lod_deflections.empty()) {
+        std::cout << "Warning: --auto-defl is ignored when --lods is given.\n";
+    }
+
     const std::string stpFilename = app.get_option("--stp")->results()[0];
     const std::string glbFilename = app.get_option("--glb")->results()[0];
 
@@ -104,17 +222,45 @@ GlobalConfig process_parameters(CLI::App& app)
         throw std::invalid_argument("Invalid --glb filename. It must end with .glb.");
     }
 
+    // The incremental meshes are kept in the triangulation cache, next to the GLB unless a cache is given
+    std::filesystem::path cache_dir = app.get_option("--cache-dir")->as<std::string>();
+    if (incremental && cache_dir.empty()) {
+        cache_dir = glbFilePath.parent_path() / glbFilePath.stem().concat("-cache");
+    }
+
     // Create configuration
     return {
         .stpFile = stpFilename,
         .glbFile = glbFilename,
-        .debug_mode = app.get_option("--debug")->as<bool>(),
+        .debug_mode = debug_mode,
         .linearDeflection = app.get_option("--lin-defl")->as<double>(),
         .angularDeflection = app.get_option("--ang-defl")->as<double>(),
         .relativeDeflection = app.get_option("--rel-defl")->as<bool>(),
+        .autoDeflection = auto_deflection,
+        .analyticFastPath = app.get_option("--analytic-mesh")->as<bool>(),
         .solidOnly = app.get_option("--solid-only")->as<bool>(),
         .max_geometry_num = app.get_option("--max-geometry-num")->as<int>(),
         .tessellation_timout = app.get_option("--tessellation-timeout")->as<int>(),
+        .num_threads = app.get_option("--num-threads")->as<int>(),
+        .cacheDir = cache_dir,
+        .cacheMaxMb = app.get_option("--cache-max-mb")->as<int>(),
+        .incremental = incremental,
+        .costModelFile = app.get_option("--cost-model")->as<std::string>(),
+        .lod_deflections = lod_deflections,
+        .lod_screen_coverage = lod_screen_coverage,
+        .maxTriangles = max_triangles,
+        .optimizeMeshes = optimize_meshes,
+        .meshoptCompression = meshopt_compression,
+        .quantize = quantize,
+        .normalBits = app.get_option("--normal-bits")->as<int>(),
+        .batchMeshes = batch_meshes,
+        .tiles = tiles,
+        .tileTriangles = app.get_option("--tile-triangles")->as<std::size_t>(),
+        .bvhSidecar = bvh_sidecar,
+        .maxBufferMb = max_buffer_mb,
+        .glbWriter = glb_writer,
+        .debugStep = !app.get_option("--no-debug-step")->as<bool>(),
+        .traceFile = app.get_option("--trace")->as<std::string>(),
         .filter_names_include = filter_names_include,
         .filter_names_exclude = filter_names_exclude,
         .buildConfig = {
@@ -9,8 +9,6 @@
 #include "GroupReference.h"
 #include "Color.h"
 
-Color::Color(float r, float g, float b, float a) : r(r), g(g), b(b), a(a) {}
-
 MeshType from_int(int value) {
     if (value < 0 || value > 6) {
         throw std::out_of_range("Invalid MeshType value");
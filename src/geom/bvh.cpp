@@ -0,0 +1,151 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+namespace {
+    constexpr int NUM_BINS = 16;
+
+    Aabb empty_box() {
+        constexpr float inf = std::numeric_limits<float>::max();
+        return {{inf, inf, inf}, {-inf, -inf, -inf}};
+    }
+
+    void expand(Aabb &box, const Aabb &other) {
+        for (int k = 0; k < 3; ++k) {
+            box.min[k] = std::min(box.min[k], other.min[k]);
+            box.max[k] = std::max(box.max[k], other.max[k]);
+        }
+    }
+
+    float surface_area(const Aabb &box) {
+        const float dx = std::max(0.0f, box.max[0] - box.min[0]);
+        const float dy = std::max(0.0f, box.max[1] - box.min[1]);
+        const float dz = std::max(0.0f, box.max[2] - box.min[2]);
+        return 2.0f * (dx * dy + dy * dz + dz * dx);
+    }
+
+    float centroid(const Aabb &box, const int axis) {
+        return 0.5f * (box.min[axis] + box.max[axis]);
+    }
+
+    class BvhBuilder {
+    public:
+        BvhBuilder(const std::vector<Aabb> &boxes, const std::size_t max_leaf_size, Bvh &bvh)
+            : boxes_(boxes), max_leaf_size_(std::max<std::size_t>(1, max_leaf_size)), bvh_(bvh) {
+        }
+
+        // Builds the subtree of items [begin, end) and returns its node index
+        std::uint32_t build(const std::size_t begin, const std::size_t end) {
+            const auto index = static_cast<std::uint32_t>(bvh_.nodes.size());
+            bvh_.nodes.push_back({});
+
+            Aabb bounds = empty_box();
+            Aabb centroids = empty_box();
+            for (std::size_t i = begin; i < end; ++i) {
+                const Aabb &box = boxes_[bvh_.items[i]];
+                expand(bounds, box);
+                for (int k = 0; k < 3; ++k) {
+                    centroids.min[k] = std::min(centroids.min[k], centroid(box, k));
+                    centroids.max[k] = std::max(centroids.max[k], centroid(box, k));
+                }
+            }
+            bvh_.nodes[index].bounds = bounds;
+
+            const std::size_t count = end - begin;
+            const std::size_t middle = count > max_leaf_size_ ? split(begin, end, centroids) : begin;
+            if (middle == begin) {
+                bvh_.nodes[index].offset = static_cast<std::uint32_t>(begin);
+                bvh_.nodes[index].count = static_cast<std::uint32_t>(count);
+                return index;
+            }
+
+            build(begin, middle);
+            const std::uint32_t right = build(middle, end);
+            bvh_.nodes[index].offset = right;
+            bvh_.nodes[index].count = 0;
+            return index;
+        }
+
+    private:
+        // Partitions the items by the cheapest binned SAH split and returns the first item of the right half
+        std::size_t split(const std::size_t begin, const std::size_t end, const Aabb &centroids) {
+            int axis = 0;
+            for (int k = 1; k < 3; ++k) {
+                if (centroids.max[k] - centroids.min[k] > centroids.max[axis] - centroids.min[axis]) {
+                    axis = k;
+                }
+            }
+            const float lo = centroids.min[axis];
+            const float extent = centroids.max[axis] - lo;
+            const std::size_t count = end - begin;
+            if (extent <= 0.0f) {
+                // Coincident centroids cannot be separated spatially, so the items are simply halved
+                return begin + count / 2;
+            }
+
+            const auto bin_of = [&](const std::uint32_t item) {
+                const int bin = static_cast<int>(NUM_BINS * (centroid(boxes_[item], axis) - lo) / extent);
+                return std::clamp(bin, 0, NUM_BINS - 1);
+            };
+
+            std::array<Aabb, NUM_BINS> bin_bounds;
+            std::array<std::size_t, NUM_BINS> bin_counts{};
+            bin_bounds.fill(empty_box());
+            for (std::size_t i = begin; i < end; ++i) {
+                const int bin = bin_of(bvh_.items[i]);
+                expand(bin_bounds[bin], boxes_[bvh_.items[i]]);
+                ++bin_counts[bin];
+            }
+
+            // Sweep from the right for the right hand areas, then from the left to evaluate every split
+            std::array<float, NUM_BINS> right_cost{};
+            Aabb right = empty_box();
+            std::size_t right_count = 0;
+            for (int bin = NUM_BINS - 1; bin > 0; --bin) {
+                expand(right, bin_bounds[bin]);
+                right_count += bin_counts[bin];
+                right_cost[bin] = right_count > 0 ? surface_area(right) * static_cast<float>(right_count) : 0.0f;
+            }
+            Aabb left = empty_box();
+            std::size_t left_count = 0;
+            float best_cost = std::numeric_limits<float>::max();
+            int best_bin = -1;
+            for (int bin = 1; bin < NUM_BINS; ++bin) {
+                expand(left, bin_bounds[bin - 1]);
+                left_count += bin_counts[bin - 1];
+                if (left_count == 0 || left_count == count) {
+                    continue;
+                }
+                const float cost = surface_area(left) * static_cast<float>(left_count) + right_cost[bin];
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_bin = bin;
+                }
+            }
+
+            // The lowest and the highest centroid fall into the first and the last bin, so a split always exists
+            const auto middle = std::partition(bvh_.items.begin() + static_cast<std::ptrdiff_t>(begin),
+                                               bvh_.items.begin() + static_cast<std::ptrdiff_t>(end),
+                                               [&](const std::uint32_t item) { return bin_of(item) < best_bin; });
+            return static_cast<std::size_t>(middle - bvh_.items.begin());
+        }
+
+        const std::vector<Aabb> &boxes_;
+        std::size_t max_leaf_size_;
+        Bvh &bvh_;
+    };
+}
+
+Bvh build_bvh(const std::vector<Aabb> &boxes, const std::size_t max_leaf_size) {
+    Bvh bvh;
+    if (boxes.empty()) {
+        return bvh;
+    }
+    bvh.items.resize(boxes.size());
+    std::iota(bvh.items.begin(), bvh.items.end(), 0u);
+    bvh.nodes.reserve(2 * boxes.size());
+    BvhBuilder(boxes, max_leaf_size, bvh).build(0, boxes.size());
+    return bvh;
+}
@@ -0,0 +1,31 @@
+#ifndef NANO_OCCT_BVH_H
+#define NANO_OCCT_BVH_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct Aabb {
+    std::array<float, 3> min;
+    std::array<float, 3> max;
+};
+
+// Node of a flattened BVH. Leaves (count > 0) hold items [offset, offset + count) of Bvh::items. The left child
+// of an inner node (count == 0) directly follows it, offset is the index of the right child.
+struct BvhNode {
+    Aabb bounds;
+    std::uint32_t offset;
+    std::uint32_t count;
+};
+
+struct Bvh {
+    std::vector<BvhNode> nodes;
+    // Indices of the input boxes in leaf order
+    std::vector<std::uint32_t> items;
+};
+
+// Builds a bounding volume hierarchy over boxes with the binned surface area heuristic
+Bvh build_bvh(const std::vector<Aabb> &boxes, std::size_t max_leaf_size = 4);
+
+#endif //NANO_OCCT_BVH_H
@@ -0,0 +1,472 @@
+#include "decimation.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <numbers>
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+    using Vec3 = std::array<double, 3>;
+    using Triangle = std::array<std::uint32_t, 3>;
+
+    const double CREASE_COS = std::cos(std::numbers::pi / 4.0);
+    // Weight of the planes that keep boundaries and creases in place, relative to a triangle plane
+    constexpr double CONSTRAINT_WEIGHT = 100.0;
+    // A collapse may not turn a triangle by more than about 80 degrees
+    constexpr double MIN_NORMAL_DOT = 0.2;
+
+    Vec3 sub(const Vec3 &a, const Vec3 &b) { return {a[0] - b[0], a[1] - b[1], a[2] - b[2]}; }
+
+    Vec3 cross(const Vec3 &a, const Vec3 &b) {
+        return {a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]};
+    }
+
+    double dot(const Vec3 &a, const Vec3 &b) { return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]; }
+
+    Vec3 normalized(const Vec3 &v) {
+        const double length = std::sqrt(dot(v, v));
+        return length > 0.0 ? Vec3{v[0] / length, v[1] / length, v[2] / length} : Vec3{0.0, 0.0, 0.0};
+    }
+
+    // Symmetric 4x4 matrix of the squared distance to a set of planes: a2 ab ac ad b2 bc bd c2 cd d2
+    using Quadric = std::array<double, 10>;
+
+    Quadric plane_quadric(const Vec3 &n, const double d, const double weight) {
+        return {
+            weight * n[0] * n[0], weight * n[0] * n[1], weight * n[0] * n[2], weight * n[0] * d,
+            weight * n[1] * n[1], weight * n[1] * n[2], weight * n[1] * d,
+            weight * n[2] * n[2], weight * n[2] * d,
+            weight * d * d
+        };
+    }
+
+    void add_to(Quadric &q, const Quadric &other) {
+        for (std::size_t i = 0; i < q.size(); ++i) {
+            q[i] += other[i];
+        }
+    }
+
+    Quadric sum(const Quadric &a, const Quadric &b) {
+        Quadric q = a;
+        add_to(q, b);
+        return q;
+    }
+
+    double evaluate(const Quadric &q, const Vec3 &v) {
+        const double x = v[0], y = v[1], z = v[2];
+        return q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x
+               + q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y
+               + q[7] * z * z + 2 * q[8] * z
+               + q[9];
+    }
+
+    // Position minimizing the quadric, if it is well defined
+    bool optimal_position(const Quadric &q, Vec3 &v) {
+        const double a = q[0], b = q[1], c = q[2], d = q[4], e = q[5], f = q[7];
+        const double det = a * (d * f - e * e) - b * (b * f - c * e) + c * (b * e - c * d);
+        if (std::abs(det) < 1e-12 * std::max({a * a * a, d * d * d, f * f * f, 1e-300})) {
+            return false;
+        }
+        const Vec3 rhs = {-q[3], -q[6], -q[8]};
+        // Cramer's rule
+        v[0] = (rhs[0] * (d * f - e * e) - b * (rhs[1] * f - e * rhs[2]) + c * (rhs[1] * e - d * rhs[2])) / det;
+        v[1] = (a * (rhs[1] * f - e * rhs[2]) - rhs[0] * (b * f - c * e) + c * (b * rhs[2] - rhs[1] * c)) / det;
+        v[2] = (a * (d * rhs[2] - rhs[1] * e) - b * (b * rhs[2] - rhs[1] * c) + rhs[0] * (b * e - c * d)) / det;
+        return std::isfinite(v[0]) && std::isfinite(v[1]) && std::isfinite(v[2]);
+    }
+
+    std::uint64_t edge_key(std::uint32_t a, std::uint32_t b) {
+        if (a > b) {
+            std::swap(a, b);
+        }
+        return static_cast<std::uint64_t>(a) << 32 | b;
+    }
+
+    struct PositionHash {
+        std::size_t operator()(const std::array<float, 3> &p) const {
+            std::uint32_t bits[3];
+            std::memcpy(bits, p.data(), sizeof(bits));
+            std::size_t h = bits[0];
+            h = h * 0x9E3779B97F4A7C15ULL ^ bits[1];
+            h = h * 0x9E3779B97F4A7C15ULL ^ bits[2];
+            return h;
+        }
+    };
+
+    struct Collapse {
+        double cost;
+        std::uint32_t a;
+        std::uint32_t b;
+        std::uint32_t stamp_a;
+        std::uint32_t stamp_b;
+        Vec3 position;
+
+        bool operator>(const Collapse &other) const { return cost > other.cost; }
+    };
+
+    class Decimator {
+    public:
+        explicit Decimator(const Mesh &mesh) {
+            // Weld by position, the faces of a shape share the nodes of their common edges
+            std::unordered_map<std::array<float, 3>, std::uint32_t, PositionHash> welded;
+            std::vector<std::uint32_t> remap(mesh.positions.size() / 3);
+            for (std::size_t i = 0; i < remap.size(); ++i) {
+                const std::array<float, 3> p = {mesh.positions[3 * i], mesh.positions[3 * i + 1],
+                                                mesh.positions[3 * i + 2]};
+                auto [it, inserted] = welded.try_emplace(p, static_cast<std::uint32_t>(positions_.size()));
+                if (inserted) {
+                    positions_.push_back({p[0], p[1], p[2]});
+                }
+                remap[i] = it->second;
+            }
+            for (std::size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+                const Triangle t = {remap[mesh.indices[i]], remap[mesh.indices[i + 1]], remap[mesh.indices[i + 2]]};
+                if (t[0] != t[1] && t[1] != t[2] && t[0] != t[2]) {
+                    triangles_.push_back(t);
+                }
+            }
+            live_triangles_ = triangles_.size();
+            removed_.assign(triangles_.size(), false);
+            vertex_triangles_.resize(positions_.size());
+            for (std::uint32_t t = 0; t < triangles_.size(); ++t) {
+                for (const std::uint32_t v: triangles_[t]) {
+                    vertex_triangles_[v].push_back(t);
+                }
+            }
+            alive_.assign(positions_.size(), true);
+            stamps_.assign(positions_.size(), 0);
+            build_quadrics();
+        }
+
+        double run(const std::size_t target) {
+            std::unordered_set<std::uint64_t> edges;
+            for (const auto &t: triangles_) {
+                for (int k = 0; k < 3; ++k) {
+                    if (edges.insert(edge_key(t[k], t[(k + 1) % 3])).second) {
+                        push(t[k], t[(k + 1) % 3]);
+                    }
+                }
+            }
+
+            double max_error = 0.0;
+            while (live_triangles_ > target && !heap_.empty()) {
+                const Collapse collapse = heap_.top();
+                heap_.pop();
+                if (!alive_[collapse.a] || !alive_[collapse.b] || stamps_[collapse.a] != collapse.stamp_a ||
+                    stamps_[collapse.b] != collapse.stamp_b) {
+                    continue;
+                }
+                if (!is_valid(collapse.a, collapse.b, collapse.position)) {
+                    continue;
+                }
+                const double error = evaluate(sum(face_quadrics_[collapse.a], face_quadrics_[collapse.b]),
+                                              collapse.position);
+                max_error = std::max(max_error, std::sqrt(std::max(0.0, error)));
+                apply(collapse.a, collapse.b, collapse.position);
+            }
+            return max_error;
+        }
+
+        // Writes the remaining triangles with normals averaged over smooth neighbourhoods and split at creases
+        void write(Mesh &mesh) const {
+            std::vector<Vec3> triangle_normals(triangles_.size());
+            for (std::uint32_t t = 0; t < triangles_.size(); ++t) {
+                if (!removed_[t]) {
+                    triangle_normals[t] = normal(triangles_[t]);
+                }
+            }
+
+            std::vector<float> positions;
+            std::vector<float> normals;
+            std::vector<std::array<std::uint32_t, 3>> corners(triangles_.size());
+            struct Cluster {
+                Vec3 normal;
+                std::uint32_t index;
+            };
+            for (std::uint32_t v = 0; v < positions_.size(); ++v) {
+                if (!alive_[v]) {
+                    continue;
+                }
+                std::vector<Cluster> clusters;
+                std::vector<std::pair<std::uint32_t, std::size_t> > members;
+                for (const std::uint32_t t: vertex_triangles_[v]) {
+                    if (removed_[t]) {
+                        continue;
+                    }
+                    const Vec3 n = normalized(triangle_normals[t]);
+                    std::size_t c = 0;
+                    while (c < clusters.size() && dot(normalized(clusters[c].normal), n) < CREASE_COS) {
+                        ++c;
+                    }
+                    if (c == clusters.size()) {
+                        clusters.push_back({{0.0, 0.0, 0.0}, 0});
+                    }
+                    // Area weighted
+                    for (int k = 0; k < 3; ++k) {
+                        clusters[c].normal[k] += triangle_normals[t][k];
+                    }
+                    members.emplace_back(t, c);
+                }
+                for (auto &cluster: clusters) {
+                    cluster.index = static_cast<std::uint32_t>(positions.size() / 3);
+                    const Vec3 n = normalized(cluster.normal);
+                    for (int k = 0; k < 3; ++k) {
+                        positions.push_back(static_cast<float>(positions_[v][k]));
+                        normals.push_back(static_cast<float>(n[k]));
+                    }
+                }
+                for (const auto &[t, c]: members) {
+                    const auto &tri = triangles_[t];
+                    const int corner = tri[0] == v ? 0 : tri[1] == v ? 1 : 2;
+                    corners[t][corner] = clusters[c].index;
+                }
+            }
+
+            std::vector<std::uint32_t> indices;
+            indices.reserve(3 * live_triangles_);
+            for (std::uint32_t t = 0; t < triangles_.size(); ++t) {
+                if (!removed_[t]) {
+                    indices.insert(indices.end(), corners[t].begin(), corners[t].end());
+                }
+            }
+            mesh.positions = std::move(positions);
+            mesh.normals = std::move(normals);
+            mesh.indices = std::move(indices);
+        }
+
+    private:
+        [[nodiscard]] Vec3 normal(const Triangle &t) const {
+            return cross(sub(positions_[t[1]], positions_[t[0]]), sub(positions_[t[2]], positions_[t[0]]));
+        }
+
+        void build_quadrics() {
+            face_quadrics_.assign(positions_.size(), Quadric{});
+            quadrics_.assign(positions_.size(), Quadric{});
+
+            std::unordered_map<std::uint64_t, std::vector<std::uint32_t> > edge_triangles;
+            for (std::uint32_t t = 0; t < triangles_.size(); ++t) {
+                const auto &tri = triangles_[t];
+                const Vec3 n = normalized(normal(tri));
+                const Quadric q = plane_quadric(n, -dot(n, positions_[tri[0]]), 1.0);
+                for (const std::uint32_t v: tri) {
+                    add_to(face_quadrics_[v], q);
+                }
+                for (int k = 0; k < 3; ++k) {
+                    edge_triangles[edge_key(tri[k], tri[(k + 1) % 3])].push_back(t);
+                }
+            }
+            quadrics_ = face_quadrics_;
+
+            // Planes through boundary and crease edges, perpendicular to the adjacent triangles
+            for (const auto &[key, adjacent]: edge_triangles) {
+                const bool boundary = adjacent.size() != 2;
+                const bool crease = !boundary && dot(normalized(normal(triangles_[adjacent[0]])),
+                                                     normalized(normal(triangles_[adjacent[1]]))) < CREASE_COS;
+                if (!boundary && !crease) {
+                    continue;
+                }
+                const auto a = static_cast<std::uint32_t>(key >> 32);
+                const auto b = static_cast<std::uint32_t>(key & 0xFFFFFFFFu);
+                const Vec3 edge = sub(positions_[b], positions_[a]);
+                for (const std::uint32_t t: adjacent) {
+                    const Vec3 n = normalized(cross(edge, normalized(normal(triangles_[t]))));
+                    const Quadric q = plane_quadric(n, -dot(n, positions_[a]), CONSTRAINT_WEIGHT);
+                    add_to(quadrics_[a], q);
+                    add_to(quadrics_[b], q);
+                }
+            }
+        }
+
+        void push(const std::uint32_t a, const std::uint32_t b) {
+            const Quadric q = sum(quadrics_[a], quadrics_[b]);
+            const Vec3 &pa = positions_[a];
+            const Vec3 &pb = positions_[b];
+            std::array<Vec3, 4> candidates = {pa, pb, Vec3{(pa[0] + pb[0]) / 2, (pa[1] + pb[1]) / 2, (pa[2] + pb[2]) / 2},
+                                              Vec3{}};
+            const std::size_t num_candidates = optimal_position(q, candidates[3]) ? 4 : 3;
+            Collapse best{std::numeric_limits<double>::max(), a, b, stamps_[a], stamps_[b], pa};
+            for (std::size_t i = 0; i < num_candidates; ++i) {
+                if (const double cost = evaluate(q, candidates[i]); cost < best.cost) {
+                    best.cost = cost;
+                    best.position = candidates[i];
+                }
+            }
+            heap_.push(best);
+        }
+
+        [[nodiscard]] bool is_valid(const std::uint32_t a, const std::uint32_t b, const Vec3 &position) const {
+            // Link condition: the only common neighbours of a and b are the apexes of the triangles on edge ab
+            std::unordered_set<std::uint32_t> neighbours_a;
+            std::size_t shared_triangles = 0;
+            for (const std::uint32_t t: vertex_triangles_[a]) {
+                if (removed_[t]) {
+                    continue;
+                }
+                const auto &tri = triangles_[t];
+                if (std::find(tri.begin(), tri.end(), b) != tri.end()) {
+                    ++shared_triangles;
+                }
+                neighbours_a.insert(tri.begin(), tri.end());
+            }
+            std::unordered_set<std::uint32_t> common;
+            for (const std::uint32_t t: vertex_triangles_[b]) {
+                if (removed_[t]) {
+                    continue;
+                }
+                for (const std::uint32_t v: triangles_[t]) {
+                    if (v != a && v != b && neighbours_a.count(v) > 0) {
+                        common.insert(v);
+                    }
+                }
+            }
+            if (common.size() != shared_triangles) {
+                return false;
+            }
+
+            // No triangle may flip or degenerate
+            for (const std::uint32_t v: {a, b}) {
+                const std::uint32_t other = v == a ? b : a;
+                for (const std::uint32_t t: vertex_triangles_[v]) {
+                    if (removed_[t]) {
+                        continue;
+                    }
+                    Triangle tri = triangles_[t];
+                    if (std::find(tri.begin(), tri.end(), other) != tri.end()) {
+                        continue;
+                    }
+                    const Vec3 before = normal(tri);
+                    std::replace(tri.begin(), tri.end(), v, std::numeric_limits<std::uint32_t>::max());
+                    Vec3 corners[3];
+                    for (int k = 0; k < 3; ++k) {
+                        corners[k] = tri[k] == std::numeric_limits<std::uint32_t>::max() ? position : positions_[tri[k]];
+                    }
+                    const Vec3 after = cross(sub(corners[1], corners[0]), sub(corners[2], corners[0]));
+                    const double after_length = std::sqrt(dot(after, after));
+                    const double before_length = std::sqrt(dot(before, before));
+                    if (after_length <= 1e-12 * before_length ||
+                        dot(before, after) < MIN_NORMAL_DOT * before_length * after_length) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        void apply(const std::uint32_t a, const std::uint32_t b, const Vec3 &position) {
+            positions_[a] = position;
+            add_to(quadrics_[a], quadrics_[b]);
+            add_to(face_quadrics_[a], face_quadrics_[b]);
+            for (const std::uint32_t t: vertex_triangles_[b]) {
+                if (removed_[t]) {
+                    continue;
+                }
+                auto &tri = triangles_[t];
+                if (std::find(tri.begin(), tri.end(), a) != tri.end()) {
+                    removed_[t] = true;
+                    --live_triangles_;
+                    continue;
+                }
+                std::replace(tri.begin(), tri.end(), b, a);
+                vertex_triangles_[a].push_back(t);
+            }
+            vertex_triangles_[b].clear();
+            alive_[b] = false;
+
+            auto &around = vertex_triangles_[a];
+            around.erase(std::remove_if(around.begin(), around.end(), [this](const std::uint32_t t) {
+                return removed_[t];
+            }), around.end());
+            ++stamps_[a];
+
+            std::unordered_set<std::uint32_t> neighbours;
+            for (const std::uint32_t t: around) {
+                for (const std::uint32_t v: triangles_[t]) {
+                    if (v != a) {
+                        neighbours.insert(v);
+                    }
+                }
+            }
+            for (const std::uint32_t v: neighbours) {
+                push(a, v);
+            }
+        }
+
+        std::vector<Vec3> positions_;
+        std::vector<Triangle> triangles_;
+        std::vector<bool> removed_;
+        std::vector<bool> alive_;
+        std::vector<std::uint32_t> stamps_;
+        std::vector<std::vector<std::uint32_t> > vertex_triangles_;
+        // Triangle planes only, for the reported error, and with the boundary and crease constraints
+        std::vector<Quadric> face_quadrics_;
+        std::vector<Quadric> quadrics_;
+        std::size_t live_triangles_ = 0;
+        std::priority_queue<Collapse, std::vector<Collapse>, std::greater<> > heap_;
+    };
+}
+
+DecimationResult decimate_mesh(Mesh &mesh, const std::size_t target_triangles) {
+    DecimationResult result;
+    result.triangles_before = mesh.indices.size() / 3;
+    result.triangles_after = result.triangles_before;
+    if (result.triangles_before <= target_triangles) {
+        return result;
+    }
+
+    Decimator decimator(mesh);
+    result.max_error = decimator.run(target_triangles);
+    decimator.write(mesh);
+    result.triangles_after = mesh.indices.size() / 3;
+    return result;
+}
+
+std::vector<std::size_t> allocate_triangle_budget(const std::vector<TriangleBudgetItem> &items, const std::size_t budget) {
+    // Water filling over the rendered triangles of each mesh
+    std::vector<std::size_t> targets(items.size(), 0);
+    std::vector<bool> settled(items.size(), false);
+    double remaining = static_cast<double>(budget);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        double total_importance = 0.0;
+        for (std::size_t i = 0; i < items.size(); ++i) {
+            if (!settled[i]) {
+                total_importance += items[i].importance;
+            }
+        }
+        for (std::size_t i = 0; i < items.size(); ++i) {
+            if (settled[i]) {
+                continue;
+            }
+            const double rendered = static_cast<double>(items[i].triangles * std::max<std::size_t>(items[i].instances, 1));
+            const double share = total_importance > 0.0 ? remaining * items[i].importance / total_importance : 0.0;
+            if (rendered <= share) {
+                targets[i] = items[i].triangles;
+                settled[i] = true;
+                remaining -= rendered;
+                changed = true;
+            }
+        }
+    }
+
+    double total_importance = 0.0;
+    for (std::size_t i = 0; i < items.size(); ++i) {
+        if (!settled[i]) {
+            total_importance += items[i].importance;
+        }
+    }
+    for (std::size_t i = 0; i < items.size(); ++i) {
+        if (settled[i]) {
+            continue;
+        }
+        const double share = total_importance > 0.0 ? remaining * items[i].importance / total_importance : 0.0;
+        targets[i] = static_cast<std::size_t>(share / static_cast<double>(std::max<std::size_t>(items[i].instances, 1)));
+    }
+    return targets;
+}
@@ -0,0 +1,36 @@
+#ifndef NANO_OCCT_DECIMATION_H
+#define NANO_OCCT_DECIMATION_H
+
+#include <cstddef>
+#include <vector>
+#include "Mesh.h"
+
+struct DecimationResult {
+    std::size_t triangles_before = 0;
+    std::size_t triangles_after = 0;
+    // Square root of the largest quadric error of a collapse. An upper bound of the distance of a moved vertex
+    // from the planes of the original triangles it has absorbed.
+    double max_error = 0.0;
+};
+
+// Reduces a triangle mesh to at most target_triangles by quadric error edge collapses (Garland & Heckbert).
+//
+// Vertices are welded by position first, so the faces of a CAD shape are decimated as one surface without
+// opening cracks along their boundaries. Open boundaries and creases sharper than 45 degrees are preserved by
+// constraint planes. Collapses that would flip a triangle or make the surface non-manifold are rejected, so
+// the result may stay above the target. Normals of a decimated mesh are recomputed and split at creases.
+// Meshes already within the target are left untouched.
+DecimationResult decimate_mesh(Mesh &mesh, std::size_t target_triangles);
+
+struct TriangleBudgetItem {
+    std::size_t triangles;
+    std::size_t instances;
+    double importance;
+};
+
+// Target triangle count of every mesh such that the rendered triangles (triangles times instances) fit into
+// budget. The budget is shared in proportion to importance. Meshes whose share exceeds what they have keep all
+// their triangles and leave the rest to the others.
+std::vector<std::size_t> allocate_triangle_budget(const std::vector<TriangleBudgetItem> &items, std::size_t budget);
+
+#endif //NANO_OCCT_DECIMATION_H
@@ -0,0 +1,439 @@
+#include "mesh_optimize.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <numbers>
+#include <numeric>
+#include <unordered_map>
+
+namespace {
+    const double WELD_NORMAL_COS = std::cos(20.0 * std::numbers::pi / 180.0);
+    constexpr double WELD_RELATIVE_TOLERANCE = 1e-6;
+    constexpr std::size_t FORSYTH_CACHE_SIZE = 32;
+    constexpr std::size_t MEASURE_CACHE_SIZE = 16;
+    constexpr double OVERDRAW_MAX_ACMR_INCREASE = 1.05;
+    constexpr std::uint32_t NONE = std::numeric_limits<std::uint32_t>::max();
+
+    std::size_t buffer_bytes(const std::size_t num_vertices, const std::size_t num_indices) {
+        const std::size_t index_size = num_vertices <= std::numeric_limits<std::uint16_t>::max() ? 2 : 4;
+        return 24 * num_vertices + (index_size * num_indices + 3) / 4 * 4;
+    }
+
+    std::size_t count_misses(const std::vector<std::uint32_t> &indices, const std::size_t num_vertices,
+                             const std::size_t cache_size) {
+        // FIFO cache: a vertex is resident if it entered less than cache_size misses ago
+        std::vector<std::size_t> entered(num_vertices, 0);
+        std::size_t misses = 0;
+        for (const std::uint32_t v: indices) {
+            if (entered[v] == 0 || misses - (entered[v] - 1) >= cache_size) {
+                ++misses;
+                entered[v] = misses;
+            }
+        }
+        return misses;
+    }
+
+    struct CellHash {
+        std::size_t operator()(const std::array<std::int64_t, 3> &cell) const {
+            std::size_t h = static_cast<std::size_t>(cell[0]) * 73856093ULL;
+            h ^= static_cast<std::size_t>(cell[1]) * 19349663ULL;
+            h ^= static_cast<std::size_t>(cell[2]) * 83492791ULL;
+            return h;
+        }
+    };
+
+    // Merges vertices within tolerance whose normals agree, and drops triangles that collapse
+    void weld_vertices(Mesh &mesh) {
+        const std::size_t num_vertices = mesh.positions.size() / 3;
+        const bool has_normals = mesh.normals.size() == mesh.positions.size();
+
+        double lo[3] = {std::numeric_limits<double>::max(), std::numeric_limits<double>::max(),
+                        std::numeric_limits<double>::max()};
+        double hi[3] = {std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest(),
+                        std::numeric_limits<double>::lowest()};
+        for (std::size_t i = 0; i < mesh.positions.size(); ++i) {
+            lo[i % 3] = std::min(lo[i % 3], static_cast<double>(mesh.positions[i]));
+            hi[i % 3] = std::max(hi[i % 3], static_cast<double>(mesh.positions[i]));
+        }
+        const double diagonal = std::sqrt((hi[0] - lo[0]) * (hi[0] - lo[0]) + (hi[1] - lo[1]) * (hi[1] - lo[1]) +
+                                          (hi[2] - lo[2]) * (hi[2] - lo[2]));
+        const double tolerance = std::max(WELD_RELATIVE_TOLERANCE * diagonal, std::numeric_limits<double>::min());
+
+        auto cell_of = [&](const std::size_t v) {
+            return std::array<std::int64_t, 3>{
+                static_cast<std::int64_t>(std::floor(mesh.positions[3 * v] / tolerance)),
+                static_cast<std::int64_t>(std::floor(mesh.positions[3 * v + 1] / tolerance)),
+                static_cast<std::int64_t>(std::floor(mesh.positions[3 * v + 2] / tolerance))
+            };
+        };
+        auto can_merge = [&](const std::size_t a, const std::size_t b) {
+            double distance2 = 0.0, normal_dot = 0.0;
+            for (int k = 0; k < 3; ++k) {
+                const double d = mesh.positions[3 * a + k] - mesh.positions[3 * b + k];
+                distance2 += d * d;
+                if (has_normals) {
+                    normal_dot += mesh.normals[3 * a + k] * mesh.normals[3 * b + k];
+                }
+            }
+            return distance2 <= tolerance * tolerance && (!has_normals || normal_dot >= WELD_NORMAL_COS);
+        };
+
+        // Representatives per grid cell. Candidates are searched in the neighbouring cells as well.
+        std::unordered_map<std::array<std::int64_t, 3>, std::vector<std::uint32_t>, CellHash> grid;
+        std::vector<std::uint32_t> remap(num_vertices);
+        std::vector<std::uint32_t> representatives;
+        for (std::size_t v = 0; v < num_vertices; ++v) {
+            const auto cell = cell_of(v);
+            std::uint32_t found = NONE;
+            for (std::int64_t dx = -1; dx <= 1 && found == NONE; ++dx) {
+                for (std::int64_t dy = -1; dy <= 1 && found == NONE; ++dy) {
+                    for (std::int64_t dz = -1; dz <= 1 && found == NONE; ++dz) {
+                        const auto it = grid.find({cell[0] + dx, cell[1] + dy, cell[2] + dz});
+                        if (it == grid.end()) {
+                            continue;
+                        }
+                        for (const std::uint32_t r: it->second) {
+                            if (can_merge(representatives[r], v)) {
+                                found = r;
+                                break;
+                            }
+                        }
+                    }
+                }
+            }
+            if (found == NONE) {
+                found = static_cast<std::uint32_t>(representatives.size());
+                representatives.push_back(static_cast<std::uint32_t>(v));
+                grid[cell].push_back(found);
+            }
+            remap[v] = found;
+        }
+
+        std::vector<float> positions(3 * representatives.size());
+        std::vector<float> normals(has_normals ? 3 * representatives.size() : 0, 0.0f);
+        for (std::size_t r = 0; r < representatives.size(); ++r) {
+            for (int k = 0; k < 3; ++k) {
+                positions[3 * r + k] = mesh.positions[3 * representatives[r] + k];
+            }
+        }
+        if (has_normals) {
+            // Average the normals of the merged vertices
+            for (std::size_t v = 0; v < num_vertices; ++v) {
+                for (int k = 0; k < 3; ++k) {
+                    normals[3 * remap[v] + k] += mesh.normals[3 * v + k];
+                }
+            }
+            for (std::size_t r = 0; r < representatives.size(); ++r) {
+                const float length = std::sqrt(normals[3 * r] * normals[3 * r] + normals[3 * r + 1] * normals[3 * r + 1]
+                                               + normals[3 * r + 2] * normals[3 * r + 2]);
+                if (length > 0.0f) {
+                    for (int k = 0; k < 3; ++k) {
+                        normals[3 * r + k] /= length;
+                    }
+                }
+            }
+        }
+
+        std::vector<std::uint32_t> indices;
+        indices.reserve(mesh.indices.size());
+        for (std::size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            const std::uint32_t a = remap[mesh.indices[i]], b = remap[mesh.indices[i + 1]], c = remap[mesh.indices[i + 2]];
+            if (a != b && b != c && a != c) {
+                indices.insert(indices.end(), {a, b, c});
+            }
+        }
+        mesh.positions = std::move(positions);
+        mesh.normals = std::move(normals);
+        mesh.indices = std::move(indices);
+    }
+
+    // Tom Forsyth, "Linear-Speed Vertex Cache Optimisation"
+    std::vector<std::uint32_t> optimize_vertex_cache(const std::vector<std::uint32_t> &indices,
+                                                     const std::size_t num_vertices) {
+        const std::size_t num_triangles = indices.size() / 3;
+
+        // Triangles of each vertex. The first remaining[v] entries are those not emitted yet.
+        std::vector<std::uint32_t> offsets(num_vertices + 1, 0);
+        for (const std::uint32_t v: indices) {
+            ++offsets[v + 1];
+        }
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+        std::vector<std::uint32_t> remaining(num_vertices);
+        for (std::size_t v = 0; v < num_vertices; ++v) {
+            remaining[v] = offsets[v + 1] - offsets[v];
+        }
+        std::vector<std::uint32_t> vertex_triangles(indices.size());
+        {
+            std::vector<std::uint32_t> fill(offsets.begin(), offsets.end() - 1);
+            for (std::size_t i = 0; i < indices.size(); ++i) {
+                vertex_triangles[fill[indices[i]]++] = static_cast<std::uint32_t>(i / 3);
+            }
+        }
+
+        std::vector<int> cache_position(num_vertices, -1);
+        auto vertex_score = [&](const std::uint32_t v) {
+            if (remaining[v] == 0) {
+                return -1.0f;
+            }
+            float score = 0.0f;
+            if (const int position = cache_position[v]; position >= 0) {
+                // The last triangle's vertices get a fixed score, so the strip does not simply continue
+                score = position < 3
+                            ? 0.75f
+                            : std::pow(1.0f - static_cast<float>(position - 3) /
+                                              static_cast<float>(FORSYTH_CACHE_SIZE - 3), 1.5f);
+            }
+            return score + 2.0f / std::sqrt(static_cast<float>(remaining[v]));
+        };
+
+        std::vector<float> vertex_scores(num_vertices);
+        for (std::uint32_t v = 0; v < num_vertices; ++v) {
+            vertex_scores[v] = vertex_score(v);
+        }
+        std::vector<float> triangle_scores(num_triangles);
+        for (std::size_t t = 0; t < num_triangles; ++t) {
+            triangle_scores[t] = vertex_scores[indices[3 * t]] + vertex_scores[indices[3 * t + 1]] +
+                                 vertex_scores[indices[3 * t + 2]];
+        }
+        std::vector<bool> emitted(num_triangles, false);
+
+        std::vector<std::uint32_t> result;
+        result.reserve(indices.size());
+        std::vector<std::uint32_t> cache;
+        std::vector<std::uint32_t> new_cache;
+        std::size_t cursor = 0;
+        std::uint32_t best = num_triangles > 0
+                                 ? static_cast<std::uint32_t>(std::max_element(triangle_scores.begin(),
+                                                                               triangle_scores.end()) -
+                                                              triangle_scores.begin())
+                                 : NONE;
+
+        for (std::size_t step = 0; step < num_triangles; ++step) {
+            if (best == NONE) {
+                // Nothing in the cache has triangles left, continue with the next unused triangle
+                while (emitted[cursor]) {
+                    ++cursor;
+                }
+                best = static_cast<std::uint32_t>(cursor);
+            }
+            emitted[best] = true;
+            const std::uint32_t *tri = &indices[3 * best];
+            result.insert(result.end(), tri, tri + 3);
+
+            for (int k = 0; k < 3; ++k) {
+                const std::uint32_t v = tri[k];
+                auto *begin = &vertex_triangles[offsets[v]];
+                auto *end = begin + remaining[v];
+                auto *it = std::find(begin, end, best);
+                std::swap(*it, *(end - 1));
+                --remaining[v];
+            }
+
+            // Most recently used first
+            new_cache.assign(tri, tri + 3);
+            for (const std::uint32_t v: cache) {
+                if (v != tri[0] && v != tri[1] && v != tri[2]) {
+                    new_cache.push_back(v);
+                }
+            }
+            for (std::size_t i = 0; i < new_cache.size(); ++i) {
+                cache_position[new_cache[i]] = i < FORSYTH_CACHE_SIZE ? static_cast<int>(i) : -1;
+            }
+            // Evicted vertices lose their cache score; their triangles are rescored with the rest
+            for (const std::uint32_t v: new_cache) {
+                vertex_scores[v] = vertex_score(v);
+            }
+            if (new_cache.size() > FORSYTH_CACHE_SIZE) {
+                new_cache.resize(FORSYTH_CACHE_SIZE);
+            }
+            std::swap(cache, new_cache);
+
+            best = NONE;
+            float best_score = -1.0f;
+            for (const std::uint32_t v: cache) {
+                for (std::uint32_t i = 0; i < remaining[v]; ++i) {
+                    const std::uint32_t t = vertex_triangles[offsets[v] + i];
+                    const float score = vertex_scores[indices[3 * t]] + vertex_scores[indices[3 * t + 1]] +
+                                        vertex_scores[indices[3 * t + 2]];
+                    triangle_scores[t] = score;
+                    if (score > best_score) {
+                        best_score = score;
+                        best = t;
+                    }
+                }
+            }
+        }
+        return result;
+    }
+
+    // Moves clusters of triangles facing away from the mesh center to the front, as they are likely to occlude
+    // the rest. Clusters start where the vertex cache starts over, so reordering them costs little cache.
+    std::vector<std::uint32_t> optimize_overdraw(const std::vector<std::uint32_t> &indices, const Mesh &mesh) {
+        const std::size_t num_vertices = mesh.positions.size() / 3;
+        const std::size_t num_triangles = indices.size() / 3;
+
+        std::vector<std::size_t> cluster_starts;
+        std::vector<std::size_t> entered(num_vertices, 0);
+        std::size_t misses = 0;
+        for (std::size_t t = 0; t < num_triangles; ++t) {
+            int triangle_misses = 0;
+            for (int k = 0; k < 3; ++k) {
+                const std::uint32_t v = indices[3 * t + k];
+                if (entered[v] == 0 || misses - (entered[v] - 1) >= MEASURE_CACHE_SIZE) {
+                    ++misses;
+                    ++triangle_misses;
+                    entered[v] = misses;
+                }
+            }
+            if (t == 0 || triangle_misses == 3) {
+                cluster_starts.push_back(t);
+            }
+        }
+        cluster_starts.push_back(num_triangles);
+        const std::size_t num_clusters = cluster_starts.size() - 1;
+        if (num_clusters < 2) {
+            return indices;
+        }
+
+        auto position = [&](const std::uint32_t v) {
+            return std::array<double, 3>{mesh.positions[3 * v], mesh.positions[3 * v + 1], mesh.positions[3 * v + 2]};
+        };
+        std::array<double, 3> mesh_center{};
+        for (std::size_t v = 0; v < num_vertices; ++v) {
+            const auto p = position(static_cast<std::uint32_t>(v));
+            for (int k = 0; k < 3; ++k) {
+                mesh_center[k] += p[k] / static_cast<double>(num_vertices);
+            }
+        }
+
+        std::vector<double> keys(num_clusters);
+        for (std::size_t c = 0; c < num_clusters; ++c) {
+            std::array<double, 3> center{}, normal{};
+            double area = 0.0;
+            for (std::size_t t = cluster_starts[c]; t < cluster_starts[c + 1]; ++t) {
+                const auto p0 = position(indices[3 * t]);
+                const auto p1 = position(indices[3 * t + 1]);
+                const auto p2 = position(indices[3 * t + 2]);
+                const std::array<double, 3> e1 = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+                const std::array<double, 3> e2 = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+                const std::array<double, 3> n = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2],
+                                                 e1[0] * e2[1] - e1[1] * e2[0]};
+                const double triangle_area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                for (int k = 0; k < 3; ++k) {
+                    center[k] += (p0[k] + p1[k] + p2[k]) / 3.0 * triangle_area;
+                    normal[k] += n[k];
+                }
+                area += triangle_area;
+            }
+            const double normal_length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            if (area <= 0.0 || normal_length <= 0.0) {
+                keys[c] = 0.0;
+                continue;
+            }
+            double key = 0.0;
+            for (int k = 0; k < 3; ++k) {
+                key += (center[k] / area - mesh_center[k]) * normal[k] / normal_length;
+            }
+            keys[c] = key;
+        }
+
+        std::vector<std::size_t> order(num_clusters);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](const std::size_t a, const std::size_t b) {
+            return keys[a] > keys[b];
+        });
+        std::vector<std::uint32_t> result;
+        result.reserve(indices.size());
+        for (const std::size_t c: order) {
+            result.insert(result.end(), indices.begin() + static_cast<std::ptrdiff_t>(3 * cluster_starts[c]),
+                          indices.begin() + static_cast<std::ptrdiff_t>(3 * cluster_starts[c + 1]));
+        }
+        return result;
+    }
+
+    // Renumbers the vertices in order of first use and drops unused ones
+    void optimize_vertex_fetch(Mesh &mesh) {
+        const std::size_t num_vertices = mesh.positions.size() / 3;
+        const bool has_normals = mesh.normals.size() == mesh.positions.size();
+        std::vector<std::uint32_t> remap(num_vertices, NONE);
+        std::vector<float> positions;
+        std::vector<float> normals;
+        positions.reserve(mesh.positions.size());
+        normals.reserve(mesh.normals.size());
+        std::uint32_t next = 0;
+        for (std::uint32_t &index: mesh.indices) {
+            if (remap[index] == NONE) {
+                remap[index] = next++;
+                positions.insert(positions.end(), mesh.positions.begin() + 3 * index,
+                                 mesh.positions.begin() + 3 * index + 3);
+                if (has_normals) {
+                    normals.insert(normals.end(), mesh.normals.begin() + 3 * index, mesh.normals.begin() + 3 * index + 3);
+                }
+            }
+            index = remap[index];
+        }
+        mesh.positions = std::move(positions);
+        mesh.normals = std::move(normals);
+    }
+}
+
+double acmr(const std::vector<std::uint32_t> &indices, const std::size_t num_vertices, const std::size_t cache_size) {
+    if (indices.empty()) {
+        return 0.0;
+    }
+    return static_cast<double>(count_misses(indices, num_vertices, cache_size)) /
+           static_cast<double>(indices.size() / 3);
+}
+
+MeshOptimizationStats optimize_mesh(Mesh &mesh) {
+    MeshOptimizationStats stats;
+    stats.vertices_before = mesh.positions.size() / 3;
+    stats.triangles_before = mesh.indices.size() / 3;
+    stats.bytes_before = buffer_bytes(stats.vertices_before, mesh.indices.size());
+    stats.cache_misses_before = count_misses(mesh.indices, stats.vertices_before, MEASURE_CACHE_SIZE);
+
+    weld_vertices(mesh);
+    const std::size_t num_vertices = mesh.positions.size() / 3;
+    mesh.indices = optimize_vertex_cache(mesh.indices, num_vertices);
+
+    const double cache_acmr = acmr(mesh.indices, num_vertices, MEASURE_CACHE_SIZE);
+    if (auto reordered = optimize_overdraw(mesh.indices, mesh);
+        acmr(reordered, num_vertices, MEASURE_CACHE_SIZE) <= OVERDRAW_MAX_ACMR_INCREASE * cache_acmr) {
+        mesh.indices = std::move(reordered);
+    }
+    optimize_vertex_fetch(mesh);
+
+    stats.vertices_after = mesh.positions.size() / 3;
+    stats.triangles_after = mesh.indices.size() / 3;
+    stats.cache_misses_after = count_misses(mesh.indices, stats.vertices_after, MEASURE_CACHE_SIZE);
+    stats.bytes_after = buffer_bytes(stats.vertices_after, mesh.indices.size());
+    return stats;
+}
+
+void MeshOptimizationReport::add(const MeshOptimizationStats &stats) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++num_meshes_;
+    total_.vertices_before += stats.vertices_before;
+    total_.vertices_after += stats.vertices_after;
+    total_.triangles_before += stats.triangles_before;
+    total_.triangles_after += stats.triangles_after;
+    total_.cache_misses_before += stats.cache_misses_before;
+    total_.cache_misses_after += stats.cache_misses_after;
+    total_.bytes_before += stats.bytes_before;
+    total_.bytes_after += stats.bytes_after;
+}
+
+void MeshOptimizationReport::print(std::ostream &os) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const double triangles_before = std::max<double>(1.0, static_cast<double>(total_.triangles_before));
+    const double triangles_after = std::max<double>(1.0, static_cast<double>(total_.triangles_after));
+    os << "Mesh optimization: " << num_meshes_ << " meshes, vertices " << total_.vertices_before << " -> "
+            << total_.vertices_after << ", ACMR " << std::fixed << std::setprecision(3)
+            << static_cast<double>(total_.cache_misses_before) / triangles_before << " -> "
+            << static_cast<double>(total_.cache_misses_after) / triangles_after << ", vertex and index data "
+            << std::setprecision(1) << static_cast<double>(total_.bytes_before) / (1024.0 * 1024.0) << " MB -> "
+            << static_cast<double>(total_.bytes_after) / (1024.0 * 1024.0) << " MB\n";
+}
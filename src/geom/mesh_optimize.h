@@ -0,0 +1,49 @@
+#ifndef NANO_OCCT_MESH_OPTIMIZE_H
+#define NANO_OCCT_MESH_OPTIMIZE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <vector>
+#include "Mesh.h"
+
+struct MeshOptimizationStats {
+    std::size_t vertices_before = 0;
+    std::size_t vertices_after = 0;
+    std::size_t triangles_before = 0;
+    std::size_t triangles_after = 0;
+    // Vertex cache misses, measured with a 16 entry FIFO cache
+    std::size_t cache_misses_before = 0;
+    std::size_t cache_misses_after = 0;
+    // Size of the vertex and index data in the GLB binary chunk
+    std::size_t bytes_before = 0;
+    std::size_t bytes_after = 0;
+};
+
+// Prepares a triangle mesh for rendering:
+//  1. welds vertices closer than a millionth of the mesh size whose normals differ by less than 20 degrees, so
+//     seams between the faces of a shape are shared while creases keep their own normals,
+//  2. orders the triangles for the post-transform vertex cache (Forsyth's linear-speed algorithm),
+//  3. reorders clusters of triangles to draw the outward facing ones first, which reduces overdraw, as long as
+//     it costs less than 5% in cache efficiency,
+//  4. renumbers the vertices in the order they are first used, for vertex fetch locality.
+MeshOptimizationStats optimize_mesh(Mesh &mesh);
+
+// Average cache miss ratio: vertex cache misses per triangle for a FIFO cache of the given size
+double acmr(const std::vector<std::uint32_t> &indices, std::size_t num_vertices, std::size_t cache_size = 16);
+
+// Accumulates the statistics of optimized meshes. Safe to call from several threads.
+class MeshOptimizationReport {
+public:
+    void add(const MeshOptimizationStats &stats);
+
+    void print(std::ostream &os) const;
+
+private:
+    mutable std::mutex mutex_;
+    std::size_t num_meshes_ = 0;
+    MeshOptimizationStats total_;
+};
+
+#endif //NANO_OCCT_MESH_OPTIMIZE_H
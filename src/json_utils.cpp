@@ -0,0 +1,32 @@
+#include "json_utils.h"
+
+#include <iomanip>
+#include <sstream>
+
+std::string escape_json(const std::string &value) {
+    std::string result;
+    result.reserve(value.size());
+    for (const char c: value) {
+        switch (c) {
+            case '"': result += "\\\"";
+                break;
+            case '\\': result += "\\\\";
+                break;
+            case '\n': result += "\\n";
+                break;
+            case '\r': result += "\\r";
+                break;
+            case '\t': result += "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    std::ostringstream hex;
+                    hex << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c);
+                    result += hex.str();
+                } else {
+                    result += c;
+                }
+        }
+    }
+    return result;
+}
@@ -0,0 +1,9 @@
+#ifndef JSON_UTILS_H
+#define JSON_UTILS_H
+
+#include <string>
+
+// Escapes a string for use inside a JSON string literal
+std::string escape_json(const std::string &value);
+
+#endif //JSON_UTILS_H
@@ -14,6 +14,7 @@
 #include "cadit/occt/bsplinesurf.h"
 #include "cadit/occt/helpers.h"
 #include "config_utils.h"
+#include "trace.h"
 
 void print_status(const GlobalConfig& config) {
     std::cout << "STP2GLB Converter" << "\n";
@@ -22,12 +23,45 @@ void print_status(const GlobalConfig& config) {
     std::cout << "Tessellation Parameters: " << "\n";
     std::cout << "Linear Deflection: " << config.linearDeflection << "\n";
     std::cout << "Angular Deflection: " << config.angularDeflection << "\n";
-    std::cout << "Relative Deflection: " << config.relativeDeflection << "\n\n";
+    std::cout << "Relative Deflection: " << config.relativeDeflection << "\n";
+    std::cout << "Auto Deflection: " << config.autoDeflection << "\n";
+    std::cout << "Analytic Fast Path: " << config.analyticFastPath << "\n";
+    if (!config.lod_deflections.empty())
+    {
+        std::cout << "LOD Deflections:";
+        for (const auto& deflection : config.lod_deflections)
+            std::cout << " " << deflection;
+        std::cout << "\n";
+    }
+    if (config.maxTriangles > 0)
+        std::cout << "Max Triangles: " << config.maxTriangles << "\n";
+    std::cout << "Optimize Meshes: " << config.optimizeMeshes << "\n";
+    std::cout << "Meshopt Compression: " << config.meshoptCompression << "\n";
+    if (config.quantize)
+        std::cout << "Quantize: positions 16 bit, normals " << config.normalBits << " bit\n";
+    std::cout << "Batch Meshes: " << config.batchMeshes << "\n";
+    if (config.tiles)
+        std::cout << "Tiles: max " << config.tileTriangles << " triangles per tile\n";
+    std::cout << "BVH Sidecar: " << config.bvhSidecar << "\n";
+    if (config.maxBufferMb > 0.0)
+        std::cout << "Max Buffer Size: " << config.maxBufferMb << " MB\n";
+    std::cout << "\n";
     std::cout << "Debug Parameters: " << "\n";
     std::cout << "Debug Mode: " << config.debug_mode << "\n";
     std::cout << "Solid Only: " << config.solidOnly << "\n";
     std::cout << "Max Geometry Num: " << config.max_geometry_num << "\n";
-    std::cout << "Tessellation Timeout: " << config.tessellation_timout << "\n\n";
+    std::cout << "Tessellation Timeout: " << config.tessellation_timout << "\n";
+    std::cout << "GLB Writer: " << config.glbWriter << "\n";
+    std::cout << "Debug STEP: " << config.debugStep << "\n";
+    std::cout << "Num Threads: " << config.num_threads << "\n";
+    if (!config.cacheDir.empty())
+        std::cout << "Cache Dir: " << config.cacheDir << " (max " << config.cacheMaxMb << " MB)\n";
+    std::cout << "Incremental: " << config.incremental << "\n";
+    if (!config.costModelFile.empty())
+        std::cout << "Cost Model: " << config.costModelFile << "\n";
+    if (!config.traceFile.empty())
+        std::cout << "Trace File: " << config.traceFile << "\n";
+    std::cout << "\n";
 
     // Debug output
     if (!config.filter_names_include.empty())
@@ -57,6 +91,21 @@ int main(int argc, char* argv[])
     app.add_option("--lin-defl", "Linear deflection")->default_val(0.1)->check(CLI::Range(0.0, 1.0));
     app.add_option("--ang-defl", "Angular deflection")->default_val(0.5)->check(CLI::Range(0.0, 1.0));
     app.add_flag("--rel-defl", "Relative deflection");
+    app.add_option("--auto-defl", "Per shape linear deflection as a fraction of the shape's bounding box diagonal. 0 disables")->default_val(0.0)->check(CLI::Range(0.0, 1.0));
+    app.add_flag("--analytic-mesh", "Mesh planes, cylinders, cones, spheres and tori with closed-form generators. Other faces use the general mesher");
+    app.add_option("--lods", "Linear deflections of the levels of detail, fine to coarse. Comma separated list. Written using MSFT_lod")->default_val("");
+    app.add_option("--lod-coverage", "Screen coverage of each level of detail. Comma separated list")->default_val("");
+    app.add_option("--max-triangles", "Triangle budget of the whole model, instances included. Parts are decimated by their visual importance to fit. 0 disables")->default_val(0)->check(CLI::NonNegativeNumber);
+    app.add_flag("--optimize-mesh", "Weld vertices and reorder triangles and vertices for GPU vertex cache, overdraw and fetch efficiency");
+    app.add_option("--compression", "Compression of the GLB buffers. meshopt writes EXT_meshopt_compression, best combined with --optimize-mesh")->default_val("none")->check(CLI::IsMember({"none", "meshopt"}));
+    app.add_flag("--quantize", "Store positions as 16-bit and normals as 8- or 16-bit normalized integers using KHR_mesh_quantization");
+    app.add_option("--normal-bits", "Bits per normal component with --quantize. Normals are octahedrally encoded when combined with --compression=meshopt")->default_val(8)->check(CLI::IsMember({8, 16}));
+
+    app.add_flag("--batch", "Merge all meshes of the same material into one primitive in world coordinates. The triangles of every product are kept as ranges (EXT_mesh_features) for picking and hiding");
+    app.add_flag("--tiles", "Write a 3D Tiles tileset to <glb stem>-tiles, with one GLB per octree tile, instead of a single GLB");
+    app.add_option("--tile-triangles", "Tiles with more triangles than this are split into octants")->default_val(500000)->check(CLI::PositiveNumber);
+    app.add_flag("--bvh", "Write a bounding volume hierarchy of the world bounds of all mesh nodes to <glb stem>-bvh.bin, keyed by glTF node index, for culling and picking");
+    app.add_option("--max-buffer-mb", "Largest GLB buffer in MB. Larger geometry is written as <glb stem>.gltf with external .bin buffers, as is geometry beyond the 4 GB GLB limit; in debug mode the GLB keeps the first buffer and references the others. 0 keeps a single GLB where the format allows it")->default_val(0.0)->check(CLI::NonNegativeNumber);
 
     app.add_flag("--debug", "Debug mode. Slower (and experimental), but provides more information about which STEP entities that failed to convert");
     app.add_flag("--solid-only", "Solid only");
@@ -66,6 +115,14 @@ int main(int argc, char* argv[])
     app.add_option("--filter-names-exclude", "Exclude Filter name. Command separated list")->default_val("");
     app.add_option("--filter-names-file-exclude", "Exclude Filter name file")->default_val("");
     app.add_option("--tessellation-timeout", "Tessellation timeout")->default_val(30);
+    app.add_option("--glb-writer", "GLB writer in debug mode. direct writes from the product tree and the meshes, xcaf through an XCAF document, both writes the two and compares their timings")->default_val("direct")->check(CLI::IsMember({"direct", "xcaf", "both"}));
+    app.add_flag("--no-debug-step", "Skip the <glb>-debug.stp output in debug mode");
+    app.add_option("--num-threads", "Number of threads used for tessellation. 0 uses all available cores")->default_val(0);
+    app.add_option("--cache-dir", "Directory of the triangulation cache. Empty disables the cache")->default_val("");
+    app.add_option("--cache-max-mb", "Maximum size of the triangulation cache in MB")->default_val(1024)->check(CLI::PositiveNumber);
+    app.add_option("--cost-model", "File of recorded tessellation timings. Predicts the meshing time of each shape to order the work and to mesh shapes predicted above the timeout coarser. Updated after each run")->default_val("");
+    app.add_option("--trace", "Write a Chrome trace-event JSON of the conversion stages and of every shape, per thread. Open it in chrome://tracing or ui.perfetto.dev")->default_val("");
+    app.add_flag("--incremental", "Reuse the meshes of unchanged product subtrees from the triangulation cache (--cache-dir, by default <glb stem>-cache). Requires --debug");
 
     // const auto build = app.add_subcommand("build", "Build");
     // build->add_option("--b-spline-surf", "Build a B-Spline surface")->default_val(false);
@@ -84,6 +141,9 @@ int main(int argc, char* argv[])
     std::cout << "\n";
     std::cout << "Starting conversion..." << "\n";
 
+    if (!config.traceFile.empty())
+        start_tracing();
+
     const auto start = std::chrono::high_resolution_clock::now();
     try {
         if (config.buildConfig.build_bspline_surf)
@@ -105,5 +165,11 @@ int main(int argc, char* argv[])
     const double seconds = static_cast<double>(duration.count()) / 1e6;
     std::cout << "STP converted in: " << std::fixed << std::setprecision(2) << seconds << " seconds" << "\n";
 
+    if (!config.traceFile.empty())
+    {
+        const std::size_t num_events = write_trace(config.traceFile);
+        std::cout << "Trace of " << num_events << " events written to " << config.traceFile.string() << "\n";
+    }
+
     return 0;
 }
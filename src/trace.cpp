@@ -0,0 +1,176 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "json_utils.h"
+
+namespace {
+    struct TraceEvent {
+        const char *name;
+        std::int64_t id;
+        std::int64_t begin_ns;
+        std::int64_t end_ns;
+        std::string label;
+    };
+
+    // Ring buffer written by one thread only. The head counts all events ever pushed.
+    class TraceBuffer {
+    public:
+        explicit TraceBuffer(const std::size_t capacity) : events_(capacity) {
+        }
+
+        void push(TraceEvent event) {
+            const std::uint64_t head = head_.load(std::memory_order_relaxed);
+            events_[head & (events_.size() - 1)] = std::move(event);
+            head_.store(head + 1, std::memory_order_release);
+        }
+
+        std::uint64_t head() const {
+            return head_.load(std::memory_order_acquire);
+        }
+
+        const TraceEvent &at(const std::uint64_t index) const {
+            return events_[index & (events_.size() - 1)];
+        }
+
+        std::size_t capacity() const {
+            return events_.size();
+        }
+
+    private:
+        std::vector<TraceEvent> events_;
+        std::atomic<std::uint64_t> head_{0};
+    };
+
+    std::atomic<bool> enabled{false};
+    std::chrono::steady_clock::time_point origin;
+    std::size_t buffer_capacity = 0;
+
+    // Buffers outlive their threads, the pools are gone by the time the trace is written
+    std::mutex buffers_mutex;
+    std::vector<std::unique_ptr<TraceBuffer> > buffers;
+
+    // The lock is only taken the first time a thread records
+    TraceBuffer &thread_buffer() {
+        thread_local TraceBuffer *buffer = nullptr;
+        if (!buffer) {
+            std::lock_guard<std::mutex> lock(buffers_mutex);
+            buffers.push_back(std::make_unique<TraceBuffer>(buffer_capacity));
+            buffer = buffers.back().get();
+        }
+        return *buffer;
+    }
+
+    std::int64_t since_origin(const std::chrono::steady_clock::time_point time) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(time - origin).count();
+    }
+
+    void write_microseconds(std::ostream &os, const std::int64_t ns) {
+        os << ns / 1000 << '.' << std::setw(3) << std::setfill('0') << ns % 1000;
+    }
+}
+
+void start_tracing(const std::size_t events_per_thread) {
+    if (enabled.load(std::memory_order_relaxed)) {
+        return;
+    }
+    buffer_capacity = std::bit_ceil(std::max<std::size_t>(events_per_thread, 2));
+    origin = std::chrono::steady_clock::now();
+    enabled.store(true, std::memory_order_release);
+    // The calling thread becomes the first one in the trace
+    thread_buffer();
+}
+
+bool tracing_enabled() {
+    return enabled.load(std::memory_order_acquire);
+}
+
+std::size_t write_trace(const std::filesystem::path &trace_file) {
+    if (const std::filesystem::path trace_dir = trace_file.parent_path(); !trace_dir.empty() && !exists(trace_dir)) {
+        create_directories(trace_dir);
+    }
+    std::ofstream file(trace_file);
+    if (!file) {
+        throw std::runtime_error("Could not open trace file: " + trace_file.string());
+    }
+
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    std::size_t num_events = 0;
+    std::uint64_t num_overwritten = 0;
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    file << R"({"name":"process_name","ph":"M","pid":1,"tid":0,"args":{"name":"stp2glb"}})";
+    for (std::size_t tid = 0; tid < buffers.size(); ++tid) {
+        const TraceBuffer &buffer = *buffers[tid];
+        const std::string thread_name = tid == 0 ? "main" : "thread " + std::to_string(tid);
+        file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+                << ",\"args\":{\"name\":\"" << thread_name << "\"}}";
+
+        const std::uint64_t head = buffer.head();
+        const std::uint64_t first = head > buffer.capacity() ? head - buffer.capacity() : 0;
+        num_overwritten += first;
+        for (std::uint64_t i = first; i < head; ++i) {
+            const TraceEvent &event = buffer.at(i);
+            file << ",\n{\"name\":\"" << escape_json(event.name) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+                    << ",\"ts\":";
+            write_microseconds(file, event.begin_ns);
+            file << ",\"dur\":";
+            write_microseconds(file, event.end_ns - event.begin_ns);
+            if (event.id >= 0) {
+                file << ",\"args\":{\"entity\":" << event.id << "}";
+            } else if (!event.label.empty()) {
+                file << ",\"args\":{\"label\":\"" << escape_json(event.label) << "\"}";
+            }
+            file << "}";
+            ++num_events;
+        }
+    }
+    file << "\n]}\n";
+
+    if (num_overwritten > 0) {
+        std::cout << "Warning: " << num_overwritten << " trace events were overwritten by newer ones.\n";
+    }
+    return num_events;
+}
+
+TraceScope::TraceScope(const char *name, const std::int64_t id, const bool print)
+    : name_(name), id_(id), traced_(tracing_enabled()), print_(print) {
+    if (traced_ || print_) {
+        start_ = std::chrono::steady_clock::now();
+    }
+}
+
+TraceScope::TraceScope(const char *name, const std::string &label) : TraceScope(name) {
+    if (traced_) {
+        label_ = label;
+    }
+}
+
+TraceScope::~TraceScope() {
+    end();
+}
+
+void TraceScope::end() {
+    if (!traced_ && !print_) {
+        return;
+    }
+    const auto stop = std::chrono::steady_clock::now();
+    if (traced_) {
+        thread_buffer().push({name_, id_, since_origin(start_), since_origin(stop), std::move(label_)});
+    }
+    if (print_) {
+        std::cout << name_ << " took " << std::fixed << std::setprecision(2)
+                << std::chrono::duration<double>(stop - start_).count() << " seconds.\n";
+    }
+    traced_ = false;
+    print_ = false;
+}
@@ -0,0 +1,57 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+// Chrome trace-event recording of the conversion. Every thread records into its own fixed size ring buffer, so
+// recording takes no lock; once a buffer is full its oldest events are overwritten. Event names must be string
+// literals, they are stored as pointers.
+
+// Enables tracing. Scopes opened before are not recorded.
+void start_tracing(std::size_t events_per_thread = std::size_t{1} << 16);
+
+bool tracing_enabled();
+
+// Writes the recorded events as trace-event JSON (chrome://tracing, ui.perfetto.dev) and returns their number.
+// Must be called once the traced threads have finished.
+std::size_t write_trace(const std::filesystem::path &trace_file);
+
+// Records the time from construction to end() or destruction as one complete event, with the entity id as argument
+// unless it is negative. Optionally prints the duration, like the stage timings on the console.
+class TraceScope {
+public:
+    explicit TraceScope(const char *name, std::int64_t id = -1, bool print = false);
+
+    // Records a label argument instead of an entity id, e.g. the name of a shape. It is copied only when tracing.
+    TraceScope(const char *name, const std::string &label);
+    ~TraceScope();
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+    void end();
+
+private:
+    const char *name_;
+    std::int64_t id_;
+    std::string label_;
+    bool traced_;
+    bool print_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// __LINE__ has to be expanded before it is pasted into the variable name
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+// Traces the enclosing scope, optionally with an entity id
+#define TRACE_SCOPE(...) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(__VA_ARGS__)
+
+// Traces the enclosing scope and prints how long it took
+#define TIME_BLOCK(name) TraceScope TRACE_CONCAT(time_block_, __LINE__)(name, -1, true)
+
+#endif //TRACE_H
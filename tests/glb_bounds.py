@@ -0,0 +1,78 @@
+"""Checks that GLB files hold the same model: equal world space bounds of the scene, within a tolerance.
+
+Usage: glb_bounds.py reference.glb other.glb [other.glb ...]
+"""
+import json
+import math
+import struct
+import sys
+
+
+def read_json(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    json_length = struct.unpack_from("<I", data, 12)[0]
+    return json.loads(data[20:20 + json_length])
+
+
+def multiply(a, b):
+    # Column-major 4x4 matrices
+    return [sum(a[k * 4 + row] * b[col * 4 + k] for k in range(4)) for col in range(4) for row in range(4)]
+
+
+def node_matrix(node):
+    if "matrix" in node:
+        return node["matrix"]
+    x, y, z, w = node.get("rotation", [0, 0, 0, 1])
+    sx, sy, sz = node.get("scale", [1, 1, 1])
+    tx, ty, tz = node.get("translation", [0, 0, 0])
+    return [
+        (1 - 2 * (y * y + z * z)) * sx, (2 * (x * y + z * w)) * sx, (2 * (x * z - y * w)) * sx, 0,
+        (2 * (x * y - z * w)) * sy, (1 - 2 * (x * x + z * z)) * sy, (2 * (y * z + x * w)) * sy, 0,
+        (2 * (x * z + y * w)) * sz, (2 * (y * z - x * w)) * sz, (1 - 2 * (x * x + y * y)) * sz, 0,
+        tx, ty, tz, 1,
+    ]
+
+
+def scene_bounds(path):
+    gltf = read_json(path)
+    lo = [math.inf] * 3
+    hi = [-math.inf] * 3
+    identity = [1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1]
+    stack = [(root, identity) for root in gltf["scenes"][gltf.get("scene", 0)]["nodes"]]
+    while stack:
+        index, parent = stack.pop()
+        node = gltf["nodes"][index]
+        world = multiply(parent, node_matrix(node))
+        if "mesh" in node:
+            for primitive in gltf["meshes"][node["mesh"]]["primitives"]:
+                accessor = gltf["accessors"][primitive["attributes"]["POSITION"]]
+                # Quantized positions are normalized unsigned shorts
+                scale = 1 / 65535 if accessor.get("normalized") else 1
+                for corner in range(8):
+                    p = [scale * (accessor["max"][k] if corner >> k & 1 else accessor["min"][k]) for k in range(3)]
+                    for row in range(3):
+                        value = sum(world[k * 4 + row] * p[k] for k in range(3)) + world[12 + row]
+                        lo[row] = min(lo[row], value)
+                        hi[row] = max(hi[row], value)
+        stack.extend((child, world) for child in node.get("children", []))
+    return lo, hi
+
+
+def main():
+    reference = scene_bounds(sys.argv[1])
+    diagonal = math.dist(*reference)
+    print(f"{sys.argv[1]}: {reference}")
+    failed = False
+    for path in sys.argv[2:]:
+        bounds = scene_bounds(path)
+        print(f"{path}: {bounds}")
+        error = max(abs(a - b) for a, b in zip(reference[0] + reference[1], bounds[0] + bounds[1]))
+        if not error <= 1e-3 * diagonal:
+            print(f"{path}: bounds differ by {error} (diagonal {diagonal})")
+            failed = True
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,56 @@
+"""Checks that a GLB holds its BIN chunk and references external buffers that exist, and that every buffer view
+lies within its buffer.
+
+Usage: glb_buffers_check.py file.glb
+"""
+import json
+import os
+import struct
+import sys
+
+GLB_MAGIC = 0x46546C67
+CHUNK_BIN = 0x004E4942
+
+
+def main():
+    path = sys.argv[1]
+    with open(path, "rb") as f:
+        data = f.read()
+    magic, _, length = struct.unpack_from("<III", data, 0)
+    if magic != GLB_MAGIC or length != len(data):
+        print(f"{path}: not a GLB of {len(data)} bytes")
+        return 1
+    json_length = struct.unpack_from("<I", data, 12)[0]
+    gltf = json.loads(data[20:20 + json_length])
+
+    failed = False
+    sizes = []
+    for i, buffer in enumerate(gltf.get("buffers", [])):
+        if "uri" in buffer:
+            file = os.path.join(os.path.dirname(path), buffer["uri"])
+            if not os.path.isfile(file):
+                print(f"{path}: missing buffer {file}")
+                failed = True
+                sizes.append(0)
+                continue
+            sizes.append(os.path.getsize(file))
+        elif i == 0 and 28 + json_length <= len(data):
+            bin_length, chunk_type = struct.unpack_from("<II", data, 20 + json_length)
+            sizes.append(bin_length if chunk_type == CHUNK_BIN else 0)
+        else:
+            print(f"{path}: buffer {i} has no uri and is not the BIN chunk")
+            failed = True
+            sizes.append(0)
+        if sizes[-1] < buffer["byteLength"]:
+            print(f"{path}: buffer {i} holds {sizes[-1]} of {buffer['byteLength']} bytes")
+            failed = True
+    for i, view in enumerate(gltf.get("bufferViews", [])):
+        if view.get("byteOffset", 0) + view["byteLength"] > sizes[view["buffer"]]:
+            print(f"{path}: buffer view {i} lies beyond buffer {view['buffer']}")
+            failed = True
+    print(f"{path}: {len(sizes)} buffers, {len(gltf.get('bufferViews', []))} buffer views")
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
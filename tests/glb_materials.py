@@ -0,0 +1,46 @@
+"""Checks the materials and buffers of GLB files: one binary buffer per file, no two materials of the same color,
+and the same materials in every file, so that colors do not change between runs.
+
+Usage: glb_materials.py first.glb [other.glb ...]
+"""
+import json
+import struct
+import sys
+
+
+def read_json(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    json_length = struct.unpack_from("<I", data, 12)[0]
+    return json.loads(data[20:20 + json_length])
+
+
+def colors(gltf):
+    return [tuple(m.get("pbrMetallicRoughness", {}).get("baseColorFactor", [1, 1, 1, 1]))
+            for m in gltf.get("materials", [])]
+
+
+def main():
+    failed = False
+    reference = None
+    for path in sys.argv[1:]:
+        gltf = read_json(path)
+        materials = colors(gltf)
+        print(f"{path}: {len(gltf.get('buffers', []))} buffers, {len(materials)} materials, "
+              f"{len(gltf.get('meshes', []))} meshes")
+        if len(gltf.get("buffers", [])) != 1:
+            print(f"{path}: expected a single buffer")
+            failed = True
+        if len(set(materials)) != len(materials):
+            print(f"{path}: materials of the same color are not shared")
+            failed = True
+        if reference is None:
+            reference = sorted(set(materials))
+        elif sorted(set(materials)) != reference:
+            print(f"{path}: materials differ from {sys.argv[1]}")
+            failed = True
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
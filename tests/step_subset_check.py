@@ -0,0 +1,45 @@
+"""Checks a STEP subset written by --debug against its source: every reference resolves and no record holds an
+empty aggregate, "()", unless records of its entity type have one in the source as well.
+
+Usage: step_subset_check.py source.stp subset.stp
+"""
+import re
+import sys
+
+RECORD = re.compile(r"#(\d+)\s*=\s*([A-Z0-9_]*)(.*?);\s*$", re.S)
+STRING = re.compile(r"'(?:[^']|'')*'")
+EMPTY_AGGREGATE = re.compile(r"\(\s*\)")
+
+
+def read_records(path):
+    with open(path, encoding="utf-8", errors="replace") as f:
+        text = f.read()
+    data = text[text.index("DATA;") + 5:text.rindex("ENDSEC;")]
+    records = {}
+    # Strings may hold ';', so they are blanked out before the records are split
+    for statement in STRING.sub("''", data).split(";"):
+        match = RECORD.match(statement.strip() + ";")
+        if match:
+            records[int(match.group(1))] = (match.group(2), match.group(3))
+    return records
+
+
+def main():
+    source = read_records(sys.argv[1])
+    subset = read_records(sys.argv[2])
+    allowed_empty = {name for name, body in source.values() if EMPTY_AGGREGATE.search(body)}
+    failed = False
+    for number, (name, body) in subset.items():
+        missing = [ref for ref in re.findall(r"#(\d+)", body) if int(ref) not in subset]
+        if missing:
+            print(f"#{number}={name}: undefined references {missing}")
+            failed = True
+        if EMPTY_AGGREGATE.search(body) and name not in allowed_empty:
+            print(f"#{number}={name}: empty aggregate")
+            failed = True
+    print(f"{len(subset)} of {len(source)} records checked")
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
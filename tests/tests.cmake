@@ -4,6 +4,173 @@ add_test(NAME plate COMMAND STP2GLB
         WORKING_DIRECTORY "${CMAKE_INSTALL_PREFIX}/bin"
 )
 
+add_test(NAME as1_single_thread COMMAND STP2GLB
+        --stp "${CMAKE_CURRENT_SOURCE_DIR}/files/as1-oc-214.stp"
+        --glb ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-single-thread.glb
+        --num-threads=1
+        WORKING_DIRECTORY "${CMAKE_INSTALL_PREFIX}/bin"
+)
+
+add_test(NAME as1_lods COMMAND STP2GLB
+        --stp "${CMAKE_CURRENT_SOURCE_DIR}/files/as1-oc-214.stp"
+        --glb ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-lods.glb
+        --lods=0.1,1,5
+        WORKING_DIRECTORY "${CMAKE_INSTALL_PREFIX}/bin"
+)
+
+add_test(NAME as1_max_triangles COMMAND STP2GLB
+        --stp "${CMAKE_CURRENT_SOURCE_DIR}/files/as1-oc-214.stp"
+        --glb ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-max-triangles.glb
+        --max-triangles=5000
+        WORKING_DIRECTORY "${CMAKE_INSTALL_PREFIX}/bin"
+)
+
+add_test(NAME as1_optimize_mesh COMMAND STP2GLB
+        --stp "${CMAKE_CURRENT_SOURCE_DIR}/files/as1-oc-214.stp"
+        --glb ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-optimized.glb
+        --optimize-mesh
+        WORKING_DIRECTORY "${CMAKE_INSTALL_PREFIX}/bin"
+)
+
+add_test(NAME as1_meshopt COMMAND STP2GLB
+        --stp "${CMAKE_CURRENT_SOURCE_DIR}/files/as1-oc-214.stp"
+        --glb ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-meshopt.glb
+        --optimize-mesh
+        --compression=meshopt
+        WORKING_DIRECTORY "${CMAKE_INSTALL_PREFIX}/bin"
+)
+
+add_test(NAME as1_quantize COMMAND STP2GLB
+        --stp "${CMAKE_CURRENT_SOURCE_DIR}/files/as1-oc-214.stp"
+        --glb ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-quantized.glb
+        --quantize
+        --normal-bits=16
+        WORKING_DIRECTORY "${CMAKE_INSTALL_PREFIX}/bin"
+)
+
+add_test(NAME as1_batch COMMAND STP2GLB
+        --stp "${CMAKE_CURRENT_SOURCE_DIR}/files/as1-oc-214.stp"
+        --glb ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-batched.glb
+        --batch
+        WORKING_DIRECTORY "${CMAKE_INSTALL_PREFIX}/bin"
+)
+
+add_test(NAME as1_tiles COMMAND STP2GLB
+        --stp "${CMAKE_CURRENT_SOURCE_DIR}/files/as1-oc-214.stp"
+        --glb ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-tiled.glb
+        --tiles
+        --tile-triangles=2000
+        WORKING_DIRECTORY "${CMAKE_INSTALL_PREFIX}/bin"
+)
+
+add_test(NAME as1_tiles_split_buffers COMMAND STP2GLB
+        --stp "${CMAKE_CURRENT_SOURCE_DIR}/files/as1-oc-214.stp"
+        --glb ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-tiled-split.glb
+        --tiles
+        --tile-triangles=2000
+        --max-buffer-mb=0.01
+        WORKING_DIRECTORY "${CMAKE_INSTALL_PREFIX}/bin"
+)
+
+add_test(NAME as1_bvh COMMAND STP2GLB
+        --stp "${CMAKE_CURRENT_SOURCE_DIR}/files/as1-oc-214.stp"
+        --glb ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-bvh.glb
+        --bvh
+        WORKING_DIRECTORY "${CMAKE_INSTALL_PREFIX}/bin"
+)
+
+add_test(NAME as1_trace COMMAND STP2GLB
+        --stp "${CMAKE_CURRENT_SOURCE_DIR}/files/as1-oc-214.stp"
+        --glb ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-trace.glb
+        --trace=${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-trace.json
+        WORKING_DIRECTORY "${CMAKE_INSTALL_PREFIX}/bin"
+)
+
+add_test(NAME as1_split_buffers COMMAND STP2GLB
+        --stp "${CMAKE_CURRENT_SOURCE_DIR}/files/as1-oc-214.stp"
+        --glb ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-split.glb
+        --max-buffer-mb=0.01
+        WORKING_DIRECTORY "${CMAKE_INSTALL_PREFIX}/bin"
+)
+
+add_test(NAME as1_auto_defl COMMAND STP2GLB
+        --stp "${CMAKE_CURRENT_SOURCE_DIR}/files/as1-oc-214.stp"
+        --glb ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-auto-defl.glb
+        --auto-defl=0.001
+        WORKING_DIRECTORY "${CMAKE_INSTALL_PREFIX}/bin"
+)
+
+add_test(NAME as1_analytic_mesh COMMAND STP2GLB
+        --stp "${CMAKE_CURRENT_SOURCE_DIR}/files/as1-oc-214.stp"
+        --glb ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-analytic.glb
+        --analytic-mesh
+        WORKING_DIRECTORY "${CMAKE_INSTALL_PREFIX}/bin"
+)
+
+# Run twice against the same cache directory, the second run is served from the cache
+add_test(NAME as1_cache_fill COMMAND STP2GLB
+        --stp "${CMAKE_CURRENT_SOURCE_DIR}/files/as1-oc-214.stp"
+        --glb ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-cache-fill.glb
+        --cache-dir=${CMAKE_CURRENT_SOURCE_DIR}/temp/tri-cache
+        WORKING_DIRECTORY "${CMAKE_INSTALL_PREFIX}/bin"
+)
+
+add_test(NAME as1_cache_hit COMMAND STP2GLB
+        --stp "${CMAKE_CURRENT_SOURCE_DIR}/files/as1-oc-214.stp"
+        --glb ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-cache-hit.glb
+        --cache-dir=${CMAKE_CURRENT_SOURCE_DIR}/temp/tri-cache
+        WORKING_DIRECTORY "${CMAKE_INSTALL_PREFIX}/bin"
+)
+set_tests_properties(as1_cache_hit PROPERTIES DEPENDS as1_cache_fill
+        PASS_REGULAR_EXPRESSION "Triangulation cache: [1-9][0-9]* hits")
+
+add_test(NAME as1_cost_model COMMAND STP2GLB
+        --stp "${CMAKE_CURRENT_SOURCE_DIR}/files/as1-oc-214.stp"
+        --glb ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-cost-model.glb
+        --cost-model=${CMAKE_CURRENT_SOURCE_DIR}/temp/tessellation-timings.txt
+        WORKING_DIRECTORY "${CMAKE_INSTALL_PREFIX}/bin"
+)
+
+# Convert twice to the same output, the second run reuses the meshes of all unchanged products
+add_test(NAME as1_incremental_first COMMAND STP2GLB
+        --stp "${CMAKE_CURRENT_SOURCE_DIR}/files/as1-oc-214.stp"
+        --glb ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-incremental.glb
+        --debug
+        --incremental
+        WORKING_DIRECTORY "${CMAKE_INSTALL_PREFIX}/bin"
+)
+
+add_test(NAME as1_incremental_second COMMAND STP2GLB
+        --stp "${CMAKE_CURRENT_SOURCE_DIR}/files/as1-oc-214.stp"
+        --glb ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-incremental.glb
+        --debug
+        --incremental
+        WORKING_DIRECTORY "${CMAKE_INSTALL_PREFIX}/bin"
+)
+set_tests_properties(as1_incremental_second PROPERTIES DEPENDS as1_incremental_first
+        PASS_REGULAR_EXPRESSION "Incremental conversion: [1-9][0-9]* products reused")
+
+# Products whose geometry the filter skips are cached as well, so the second filtered run converts nothing
+add_test(NAME as1_incremental_filter_first COMMAND STP2GLB
+        --stp "${CMAKE_CURRENT_SOURCE_DIR}/files/as1-oc-214.stp"
+        --glb ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-incremental-filtered.glb
+        --debug
+        --incremental
+        --filter-names-include="l-bracket"
+        WORKING_DIRECTORY "${CMAKE_INSTALL_PREFIX}/bin"
+)
+
+add_test(NAME as1_incremental_filter_second COMMAND STP2GLB
+        --stp "${CMAKE_CURRENT_SOURCE_DIR}/files/as1-oc-214.stp"
+        --glb ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-incremental-filtered.glb
+        --debug
+        --incremental
+        --filter-names-include="l-bracket"
+        WORKING_DIRECTORY "${CMAKE_INSTALL_PREFIX}/bin"
+)
+set_tests_properties(as1_incremental_filter_second PROPERTIES DEPENDS as1_incremental_filter_first
+        PASS_REGULAR_EXPRESSION "Incremental conversion: [1-9][0-9]* products reused from the cache, 0 converted, 0 not stored")
+
 add_test(NAME debug_plate COMMAND STP2GLB
         --stp ${CMAKE_CURRENT_SOURCE_DIR}/files/flat_plate_abaqus_10x10_m_wColors.stp
         --glb ${CMAKE_CURRENT_SOURCE_DIR}/temp/flat_plate_abaqus_10x10_m_wColors.glb
@@ -35,6 +202,35 @@ add_test(NAME debug_as1_mini COMMAND STP2GLB
         WORKING_DIRECTORY "${CMAKE_INSTALL_PREFIX}/bin"
 )
 
+# Writes the GLB both directly and through XCAF and prints the timings of the two
+add_test(NAME debug_as1_glb_writers COMMAND STP2GLB
+        --stp "${CMAKE_CURRENT_SOURCE_DIR}/files/as1-oc-214.stp"
+        --glb ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-glb-writers.glb
+        --debug
+        --glb-writer=both
+        --no-debug-step
+        WORKING_DIRECTORY "${CMAKE_INSTALL_PREFIX}/bin"
+)
+
+# The same conversion again, to check that the colors and materials do not change between runs
+add_test(NAME debug_as1_glb_writers_repeat COMMAND STP2GLB
+        --stp "${CMAKE_CURRENT_SOURCE_DIR}/files/as1-oc-214.stp"
+        --glb ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-glb-writers-repeat.glb
+        --debug
+        --no-debug-step
+        WORKING_DIRECTORY "${CMAKE_INSTALL_PREFIX}/bin"
+)
+
+# The streamed debug GLB spills its geometry into external buffers as well
+add_test(NAME debug_as1_split_buffers COMMAND STP2GLB
+        --stp "${CMAKE_CURRENT_SOURCE_DIR}/files/as1-oc-214.stp"
+        --glb ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-debug-split-buffers.glb
+        --debug
+        --max-buffer-mb=0.01
+        --no-debug-step
+        WORKING_DIRECTORY "${CMAKE_INSTALL_PREFIX}/bin"
+)
+
 add_test(NAME debug_as1_filter COMMAND STP2GLB
         --stp "${CMAKE_CURRENT_SOURCE_DIR}/files/as1-oc-214.stp"
         --glb ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-filtered.glb
@@ -44,6 +240,53 @@ add_test(NAME debug_as1_filter COMMAND STP2GLB
         WORKING_DIRECTORY "${CMAKE_INSTALL_PREFIX}/bin"
 )
 
+# The GlbWriter outputs are placed and scaled like the RWGltf output
+find_package(Python3 COMPONENTS Interpreter QUIET)
+if (Python3_Interpreter_FOUND)
+    add_test(NAME as1_glb_writer_bounds COMMAND ${Python3_EXECUTABLE} ${CMAKE_CURRENT_SOURCE_DIR}/tests/glb_bounds.py
+            ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-std.glb
+            ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-lods.glb
+            ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-optimized.glb
+            ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-quantized.glb
+            ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-batched.glb
+    )
+    set_tests_properties(as1_glb_writer_bounds PROPERTIES
+            DEPENDS "as1;as1_lods;as1_optimize_mesh;as1_quantize;as1_batch")
+
+    add_test(NAME debug_as1_glb_writer_bounds COMMAND ${Python3_EXECUTABLE} ${CMAKE_CURRENT_SOURCE_DIR}/tests/glb_bounds.py
+            ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-glb-writers-xcaf.glb
+            ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-glb-writers.glb
+            ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-std.glb
+    )
+    set_tests_properties(debug_as1_glb_writer_bounds PROPERTIES DEPENDS "as1;debug_as1_glb_writers")
+
+    # One buffer, materials shared by color and the same colors in every run
+    add_test(NAME debug_as1_glb_materials COMMAND ${Python3_EXECUTABLE} ${CMAKE_CURRENT_SOURCE_DIR}/tests/glb_materials.py
+            ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-glb-writers.glb
+            ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-glb-writers-repeat.glb
+    )
+    set_tests_properties(debug_as1_glb_materials PROPERTIES DEPENDS "debug_as1_glb_writers;debug_as1_glb_writers_repeat")
+
+    # The streamed debug GLB keeps the first buffer and references the others
+    add_test(NAME debug_as1_split_buffers_files COMMAND ${Python3_EXECUTABLE} ${CMAKE_CURRENT_SOURCE_DIR}/tests/glb_buffers_check.py
+            ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-debug-split-buffers.glb
+    )
+    set_tests_properties(debug_as1_split_buffers_files PROPERTIES DEPENDS debug_as1_split_buffers)
+
+    # Tiles beyond the buffer limit are referenced as .gltf files with their external buffers
+    add_test(NAME as1_tiles_split_buffers_files COMMAND ${Python3_EXECUTABLE} ${CMAKE_CURRENT_SOURCE_DIR}/tests/tileset_check.py
+            ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-tiled-split-tiles/tileset.json
+    )
+    set_tests_properties(as1_tiles_split_buffers_files PROPERTIES DEPENDS as1_tiles_split_buffers)
+
+    # The filtered debug STEP output drops the records whose aggregates lose all their members
+    add_test(NAME debug_as1_filter_step COMMAND ${Python3_EXECUTABLE} ${CMAKE_CURRENT_SOURCE_DIR}/tests/step_subset_check.py
+            ${CMAKE_CURRENT_SOURCE_DIR}/files/as1-oc-214.stp
+            ${CMAKE_CURRENT_SOURCE_DIR}/temp/as1-oc-214-filtered-debug.stp
+    )
+    set_tests_properties(debug_as1_filter_step PROPERTIES DEPENDS debug_as1_filter)
+endif ()
+
 if(EXISTS "${CMAKE_CURRENT_SOURCE_DIR}/temp/really_large.stp")
     add_test(NAME stp_glb_debug_large COMMAND STP2GLB
             --stp "${CMAKE_CURRENT_SOURCE_DIR}/temp/really_large.stp"
@@ -0,0 +1,43 @@
+"""Checks that every file a 3D Tiles tileset references exists: the tile contents and, for tiles written as .gltf,
+their external buffers.
+
+Usage: tileset_check.py tileset.json
+"""
+import json
+import os
+import sys
+
+
+def contents(tile):
+    if "content" in tile:
+        yield tile["content"]["uri"]
+    for child in tile.get("children", []):
+        yield from contents(child)
+
+
+def main():
+    directory = os.path.dirname(sys.argv[1])
+    with open(sys.argv[1]) as f:
+        tileset = json.load(f)
+    missing = []
+    num_contents = 0
+    for uri in contents(tileset["root"]):
+        num_contents += 1
+        path = os.path.join(directory, uri)
+        if not os.path.isfile(path):
+            missing.append(path)
+        elif path.endswith(".gltf"):
+            with open(path) as f:
+                gltf = json.load(f)
+            for buffer in gltf.get("buffers", []):
+                buffer_path = os.path.join(os.path.dirname(path), buffer["uri"])
+                if not os.path.isfile(buffer_path):
+                    missing.append(buffer_path)
+    print(f"{sys.argv[1]}: {num_contents} tile contents")
+    for path in missing:
+        print(f"Missing: {path}")
+    return 1 if missing or num_contents == 0 else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())